@@ -0,0 +1,106 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * echoServer的压测客户端，只使用普通的阻塞socket，不依赖本库
+ * 每个连接一个线程，循环发送blockSize字节并读回同样多的数据(ping-pong)，统计duration秒内的吞吐量
+ * 用法: echoBench [ip] [port] [connections] [blockSize] [duration]
+ * 分别对"echoServer"和"echoServer et"运行，即可比较水平触发和边缘触发模式的吞吐量
+ */
+
+std::atomic_int64_t totalBytes(0);
+std::atomic_int64_t totalRounds(0);
+std::atomic_bool stopping(false);
+
+static bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = ::read(fd, data, len);
+        if (n <= 0) {
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+static void runConnection(const sockaddr_in& addr, size_t blockSize) {
+    int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof addr) < 0) {
+        perror("connect");
+        ::close(fd);
+        return;
+    }
+    int on = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof on);
+
+    std::string out(blockSize, 'x');
+    std::string in(blockSize, '\0');
+    int64_t bytes = 0;
+    int64_t rounds = 0;
+    while (!stopping) {
+        if (!writeAll(fd, out.data(), out.size()) || !readAll(fd, &in[0], in.size())) {
+            break;
+        }
+        bytes += blockSize;
+        ++rounds;
+    }
+    totalBytes += bytes;
+    totalRounds += rounds;
+    ::close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    const char* ip = argc > 1 ? argv[1] : "127.0.0.1";
+    uint16_t port = static_cast<uint16_t>(argc > 2 ? atoi(argv[2]) : 9090);
+    int connections = argc > 3 ? atoi(argv[3]) : 4;
+    size_t blockSize = argc > 4 ? atoi(argv[4]) : 256 * 1024;
+    int duration = argc > 5 ? atoi(argv[5]) : 10;
+
+    sockaddr_in addr;
+    ::memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    ::inet_pton(AF_INET, ip, &addr.sin_addr);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < connections; ++i) {
+        threads.emplace_back(runConnection, std::cref(addr), blockSize);
+    }
+    auto begin = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(std::chrono::seconds(duration));
+    stopping = true;
+    // 服务器仍在回显，每个连接最多再完成一轮就会退出
+    for (auto& t : threads) {
+        t.join();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    printf("%d connections, %zu bytes per block, %.2f s\n", connections, blockSize, seconds);
+    printf("throughput %.2f MiB/s, %.0f rounds/s\n",
+           totalBytes / seconds / 1024 / 1024, totalRounds / seconds);
+    return 0;
+}
@@ -1,16 +1,20 @@
 #include "EventLoop.h"
 #include "TcpServer.h"
+#include "Logging.h"
 
 #include <iostream>
-// #include "Logging.h"
+#include <string.h>
 // #include "AsyncLogging.h"
 
 class EchoServer {
 public:
-    EchoServer(EventLoop *loop, const InetAddress &addr, const std::string &name)
+    EchoServer(EventLoop *loop, const InetAddress &addr, const std::string &name, bool edgeTriggered)
         : server_(loop, addr, name)
         , loop_(loop)
     {
+        // 边缘触发模式：每次事件读写到EAGAIN
+        server_.setEdgeTriggered(edgeTriggered);
+
         // 注册回调函数
         server_.setConnectionCallback(
             std::bind(&EchoServer::onConnection, this, std::placeholders::_1));
@@ -33,11 +37,11 @@ private:
     {
         if (conn->connected())
         {
-            std::cout << "Connection UP : " << conn->peerAddress().toIpPort().c_str() << std::endl;
+            LOG_INFO << "Connection UP : " << conn->peerAddress().toIpPort().c_str();
         }
         else
         {
-            std::cout << "Connection DOWN : " << conn->peerAddress().toIpPort().c_str() << std::endl;
+            LOG_INFO << "Connection DOWN : " << conn->peerAddress().toIpPort().c_str();
         }
     }
 
@@ -45,8 +49,9 @@ private:
     void onMessage(const TcpConnectionPtr &conn, Buffer *buf, Timestamp time)
     {
         std::string msg = buf->retrieveAllAsString();
-        std::cout << conn->name() << " echo " << msg.size() << " bytes, "
-                 << "data received at " << time.toFormattedString() << std::endl;
+        // 每条消息一行，只在DEBUG级别输出
+        LOG_DEBUG << conn->name() << " echo " << msg.size() << " bytes, "
+                  << "data received at " << time.toFormattedString();
         conn->send(msg);
         // conn->shutdown();   // 关闭写端 底层响应EPOLLHUP => 执行closeCallback_
     }
@@ -55,13 +60,14 @@ private:
     TcpServer server_;
 };
 
-int main() 
+// 用法: echoServer [et]，带et参数时使用边缘触发模式，可以用echoBench比较两种模式的吞吐量
+int main(int argc, char* argv[]) 
 {
-
-    std::cout << "pid = " << getpid() <<std::endl;
+    bool edgeTriggered = argc > 1 && ::strcmp(argv[1], "et") == 0;
+    std::cout << "pid = " << getpid() << (edgeTriggered ? ", edge-triggered" : ", level-triggered") <<std::endl;
     EventLoop loop;
     InetAddress addr(9090);
-    EchoServer server(&loop, addr, "EchoServer");
+    EchoServer server(&loop, addr, "EchoServer", edgeTriggered);
     server.start();
     loop.loop();
 
@@ -0,0 +1,151 @@
+#include "CpuTopology.h"
+
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <string.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace {
+
+// 读取sysfs中只有一行的文件，失败时返回空串
+std::string readLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+int readInt(const std::string& path, int defaultValue) {
+    std::string line = readLine(path);
+    return line.empty() ? defaultValue : atoi(line.c_str());
+}
+
+// cpu -> node，由/sys/devices/system/node/nodeN/cpulist得到
+std::map<int, int> cpuNodeMap() {
+    std::map<int, int> nodes;
+    DIR* dir = ::opendir("/sys/devices/system/node");
+    if (dir == nullptr) {
+        return nodes;
+    }
+    while (struct dirent* entry = ::readdir(dir)) {
+        int node = 0;
+        if (::sscanf(entry->d_name, "node%d", &node) != 1) {
+            continue;
+        }
+        std::string list = readLine(std::string("/sys/devices/system/node/") + entry->d_name + "/cpulist");
+        for (int cpu : CpuTopology::parseCpuList(list)) {
+            nodes[cpu] = node;
+        }
+    }
+    ::closedir(dir);
+    return nodes;
+}
+
+} // namespace
+
+namespace CpuTopology {
+
+std::vector<CpuInfo> availableCpus() {
+    std::vector<int> online = parseCpuList(readLine("/sys/devices/system/cpu/online"));
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    bool hasMask = ::sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+    if (online.empty()) {
+        // 没有sysfs时退化为允许使用的CPU
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (hasMask && CPU_ISSET(cpu, &allowed)) {
+                online.push_back(cpu);
+            }
+        }
+    }
+
+    std::map<int, int> nodes = cpuNodeMap();
+    std::vector<CpuInfo> cpus;
+    for (int cpu : online) {
+        if (hasMask && (cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed))) {
+            continue;
+        }
+        std::string topology = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/";
+        CpuInfo info;
+        info.cpu = cpu;
+        info.core = readInt(topology + "core_id", cpu);
+        info.package = readInt(topology + "physical_package_id", 0);
+        auto it = nodes.find(cpu);
+        info.node = (it == nodes.end()) ? 0 : it->second;
+        cpus.push_back(info);
+    }
+    return cpus;
+}
+
+bool pinCurrentThread(const std::vector<int>& cpus) {
+    if (cpus.empty()) {
+        return true;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int cpu : cpus) {
+        if (cpu >= 0 && cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+        }
+    }
+    return ::sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+int currentCpu() {
+    return ::sched_getcpu();
+}
+
+int nodeOfCpu(int cpu) {
+    std::map<int, int> nodes = cpuNodeMap();
+    auto it = nodes.find(cpu);
+    return (it == nodes.end()) ? 0 : it->second;
+}
+
+std::vector<int> parseCpuList(const std::string& list) {
+    std::vector<int> cpus;
+    std::istringstream in(list);
+    std::string range;
+    while (std::getline(in, range, ',')) {
+        int first = 0, last = 0;
+        int n = ::sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (n == 1) {
+            cpus.push_back(first);
+        } else if (n == 2) {
+            for (int cpu = first; cpu <= last; ++cpu) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    std::sort(cpus.begin(), cpus.end());
+    cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+    return cpus;
+}
+
+std::string formatCpuList(const std::vector<int>& cpus) {
+    std::vector<int> sorted(cpus);
+    std::sort(sorted.begin(), sorted.end());
+    std::string result;
+    for (size_t i = 0; i < sorted.size();) {
+        size_t j = i;
+        while (j + 1 < sorted.size() && sorted[j + 1] == sorted[j] + 1) {
+            ++j;
+        }
+        if (!result.empty()) {
+            result += ',';
+        }
+        result += std::to_string(sorted[i]);
+        if (j > i) {
+            result += '-';
+            result += std::to_string(sorted[j]);
+        }
+        i = j + 1;
+    }
+    return result;
+}
+
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * 从sysfs读取CPU拓扑(逻辑CPU、物理核、NUMA节点)，以及绑定线程到CPU。
+ * 不依赖libnuma：线程绑定到某个节点的CPU之后，Linux默认的本地分配(first touch)策略
+ * 会把该线程之后分配并首次写入的内存放在本节点上。
+ */
+namespace CpuTopology {
+
+struct CpuInfo {
+    int cpu;      // 逻辑CPU编号
+    int core;     // 物理核编号，同一个核上的超线程相同，只在同一个package内唯一
+    int package;  // 物理CPU(插槽)编号
+    int node;     // NUMA节点编号，没有NUMA信息时为0
+};
+
+// 当前进程允许使用(sched_getaffinity)的在线CPU，按CPU编号排序
+std::vector<CpuInfo> availableCpus();
+
+// 把调用线程绑定到cpus中的CPU上，cpus为空时不做任何事
+bool pinCurrentThread(const std::vector<int>& cpus);
+
+// 调用线程当前运行在哪个CPU上
+int currentCpu();
+
+// 逻辑CPU所在的NUMA节点，没有NUMA信息时为0
+int nodeOfCpu(int cpu);
+
+// 解析"0-3,8,10-11"形式的CPU列表(sysfs的cpulist格式)
+std::vector<int> parseCpuList(const std::string& list);
+// 格式化为"0-3,8"形式
+std::string formatCpuList(const std::vector<int>& cpus);
+
+}
@@ -0,0 +1,191 @@
+#include "DelimiterSet.h"
+
+#include <assert.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MYMUDUO_DELIMITER_SIMD 1
+#endif
+
+const int DelimiterSet::kMaxChars;
+
+// 常量初始化(std::atomic的构造函数是constexpr)，其他编译单元的静态对象在初始化期间调用find()也是安全的
+std::atomic<DelimiterSet::FindFn> DelimiterSet::findImpl_{&DelimiterSet::findDispatch};
+
+namespace {
+
+std::atomic<DelimiterSet::Impl> g_impl{DelimiterSet::kScalar};
+
+DelimiterSet::Impl detectImpl() {
+#ifdef MYMUDUO_DELIMITER_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return DelimiterSet::kAvx2;
+    }
+    if (__builtin_cpu_supports("sse4.2")) {
+        return DelimiterSet::kSse42;
+    }
+#endif
+    return DelimiterSet::kScalar;
+}
+
+#ifdef MYMUDUO_DELIMITER_SIMD
+// 从p开始整块读入n字节不会跨到下一页(可能未映射)
+inline bool samePage(const char* p, size_t n) {
+    return (reinterpret_cast<uintptr_t>(p) & 4095) <= 4096 - n;
+}
+#endif
+
+}  // namespace
+
+DelimiterSet::DelimiterSet(const char* chars)
+    : size_(0) {
+    memset(chars_, 0, sizeof chars_);
+    memset(lowNibble_, 0, sizeof lowNibble_);
+    memset(highNibble_, 0, sizeof highNibble_);
+    memset(table_, 0, sizeof table_);
+    for (; chars[size_] != '\0'; ++size_) {
+        assert(size_ < kMaxChars);
+        unsigned char c = static_cast<unsigned char>(chars[size_]);
+        chars_[size_] = chars[size_];
+        lowNibble_[c & 0x0f] |= static_cast<uint8_t>(1u << size_);
+        highNibble_[c >> 4] |= static_cast<uint8_t>(1u << size_);
+        table_[c] = 1;
+    }
+    assert(size_ > 0);
+}
+
+DelimiterSet::Impl DelimiterSet::implementation() {
+    if (findImpl_.load(std::memory_order_relaxed) == &DelimiterSet::findDispatch) {
+        setImplementation(detectImpl());
+    }
+    return g_impl.load(std::memory_order_relaxed);
+}
+
+bool DelimiterSet::supported(Impl impl) {
+#ifdef MYMUDUO_DELIMITER_SIMD
+    __builtin_cpu_init();
+    switch (impl) {
+        case kAvx2:
+            return __builtin_cpu_supports("avx2");
+        case kSse42:
+            return __builtin_cpu_supports("sse4.2");
+        default:
+            return true;
+    }
+#else
+    return impl == kScalar;
+#endif
+}
+
+bool DelimiterSet::setImplementation(Impl impl) {
+    if (!supported(impl)) {
+        return false;
+    }
+    FindFn fn;
+    switch (impl) {
+        case kAvx2:
+            fn = &DelimiterSet::findAvx2;
+            break;
+        case kSse42:
+            fn = &DelimiterSet::findSse42;
+            break;
+        default:
+            fn = &DelimiterSet::findScalar;
+            break;
+    }
+    g_impl.store(impl, std::memory_order_relaxed);
+    findImpl_.store(fn, std::memory_order_relaxed);
+    return true;
+}
+
+const char* DelimiterSet::implementationName(Impl impl) {
+    switch (impl) {
+        case kAvx2:
+            return "avx2";
+        case kSse42:
+            return "sse4.2";
+        default:
+            return "scalar";
+    }
+}
+
+const char* DelimiterSet::findDispatch(const DelimiterSet& set, const char* begin, const char* end) {
+    implementation();
+    return findImpl_.load(std::memory_order_relaxed)(set, begin, end);
+}
+
+const char* DelimiterSet::findScalar(const DelimiterSet& set, const char* begin, const char* end) {
+    for (const char* p = begin; p < end; ++p) {
+        if (set.table_[static_cast<unsigned char>(*p)]) {
+            return p;
+        }
+    }
+    return end;
+}
+
+#ifdef MYMUDUO_DELIMITER_SIMD
+
+__attribute__((target("sse4.2"), no_sanitize_address))
+const char* DelimiterSet::findSse42(const DelimiterSet& set, const char* begin, const char* end) {
+    const __m128i chars = _mm_load_si128(reinterpret_cast<const __m128i*>(set.chars_));
+    const char* p = begin;
+    while (p < end) {
+        const ptrdiff_t left = end - p;
+        if (left < 16 && !samePage(p, 16)) {
+            return findScalar(set, p, end);
+        }
+        // 数据操作数的长度限制在left以内，多读的字节不参与比较
+        const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const int len = left < 16 ? static_cast<int>(left) : 16;
+        const int index = _mm_cmpestri(chars, set.size_, block, len,
+                                       _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_LEAST_SIGNIFICANT);
+        if (index < len) {
+            return p + index;
+        }
+        p += 16;
+    }
+    return end;
+}
+
+__attribute__((target("avx2"), no_sanitize_address))
+const char* DelimiterSet::findAvx2(const DelimiterSet& set, const char* begin, const char* end) {
+    const __m256i low = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(set.lowNibble_)));
+    const __m256i high = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(set.highNibble_)));
+    const __m256i nibbleMask = _mm256_set1_epi8(0x0f);
+    const __m256i zero = _mm256_setzero_si256();
+    const char* p = begin;
+    while (p < end) {
+        const ptrdiff_t left = end - p;
+        if (left < 32 && !samePage(p, 32)) {
+            return findScalar(set, p, end);
+        }
+        const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        // 字节c是分隔符 <=> low[c & 0xf] & high[c >> 4] 中有该分隔符的那一位
+        const __m256i lowBits = _mm256_shuffle_epi8(low, _mm256_and_si256(block, nibbleMask));
+        const __m256i highBits = _mm256_shuffle_epi8(high, _mm256_and_si256(_mm256_srli_epi16(block, 4), nibbleMask));
+        const __m256i miss = _mm256_cmpeq_epi8(_mm256_and_si256(lowBits, highBits), zero);
+        uint32_t hits = ~static_cast<uint32_t>(_mm256_movemask_epi8(miss));
+        if (left < 32) {
+            hits &= (1u << left) - 1;
+        }
+        if (hits != 0) {
+            return p + __builtin_ctz(hits);
+        }
+        p += 32;
+    }
+    return end;
+}
+
+#else
+
+const char* DelimiterSet::findSse42(const DelimiterSet& set, const char* begin, const char* end) {
+    return findScalar(set, begin, end);
+}
+
+const char* DelimiterSet::findAvx2(const DelimiterSet& set, const char* begin, const char* end) {
+    return findScalar(set, begin, end);
+}
+
+#endif
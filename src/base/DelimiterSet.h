@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * 一组分隔符(最多kMaxChars个字节)，在一段内存中找第一个属于这组分隔符的字节
+ * @details 构造时生成查找表，find()按运行时检测到的CPU特性选择实现：
+ *   AVX2:   每次32字节，用两次vpshufb按高低4位查表(每个分隔符占一位)，与分隔符个数无关
+ *   SSE4.2: 每次16字节，pcmpestri的EQUAL_ANY模式
+ *   标量:   256项的查找表，逐字节比较
+ * 向量实现在末尾不足一个向量时，只要不跨页就整块读入，再丢掉超出end的结果，短字符串也能一次比较完；
+ * 读到的多余字节不影响结果
+ */
+class DelimiterSet {
+public:
+    static const int kMaxChars = 8;
+
+    enum Impl {
+        kScalar,
+        kSse42,
+        kAvx2,
+    };
+
+    // chars是以NUL结尾的分隔符，不能包含NUL，最多kMaxChars个
+    explicit DelimiterSet(const char* chars);
+
+    // [begin, end)中第一个分隔符的位置，没有时返回end
+    const char* find(const char* begin, const char* end) const {
+        return findImpl_.load(std::memory_order_relaxed)(*this, begin, end);
+    }
+
+    bool contains(char c) const { return table_[static_cast<unsigned char>(c)] != 0; }
+
+    // 当前使用的实现
+    static Impl implementation();
+    // CPU是否支持impl
+    static bool supported(Impl impl);
+    // 强制使用impl，用于测试和性能对比，不支持时返回false；其他线程中正在进行的find()可能还在用原来的实现
+    static bool setImplementation(Impl impl);
+    static const char* implementationName(Impl impl);
+
+private:
+    using FindFn = const char* (*)(const DelimiterSet&, const char*, const char*);
+
+    // 第一次调用时检测CPU，换成对应的实现
+    static const char* findDispatch(const DelimiterSet& set, const char* begin, const char* end);
+    static const char* findScalar(const DelimiterSet& set, const char* begin, const char* end);
+    static const char* findSse42(const DelimiterSet& set, const char* begin, const char* end);
+    static const char* findAvx2(const DelimiterSet& set, const char* begin, const char* end);
+
+    // 多个IO线程第一次调用find()时可能同时写入，各线程检测的结果相同，宽松的原子读写即可
+    static std::atomic<FindFn> findImpl_;
+
+    int size_;
+    alignas(16) char chars_[16];      // pcmpestri的分隔符操作数，多余的字节为0
+    alignas(16) uint8_t lowNibble_[16];   // 低4位为i的字节可能是哪些分隔符，每个分隔符一位
+    alignas(16) uint8_t highNibble_[16];  // 高4位为i的字节可能是哪些分隔符
+    uint8_t table_[256];              // 标量查找表，非0表示是分隔符
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+template <typename Signature, size_t Capacity = 64>
+class InplaceFunction;
+
+/**
+ * 只能移动的可调用对象包装器，被包装的对象总是存放在内部固定大小(默认64字节)的缓冲区中。
+ * 与std::function不同，它永远不会在堆上分配内存：
+ * 可调用对象（例如绑定了shared_ptr和成员函数指针的std::bind结果、捕获较多的lambda）
+ * 超过Capacity时直接编译失败，而不是悄悄地退化成堆分配。
+ * 用于EventLoop::Functor、定时器回调和Channel的事件回调这些热路径上的回调。
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity> {
+public:
+    InplaceFunction() noexcept : ops_(nullptr) {}
+    InplaceFunction(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+    template <typename F,
+              typename Fn = typename std::decay<F>::type,
+              typename = typename std::enable_if<!std::is_same<Fn, InplaceFunction>::value>::type>
+    InplaceFunction(F&& f) : ops_(&Ops<Fn>::table) {
+        static_assert(sizeof(Fn) <= Capacity,
+                      "callable is too large for InplaceFunction, capture less or enlarge Capacity");
+        static_assert(alignof(Fn) <= alignof(Storage),
+                      "callable is over-aligned for InplaceFunction");
+        ::new (static_cast<void*>(&storage_)) Fn(std::forward<F>(f));
+    }
+
+    InplaceFunction(InplaceFunction&& other) noexcept : ops_(other.ops_) {
+        if (ops_) {
+            ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+
+    InplaceFunction& operator=(InplaceFunction&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other.ops_) {
+                other.ops_->move(&storage_, &other.storage_);
+                ops_ = other.ops_;
+                other.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    InplaceFunction& operator=(std::nullptr_t) noexcept {
+        reset();
+        return *this;
+    }
+
+    InplaceFunction(const InplaceFunction&) = delete;
+    InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+    ~InplaceFunction() { reset(); }
+
+    // 与std::function一样，const调用也允许被包装对象修改自身状态
+    R operator()(Args... args) const {
+        return ops_->invoke(const_cast<void*>(static_cast<const void*>(&storage_)),
+                            std::forward<Args>(args)...);
+    }
+
+    explicit operator bool() const noexcept { return ops_ != nullptr; }
+
+private:
+    using Storage = typename std::aligned_storage<Capacity, alignof(std::max_align_t)>::type;
+
+    // 每一种被包装类型对应一张静态的操作表，对象本身只多出一个指针
+    struct OpsTable {
+        R (*invoke)(void*, Args&&...);
+        // 把src处的对象移动构造到dst处，并析构src处的对象
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void*);
+    };
+
+    template <typename Fn>
+    struct Ops {
+        static R invoke(void* p, Args&&... args) {
+            return (*static_cast<Fn*>(p))(std::forward<Args>(args)...);
+        }
+        static void move(void* dst, void* src) {
+            Fn* from = static_cast<Fn*>(src);
+            ::new (dst) Fn(std::move(*from));
+            from->~Fn();
+        }
+        static void destroy(void* p) {
+            static_cast<Fn*>(p)->~Fn();
+        }
+        static constexpr OpsTable table = {&Ops::invoke, &Ops::move, &Ops::destroy};
+    };
+
+    void reset() noexcept {
+        if (ops_) {
+            ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    const OpsTable* ops_;
+    Storage storage_;
+};
+
+template <typename R, typename... Args, size_t Capacity>
+template <typename Fn>
+constexpr typename InplaceFunction<R(Args...), Capacity>::OpsTable
+    InplaceFunction<R(Args...), Capacity>::Ops<Fn>::table;
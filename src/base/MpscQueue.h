@@ -0,0 +1,73 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <atomic>
+#include <utility>
+
+/**
+ * 无锁多生产者/单消费者(MPSC)队列，基于Dmitry Vyukov的非侵入式链表队列。
+ * push()可以被任意线程并发调用，只做一次原子exchange，不会阻塞其他生产者；
+ * pop()只能由唯一的消费者线程调用（对EventLoop而言就是loop线程）。
+ * 元素的先后顺序以push()中exchange的先后为准，同一个生产者入队的元素严格保持FIFO，
+ * 与原先"加锁push_back + 交换vector"的顺序保证一致。
+ *
+ * +------+    +------+    +------+
+ * | tail | -> | node | -> | head |
+ * +------+    +------+    +------+
+ * tail_始终指向一个哑结点，真正的元素从tail_->next开始
+ */
+template <typename T>
+class MpscQueue : noncopyable {
+public:
+    MpscQueue()
+        : head_(new Node()),
+          tail_(head_.load(std::memory_order_relaxed)) {}
+
+    ~MpscQueue() {
+        T value;
+        while (pop(value)) {}
+        delete tail_;
+    }
+
+    // 生产者调用，线程安全
+    void push(T value) {
+        Node* node = new Node(std::move(value));
+        // 先抢占队头位置，再把前驱结点链接过来
+        // 两步之间消费者可能暂时看不到这个结点，pop()会返回false，但不会丢失
+        Node* prev = head_.exchange(node, std::memory_order_acq_rel);
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    // 消费者调用，只能在单一线程中调用，队列为空时返回false
+    bool pop(T& value) {
+        Node* tail = tail_;
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (next == nullptr) {
+            return false;
+        }
+        value = std::move(next->value);
+        // next成为新的哑结点
+        tail_ = next;
+        delete tail;
+        return true;
+    }
+
+    // 只在消费者线程中调用才是准确的
+    bool empty() const {
+        return tail_->next.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    struct Node {
+        Node() : next(nullptr) {}
+        explicit Node(T&& v) : next(nullptr), value(std::move(v)) {}
+
+        std::atomic<Node*> next;
+        T value;
+    };
+
+    // 生产者竞争的位置和消费者独占的位置分开放在不同的cache line，避免伪共享
+    alignas(64) std::atomic<Node*> head_;
+    alignas(64) Node* tail_;
+};
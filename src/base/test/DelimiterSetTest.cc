@@ -0,0 +1,109 @@
+#include "DelimiterSet.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <random>
+
+// DelimiterSet各个实现(标量/SSE4.2/AVX2)与逐字节的参考实现比较
+// 向量实现在末尾不足一个向量时会整块读入，数据紧挨着PROT_NONE的保护页结束，读越界会直接SIGSEGV
+// 失败时返回非0
+
+namespace {
+
+const char* const kSets[] = {" ?\n", ":\n", "\n", "abcdefgh", "\x80\xff\x01~", "\r"};
+
+int g_failures = 0;
+
+const char* reference(const char* chars, const char* begin, const char* end) {
+    for (const char* p = begin; p < end; ++p) {
+        if (strchr(chars, *p) != nullptr && *p != '\0') {
+            return p;
+        }
+    }
+    return end;
+}
+
+void check(const DelimiterSet& set, const char* chars, const char* begin, const char* end, const char* what) {
+    const char* got = set.find(begin, end);
+    const char* want = reference(chars, begin, end);
+    if (got != want) {
+        if (++g_failures <= 10) {
+            printf("FAIL %s %s: set \"%s\" len %zu, got %td want %td\n",
+                   DelimiterSet::implementationName(DelimiterSet::implementation()), what, chars,
+                   static_cast<size_t>(end - begin), got - begin, want - begin);
+        }
+    }
+}
+
+// 随机字节，按一定比例混入分隔符
+void fill(std::mt19937& rng, const char* chars, char* p, size_t n, int delimiterPercent) {
+    const size_t numChars = strlen(chars);
+    for (size_t i = 0; i < n; ++i) {
+        if (static_cast<int>(rng() % 100) < delimiterPercent) {
+            p[i] = chars[rng() % numChars];
+        } else {
+            p[i] = static_cast<char>(rng());
+        }
+    }
+}
+
+void testImpl(char* guardEnd, char* scratch, size_t scratchSize) {
+    std::mt19937 rng(12345);
+    for (const char* chars : kSets) {
+        DelimiterSet set(chars);
+        // 数据在保护页之前结束，末尾长度0..32覆盖向量实现的每一种尾部
+        for (size_t len = 0; len <= 32; ++len) {
+            char* begin = guardEnd - len;
+            // 没有分隔符
+            memset(begin, 'Z', len);
+            check(set, chars, begin, guardEnd, "guard none");
+            // 唯一的分隔符在每一个位置
+            for (size_t pos = 0; pos < len; ++pos) {
+                memset(begin, 'Z', len);
+                begin[pos] = chars[pos % strlen(chars)];
+                check(set, chars, begin, guardEnd, "guard single");
+            }
+            for (int trial = 0; trial < 200; ++trial) {
+                fill(rng, chars, begin, len, 5);
+                check(set, chars, begin, guardEnd, "guard random");
+            }
+        }
+        // 任意对齐、较长的数据，分隔符稀疏或密集
+        for (int trial = 0; trial < 20000; ++trial) {
+            size_t offset = rng() % 64;
+            size_t len = rng() % (scratchSize - 64);
+            fill(rng, chars, scratch + offset, len, trial % 2 ? 1 : 20);
+            check(set, chars, scratch + offset, scratch + offset + len, "random");
+        }
+    }
+}
+
+}  // namespace
+
+int main() {
+    const size_t pageSize = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    char* pages = static_cast<char*>(::mmap(nullptr, 2 * pageSize, PROT_READ | PROT_WRITE,
+                                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (pages == MAP_FAILED || ::mprotect(pages + pageSize, pageSize, PROT_NONE) != 0) {
+        perror("mmap");
+        return 1;
+    }
+    char* guardEnd = pages + pageSize;
+    static char scratch[1024];
+
+    const DelimiterSet::Impl impls[] = {DelimiterSet::kScalar, DelimiterSet::kSse42, DelimiterSet::kAvx2};
+    for (DelimiterSet::Impl impl : impls) {
+        if (!DelimiterSet::setImplementation(impl)) {
+            printf("%s not supported, skipped\n", DelimiterSet::implementationName(impl));
+            continue;
+        }
+        int before = g_failures;
+        testImpl(guardEnd, scratch, sizeof scratch);
+        printf("%-7s %s\n", DelimiterSet::implementationName(impl), g_failures == before ? "ok" : "FAILED");
+    }
+    ::munmap(pages, 2 * pageSize);
+    return g_failures == 0 ? 0 : 1;
+}
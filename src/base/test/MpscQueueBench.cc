@@ -0,0 +1,128 @@
+#include "MpscQueue.h"
+#include "EventLoop.h"
+#include "Thread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// N个生产者线程向同一个loop投递任务，比较无锁MPSC队列与原先"mutex + vector"队列的开销
+
+using Functor = std::function<void()>;
+
+// 原先EventLoop使用的队列：加锁push_back，消费者加锁后整体交换
+class LockedQueue {
+public:
+    void push(Functor cb) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        pending_.push_back(std::move(cb));
+    }
+    void drain(std::vector<Functor>& out) {
+        std::lock_guard<std::mutex> lk(mutex_);
+        out.swap(pending_);
+    }
+private:
+    std::mutex mutex_;
+    std::vector<Functor> pending_;
+};
+
+// MPSC队列，消费者一次取出全部任务，与EventLoop::doPendingFunctors()一致
+class LockFreeQueue {
+public:
+    void push(Functor cb) { queue_.push(std::move(cb)); }
+    void drain(std::vector<Functor>& out) {
+        Functor f;
+        while (queue_.pop(f)) {
+            out.push_back(std::move(f));
+        }
+    }
+private:
+    MpscQueue<Functor> queue_;
+};
+
+template <typename Queue>
+double benchQueue(int producers, int perProducer) {
+    Queue queue;
+    std::atomic_bool start(false);
+    int64_t executed = 0;
+    const int64_t total = static_cast<int64_t>(producers) * perProducer;
+
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int i = 0; i < producers; ++i) {
+        threads.emplace_back(new Thread([&] {
+            while (!start) {}
+            for (int j = 0; j < perProducer; ++j) {
+                queue.push([&executed] { ++executed; });
+            }
+        }));
+        threads.back()->start();
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    start = true;
+    std::vector<Functor> functors;
+    while (executed < total) {
+        queue.drain(functors);
+        for (auto& f : functors) {
+            f();
+        }
+        functors.clear();
+    }
+    auto end = std::chrono::steady_clock::now();
+    for (auto& t : threads) {
+        t->join();
+    }
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+// 端到端：生产者通过EventLoop::queueInLoop投递，统计loop线程执行完全部任务的时间，以及写eventfd的次数
+double benchEventLoop(int producers, int perProducer) {
+    EventLoop loop;
+    std::atomic_int64_t executed(0);
+    const int64_t total = static_cast<int64_t>(producers) * perProducer;
+
+    std::vector<std::unique_ptr<Thread>> threads;
+    for (int i = 0; i < producers; ++i) {
+        threads.emplace_back(new Thread([&] {
+            for (int j = 0; j < perProducer; ++j) {
+                loop.queueInLoop([&] {
+                    if (++executed == total) {
+                        loop.quit();
+                    }
+                });
+            }
+        }));
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    for (auto& t : threads) {
+        t->start();
+    }
+    loop.loop();
+    auto end = std::chrono::steady_clock::now();
+    for (auto& t : threads) {
+        t->join();
+    }
+    return std::chrono::duration<double>(end - begin).count();
+}
+
+int main(int argc, char* argv[]) {
+    int perProducer = argc > 1 ? atoi(argv[1]) : 200000;
+    const int producerCounts[] = {1, 2, 4, 8};
+
+    printf("pid = %d, %d tasks per producer\n", getpid(), perProducer);
+    printf("%-10s %16s %16s %16s\n", "producers", "mutex(Mops/s)", "mpsc(Mops/s)", "loop(Mops/s)");
+    for (int producers : producerCounts) {
+        double total = static_cast<double>(producers) * perProducer / 1e6;
+        double locked = benchQueue<LockedQueue>(producers, perProducer);
+        double lockFree = benchQueue<LockFreeQueue>(producers, perProducer);
+        double loop = benchEventLoop(producers, perProducer);
+        printf("%-10d %16.2f %16.2f %16.2f\n", producers, total / locked, total / lockFree, total / loop);
+    }
+    return 0;
+}
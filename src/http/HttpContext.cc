@@ -1,94 +1,380 @@
 #include "HttpContext.h"
 #include "Buffer.h"
+#include "DelimiterSet.h"
 
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <algorithm>
 
-bool HttpContext::processRequestLine(const char* begin, const char* end) {
-    bool succeed = false;
-    const char* start = begin;
-    // 起始行中的每一个字段都是用空格分隔的
-    const char* space = std::find(start, end, ' ');
-
-    // 存在空格，那么起始位置到空格之前应该是请求方法，设置请求方法；成功获取了method并设置到request_
-    if (space != end && request_.setMethod(start, space)) {
-        // 跳过空格
-        start = space + 1;
-        // 继续寻找下一个空格
-        space = std::find(start, end, ' ');
-        if (space != end) {
-            // 查看是否有请求参数
-            const char* question = std::find(start, space, '?');
-            if (question != space) {
-                // 设置访问路径，即要请求的资源的URI
-                request_.setPath(start, question);
-                // 设置访问变量
-                request_.setQuery(question + 1, space);
-            } else {
-                request_.setPath(start,space);
-            }
-            start = space + 1;
-            // 获取位于最后的http版本
-            succeed = (end - start == 8 && std::equal(start, end - 1,"HTTP/1."));
-            if (succeed) {
-                if (*(end - 1) == '1') {
-                    request_.setVersion(HttpRequest::Version::HTTP11);           
-                } else if (*(end - 1) == '0') {
-                    request_.setVersion(HttpRequest::Version::HTTP10);
-                } else {
-                    succeed = false;
-                }
-            }
-        } 
+const size_t HttpContext::kMaxHeaderBytes;
+const size_t HttpContext::kDefaultMaxBodySize;
+const size_t HttpContext::kMaxChunkLine;
+
+namespace {
+
+// 请求行和首部行中要找的分隔符，行尾只找LF，CR在找到LF之后检查
+const DelimiterSet kRequestLineDelimiters(" ?\n");
+const DelimiterSet kHeaderDelimiters(":\n");
+const DelimiterSet kLineEnd("\n");
+
+bool equalsIgnoreCase(std::string_view a, const char* b) {
+    return a.size() == strlen(b) && ::strncasecmp(a.data(), b, a.size()) == 0;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while (!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+// Content-Length只能是十进制数字，不接受符号和空白，溢出按格式错误处理
+bool parseContentLength(std::string_view value, size_t* length) {
+    if (value.empty()) {
+        return false;
+    }
+    size_t n = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9' || n > (SIZE_MAX - 9) / 10) {
+            return false;
+        }
+        n = n * 10 + (c - '0');
+    }
+    *length = n;
+    return true;
+}
+
+// chunk大小是十六进制数，后面可以跟";扩展"，扩展直接忽略
+bool parseChunkSize(const char* begin, const char* end, size_t* size) {
+    size_t n = 0;
+    const char* p = begin;
+    for (; p < end; ++p) {
+        int digit;
+        if (*p >= '0' && *p <= '9') {
+            digit = *p - '0';
+        } else if (*p >= 'a' && *p <= 'f') {
+            digit = *p - 'a' + 10;
+        } else if (*p >= 'A' && *p <= 'F') {
+            digit = *p - 'A' + 10;
+        } else {
+            break;
+        }
+        if (n > (SIZE_MAX >> 4)) {
+            return false;
+        }
+        n = (n << 4) | digit;
+    }
+    if (p == begin) {
+        return false;
+    }
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    if (p < end && *p != ';') {
+        return false;
+    }
+    *size = n;
+    return true;
+}
+
+}  // namespace
+
+bool HttpContext::processRequestLine(const char* base, const char* begin, const char* end) {
+    // 起始行中的每一个字段都是用空格分隔的，扫描时已经记下两个空格和第一个'?'的位置
+    if (space2_ == 0) {
+        return false;
+    }
+    const char* space1 = base + space1_;
+    const char* space2 = base + space2_;
+    // 起始位置到第一个空格之前应该是请求方法，设置请求方法
+    if (!request_.setMethod(begin, space1)) {
+        return false;
+    }
+    // 路径和参数先记下偏移，请求完整后再设置到request_
+    pathBegin_ = space1_ + 1;
+    pathEnd_ = question_ != 0 ? question_ : space2_;
+    queryBegin_ = question_ != 0 ? question_ + 1 : space2_;
+    queryEnd_ = space2_;
+    // 获取位于最后的http版本
+    const char* start = space2 + 1;
+    bool succeed = (end - start == 8 && std::equal(start, end - 1,"HTTP/1."));
+    if (succeed) {
+        if (*(end - 1) == '1') {
+            request_.setVersion(HttpRequest::Version::HTTP11);
+        } else if (*(end - 1) == '0') {
+            request_.setVersion(HttpRequest::Version::HTTP10);
+        } else {
+            succeed = false;
+        }
     }
     return succeed;
 }
 
+void HttpContext::buildRequest(const char* base) {
+    request_.setPath(base + pathBegin_, base + pathEnd_);
+    request_.setQuery(base + queryBegin_, base + queryEnd_);
+    for (const HeaderLine& line : headerLines_) {
+        request_.addHeader(base + line.begin, base + line.colon, base + line.end);
+    }
+}
+
 // return false if any error
-bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime) {
-    bool ok = false;
-    bool hasMore = true;
-    while (hasMore) {
-        // 请求行状态
+bool HttpContext::parseRequest(Buffer* buf, Timestamp receiveTime, const BodyCallback* bodyCallback) {
+    if (state_ == EXPECTREQUESTLINE || state_ == EXPECTHEADERS) {
+        if (!parseHeaders(buf, receiveTime)) {
+            return fail(kBadRequest);
+        }
+        if (state_ != EXPECTBODY) {
+            return true;
+        }
+        if (!startBody(buf, bodyCallback)) {
+            return false;
+        }
+    }
+    if (state_ == EXPECTBODY) {
+        return parseBody(buf, bodyCallback);
+    }
+    return true;
+}
+
+bool HttpContext::parseHeaders(Buffer* buf, Timestamp receiveTime) {
+    // 缓冲区可能在上次调用之后扩容或搬移过，只使用相对peek()的偏移
+    const char* base = buf->peek();
+    const size_t readable = buf->readableBytes();
+    const char* end = base + readable;
+    while (state_ == EXPECTREQUESTLINE || state_ == EXPECTHEADERS) {
+        // 从上次停下的位置继续，一遍扫描同时找出行内的分隔符和行尾(LF，前面的CR可以省略)
+        const DelimiterSet& delimiters = state_ == EXPECTREQUESTLINE ? kRequestLineDelimiters
+                                       : (colon_ == 0 ? kHeaderDelimiters : kLineEnd);
+        const char* hit = delimiters.find(base + scanned_, end);
+        if (hit == end) {
+            scanned_ = readable;
+            return readable <= kMaxHeaderBytes;
+        }
+        const uint32_t offset = static_cast<uint32_t>(hit - base);
+        scanned_ = offset + 1;
+        if (*hit == ' ') {
+            // 请求行只有两个空格，方法不能为空
+            if (offset == parsed_ || space2_ != 0) {
+                return false;
+            }
+            (space1_ == 0 ? space1_ : space2_) = offset;
+            continue;
+        } else if (*hit == '?') {
+            // 路径中的第一个'?'之后是查询参数
+            if (space1_ != 0 && space2_ == 0 && question_ == 0) {
+                question_ = offset;
+            }
+            continue;
+        } else if (*hit == ':') {
+            // 首部的名字和值以第一个':'分隔，值中的':'不再查找
+            colon_ = offset;
+            continue;
+        }
+
+        const char* lineBegin = base + parsed_;
+        const char* eol = hit;
+        if (eol > lineBegin && eol[-1] == '\r') {
+            --eol;
+        }
         if (state_ == EXPECTREQUESTLINE) {
-            // 找到\r\n位置
-            const char* crlf = buf->findCRLF();
-            if (crlf) {
-                // 从可读区读取请求行
-                // [peek(), crlf + 2) 是一行
-                ok = processRequestLine(buf->peek(), crlf);
-                if (ok) {
-                    request_.setReceiveTime(receiveTime);
-                    // readerIndex 向后移动位置直到 crlf + 2
-                    buf->retriUntil(crlf + 2);
-                    // 状态转移，接下来解析首部
-                    state_ = EXPECTHEADERS;
+            if (!processRequestLine(base, lineBegin, eol)) {
+                return false;
+            }
+            request_.setReceiveTime(receiveTime);
+            // 状态转移，接下来解析首部
+            state_ = EXPECTHEADERS;
+        } else if (eol == lineBegin) {
+            // 空行，首部结束，接下来由startBody()决定有没有请求体
+            state_ = EXPECTBODY;
+            buildRequest(base);
+        } else {
+            if (colon_ == 0 || colon_ == parsed_) {
+                return false;
+            }
+            headerLines_.push_back(HeaderLine{static_cast<uint32_t>(parsed_), colon_,
+                                              static_cast<uint32_t>(eol - base)});
+        }
+        parsed_ = scanned_;
+        space1_ = space2_ = question_ = colon_ = 0;
+        if (parsed_ > kMaxHeaderBytes) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool HttpContext::startBody(Buffer* buf, const BodyCallback* bodyCallback) {
+    bool hasLength = false;
+    bool chunked = false;
+    size_t length = 0;
+    std::string_view transferEncoding;
+    for (const HttpRequest::Header& header : request_.headers()) {
+        if (equalsIgnoreCase(header.field, "content-length")) {
+            // 多个Content-Length必须相同，否则无法确定请求体的边界
+            size_t n = 0;
+            if (!parseContentLength(header.value, &n) || (hasLength && n != length)) {
+                return fail(kBadRequest);
+            }
+            hasLength = true;
+            length = n;
+        } else if (equalsIgnoreCase(header.field, "transfer-encoding")) {
+            chunked = true;
+            transferEncoding = header.value;
+        } else if (equalsIgnoreCase(header.field, "expect")) {
+            // HTTP/1.0的客户端不会等待100 Continue
+            expectContinue_ = request_.version() == HttpRequest::Version::HTTP11 &&
+                              equalsIgnoreCase(header.value, "100-continue");
+        }
+    }
+    if (chunked) {
+        // 同时有Content-Length和Transfer-Encoding时前后两端可能按不同的方式分帧(请求走私)，直接拒绝；
+        // 最后一个编码必须是chunked，否则请求体的长度无法确定
+        size_t comma = transferEncoding.rfind(',');
+        std::string_view last = comma == std::string_view::npos ? transferEncoding
+                                                                : transferEncoding.substr(comma + 1);
+        if (hasLength || !equalsIgnoreCase(trim(last), "chunked")) {
+            return fail(kBadRequest);
+        }
+    } else if (length == 0) {
+        // 没有请求体
+        expectContinue_ = false;
+        state_ = GOTALL;
+        return true;
+    } else if (maxBodySize_ > 0 && length > maxBodySize_) {
+        return fail(kBodyTooLarge);
+    }
+
+    if (bodyCallback != nullptr) {
+        // 首部拷贝出来，从缓冲区中取走，之后的请求体交给回调后也立即取走
+        streaming_ = true;
+        headerCopy_.assign(buf->peek(), parsed_);
+        request_.clearHeaders();
+        buildRequest(headerCopy_.data());
+        buf->retrieve(parsed_);
+        parsed_ = 0;
+        scanned_ = 0;
+    }
+    bodyBegin_ = parsed_;
+    bodyState_ = chunked ? kChunkSize : kFixedLength;
+    remaining_ = chunked ? 0 : length;
+    return true;
+}
+
+bool HttpContext::parseBody(Buffer* buf, const BodyCallback* bodyCallback) {
+    assert(!streaming_ || bodyCallback != nullptr);
+    while (state_ == EXPECTBODY) {
+        // 流式接收时每一步都会从缓冲区中取走数据，每次循环重新取peek()
+        const char* base = buf->peek();
+        const size_t readable = buf->readableBytes();
+        const char* end = base + readable;
+        switch (bodyState_) {
+            case kFixedLength:
+            case kChunkData: {
+                const size_t n = std::min(remaining_, readable - parsed_);
+                if (n > 0) {
+                    if (streaming_) {
+                        (*bodyCallback)(request_, std::string_view(base + parsed_, n), false);
+                    } else if (bodyState_ == kChunkData) {
+                        body_.append(base + parsed_, n);
+                    }
+                    parsed_ += n;
+                    remaining_ -= n;
+                }
+                if (remaining_ > 0) {
+                    scanned_ = parsed_;
+                    if (streaming_) {
+                        buf->retrieve(parsed_);
+                        parsed_ = scanned_ = 0;
+                    }
+                    return true;
+                }
+                if (bodyState_ == kFixedLength) {
+                    state_ = GOTALL;
                 } else {
-                    hasMore = false;
+                    bodyState_ = kChunkDataEnd;
                 }
-            } else {
-                hasMore = false;
+                break;
             }
-        } else if (state_ == EXPECTHEADERS) {
-            // 解析首部
-            const char* crlf = buf->findCRLF();
-            if (crlf) {
-                // 找到 : 位置
-                const char* colon = std::find(buf->peek(), crlf, ':');
-                if (colon != crlf) {
-                    // 添加状态首部
-                    request_.addHeader(buf->peek(), colon, crlf);
-                } else {
-                    // colon == crlf 说明没有找到 : ，直接返回 end
-                    // empty line, end of header
-                    // FIXME:
+            case kChunkDataEnd: {
+                // chunk数据后面的CRLF，和首部一样也接受单独的LF
+                if (parsed_ == readable || (base[parsed_] == '\r' && parsed_ + 1 == readable)) {
+                    return true;
+                }
+                if (base[parsed_] == '\r') {
+                    ++parsed_;
+                }
+                if (base[parsed_] != '\n') {
+                    return fail(kBadRequest);
+                }
+                ++parsed_;
+                bodyState_ = kChunkSize;
+                break;
+            }
+            case kChunkSize:
+            case kChunkTrailer: {
+                // trailer首部的总长度和首部一样不超过kMaxHeaderBytes，内容不使用
+                const size_t limit = bodyState_ == kChunkSize ? kMaxChunkLine : kMaxHeaderBytes - trailerBytes_;
+                const char* hit = kLineEnd.find(base + std::max(scanned_, parsed_), end);
+                if (hit == end) {
+                    scanned_ = readable;
+                    return readable - parsed_ <= limit ? true : fail(kBadRequest);
+                }
+                const char* lineBegin = base + parsed_;
+                const char* eol = hit;
+                if (eol > lineBegin && eol[-1] == '\r') {
+                    --eol;
+                }
+                if (static_cast<size_t>(eol - lineBegin) > limit) {
+                    return fail(kBadRequest);
+                }
+                if (bodyState_ == kChunkSize) {
+                    size_t size = 0;
+                    if (!parseChunkSize(lineBegin, eol, &size)) {
+                        return fail(kBadRequest);
+                    }
+                    // bodyBytes_不会超过maxBodySize_，相减不会溢出
+                    if (maxBodySize_ > 0 && size > maxBodySize_ - bodyBytes_) {
+                        return fail(kBodyTooLarge);
+                    }
+                    bodyBytes_ += size;
+                    remaining_ = size;
+                    bodyState_ = size == 0 ? kChunkTrailer : kChunkData;
+                } else if (eol == lineBegin) {
+                    // trailer之后的空行，请求体结束
                     state_ = GOTALL;
-                    hasMore = false;
+                } else {
+                    trailerBytes_ += hit - lineBegin + 1;
+                    if (trailerBytes_ > kMaxHeaderBytes) {
+                        return fail(kBadRequest);
+                    }
                 }
-                buf->retriUntil(crlf+2);
+                parsed_ = hit - base + 1;
+                break;
             }
-        } else if (state_ == EXPECTBODY) {
-            // 解析请求体，可以看到这里没有做出处理，只支持GET请求
-            // FIXME
+        }
+        scanned_ = parsed_;
+        if (streaming_) {
+            buf->retrieve(parsed_);
+            parsed_ = scanned_ = 0;
+        } else if (maxBodySize_ > 0 && parsed_ - bodyBegin_ > maxBodySize_ + kMaxHeaderBytes) {
+            // 缓冲方式下收齐之前原始字节都留在输入缓冲区中，chunk大小行的扩展和很小的chunk
+            // 可以让原始字节远多于解码后的请求体，所以连同分帧一起限制
+            return fail(kBodyTooLarge);
         }
     }
-    return ok;
-}
\ No newline at end of file
+
+    if (streaming_) {
+        (*bodyCallback)(request_, std::string_view(), true);
+        return true;
+    }
+    // 首部收齐之后缓冲区可能已经搬移过，重新指向当前的缓冲区
+    const char* base = buf->peek();
+    request_.clearHeaders();
+    buildRequest(base);
+    if (bodyState_ == kFixedLength) {
+        request_.setBody(base + bodyBegin_, parsed_ - bodyBegin_);
+    } else {
+        request_.setBody(body_.data(), body_.size());
+    }
+    return true;
+}
@@ -1,7 +1,31 @@
+#pragma once
+
 #include "HttpRequest.h"
+#include "Timestamp.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
 
 class Buffer;
 
+/**
+ * 一个连接上的HTTP请求解析状态，保存在TcpConnection::setContext()中，在多次可读事件之间保留
+ * @details 解析时不从缓冲区中取走数据：请求的每一部分都记为相对buf->peek()的偏移，
+ * 缓冲区在两次可读事件之间扩容或搬移数据也不受影响；下一次从上次停下的位置继续，
+ * 每个字节只扫描一遍：用DelimiterSet(SIMD)同时找行内的分隔符和行尾。
+ * 请求完整后才把偏移换成指向缓冲区的string_view放进request()，
+ * 处理完请求后由调用者retrieve(requestBytes())并reset()
+ *
+ * 请求体按Content-Length或chunked分帧(两者同时出现按错误请求处理，避免请求走私)，有两种方式：
+ *   缓冲：整个请求体收齐后才gotAll()，Content-Length的请求体直接指向缓冲区，chunked的解码到body_中
+ *   流式：parseRequest()传入BodyCallback时，首部收齐后拷贝一份首部(request()改为指向这份拷贝)并从缓冲区中取走，
+ *        之后每收到一段请求体就交给回调并立即取走，大的上传不会整个堆在输入缓冲区中；
+ *        最后以last = true、data为空回调一次，request().body()为空
+ */
 class HttpContext {
 public:
     // HTTP请求状态
@@ -12,30 +36,125 @@ public:
         GOTALL,             // 解析完毕状态
     };
 
-    HttpContext(){}
+    // parseRequest()返回false的原因
+    enum ParseError {
+        kNoError,
+        kBadRequest,    // 格式错误，回复400
+        kBodyTooLarge,  // 请求体超过maxBodySize，回复413
+    };
+
+    // 请求体的一段，流式接收时使用；last为true时data为空，表示请求体结束
+    using BodyCallback = std::function<void(const HttpRequest&, std::string_view data, bool last)>;
 
-    bool parseRequest(Buffer* buf, Timestamp receiveTime);
+    // 请求行加首部的最大长度，超过时按错误请求处理，避免不完整的请求让输入缓冲区无限增长
+    static const size_t kMaxHeaderBytes = 64 * 1024;
+    static const size_t kDefaultMaxBodySize = 1024 * 1024;
+    // chunk大小所在行(含扩展)的最大长度
+    static const size_t kMaxChunkLine = 1024;
+
+    // @param maxBodySize 请求体(chunked时为解码后)的最大长度，0表示不限制；
+    //   缓冲方式下chunked请求体连同分帧的原始字节也不能超过maxBodySize + kMaxHeaderBytes
+    explicit HttpContext(size_t maxBodySize = kDefaultMaxBodySize) : maxBodySize_(maxBodySize) {}
+
+    /**
+     * 解析buf中的数据，可以反复调用，每次从上次停下的位置继续
+     * @param bodyCallback 不为空时请求体以流的方式交给它，同一个请求的每次调用都要传入
+     * @return 请求格式错误或请求体过大时返回false，原因见error()；数据不完整时返回true，gotAll()为false
+     */
+    bool parseRequest(Buffer* buf, Timestamp receiveTime, const BodyCallback* bodyCallback = nullptr);
 
     bool gotAll() const { return state_ == GOTALL; }
+    ParseError error() const { return error_; }
+
+    /**
+     * 客户端发送了"Expect: 100-continue"，在发送请求体之前等待"100 Continue"
+     * @return 首部已经收齐、需要回复100 Continue时返回true，每个请求只返回一次
+     */
+    bool takeContinueRequest() {
+        bool expect = expectContinue_ && state_ == EXPECTBODY;
+        expectContinue_ = false;
+        return expect;
+    }
 
-    // 重置HttpContext状态，异常安全
+    // gotAll()之后，请求在缓冲区中占用的字节数
+    size_t requestBytes() const { return parsed_; }
+
+    // 重置HttpContext状态，准备解析同一连接上的下一个请求，保留已分配的容量
     void reset() {
         state_ = EXPECTREQUESTLINE;
-        /**
-         * 构造一个临时空HttpRequest对象，和当前的成员HttpRequest对象交换置空
-         * 然后临时对象析构
-         */
-        HttpRequest dummy;
-        request_.swap(dummy);
+        error_ = kNoError;
+        parsed_ = 0;
+        scanned_ = 0;
+        space1_ = space2_ = question_ = colon_ = 0;
+        headerLines_.clear();
+        bodyState_ = kChunkSize;
+        streaming_ = false;
+        expectContinue_ = false;
+        remaining_ = 0;
+        bodyBytes_ = 0;
+        trailerBytes_ = 0;
+        body_.clear();
+        request_.clear();
     }
 
     const HttpRequest& request() const { return request_; }
 
     HttpRequest& request() { return request_; }
 private:
-    // 解析请求行，即起始行
-    bool processRequestLine(const char* begin, const char* end);
+    // 一行首部在缓冲区中的偏移：[begin, colon)是名字，(colon, end)是值
+    struct HeaderLine {
+        uint32_t begin;
+        uint32_t colon;
+        uint32_t end;
+    };
+
+    // EXPECTBODY状态下的进度
+    enum BodyState {
+        kFixedLength,    // Content-Length，还剩remaining_字节
+        kChunkSize,      // 等待chunk大小所在的行
+        kChunkData,      // chunk数据，还剩remaining_字节
+        kChunkDataEnd,   // chunk数据后面的CRLF
+        kChunkTrailer,   // 最后一个chunk之后的trailer首部，直到空行
+    };
+
+    bool parseHeaders(Buffer* buf, Timestamp receiveTime);
+    // 首部收齐后确定请求体的分帧方式，没有请求体时直接GOTALL
+    bool startBody(Buffer* buf, const BodyCallback* bodyCallback);
+    bool parseBody(Buffer* buf, const BodyCallback* bodyCallback);
+    // 解析请求行，即起始行，base是缓冲区中请求的开头，[begin, end)是去掉行尾的请求行
+    bool processRequestLine(const char* base, const char* begin, const char* end);
+    // 请求完整后，把记下的偏移换成指向base的string_view
+    void buildRequest(const char* base);
+    bool fail(ParseError error) {
+        error_ = error;
+        return false;
+    }
 
     HttpRequestParseState state_ = EXPECTREQUESTLINE;
+    ParseError error_ = kNoError;
+    size_t parsed_ = 0;   // 已经解析的完整行的总长度，下一行从这里开始
+    size_t scanned_ = 0;  // 当前行中已经扫描过的位置，下一次从这里继续找
+    // 当前行中已经找到的分隔符的偏移，0表示还没有找到：请求行的两个空格和第一个'?'，首部行的第一个':'
+    uint32_t space1_ = 0;
+    uint32_t space2_ = 0;
+    uint32_t question_ = 0;
+    uint32_t colon_ = 0;
+    // 请求行中路径和查询参数的偏移
+    uint32_t pathBegin_ = 0;
+    uint32_t pathEnd_ = 0;
+    uint32_t queryBegin_ = 0;
+    uint32_t queryEnd_ = 0;
+    std::vector<HeaderLine> headerLines_;
+
+    size_t maxBodySize_;
+    BodyState bodyState_ = kChunkSize;
+    bool streaming_ = false;
+    bool expectContinue_ = false;
+    size_t bodyBegin_ = 0;   // Content-Length请求体在缓冲区中的偏移
+    size_t remaining_ = 0;   // 当前chunk或Content-Length请求体还没有收到的字节数
+    size_t bodyBytes_ = 0;   // 已经收到的请求体字节数(chunked时为解码后)
+    size_t trailerBytes_ = 0; // 已经收到的trailer首部字节数
+    std::string body_;       // 缓冲方式下解码后的chunked请求体
+    std::string headerCopy_; // 流式接收时首部的拷贝
     HttpRequest request_;
-};
\ No newline at end of file
+};
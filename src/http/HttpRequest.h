@@ -1,11 +1,18 @@
 #pragma once
 
-#include "noncopyable.h"
 #include "Timestamp.h"
 
-#include <string>
-#include <unordered_map>
-
+#include <ctype.h>
+#include <strings.h>
+#include <string_view>
+#include <vector>
+
+/**
+ * 解析好的HTTP请求
+ * @details 方法、路径、查询参数、首部和请求体都是指向连接输入缓冲区的string_view，不拷贝数据；
+ * 只在HttpServer调用httpCallback_期间有效，回调返回后请求的字节从缓冲区中取走，
+ * 需要保留的内容要自己拷贝成std::string
+ */
 class HttpRequest {
 public:
     enum Method {
@@ -23,13 +30,24 @@ public:
         HTTP11
     };
 
+    struct Header {
+        std::string_view field;
+        std::string_view value;
+    };
+
+    // 路由匹配到的路径参数，名字指向HttpRouter中的路由表，值指向path()
+    struct Param {
+        std::string_view name;
+        std::string_view value;
+    };
+
     HttpRequest() {}
 
     void setVersion(Version v) { version_ = v; }
     Version version() const { return version_; }
 
     bool setMethod(const char* start, const char* end) {
-        std::string m(start, end);
+        std::string_view m(start, end - start);
         if (m == "GET") {
             method_ = GET;
         } else if (m == "POST") {
@@ -50,61 +68,90 @@ public:
     Method method() const { return method_; }
 
     const char* methodString() const {
-        std::string res = "INVALID";
         switch (method_) {
             case GET :
-                res = "GET";
-                break;
+                return "GET";
             case POST :
-                res = "POST";
-                break;
+                return "POST";
             case HEAD :
-                res = "HEAD";
-                break;
+                return "HEAD";
             case PUT :
-                res = "PUT";
-                break;
+                return "PUT";
             case DELETE :
-                res = "DELETE";
-                break;
+                return "DELETE";
             default :
-                break;
+                return "INVALID";
         }
-        return res.c_str();
     }
 
-    void setPath(const char* start, const char* end) { path_.assign(start, end); }
-    const std::string& path() const { return path_; }
+    void setPath(const char* start, const char* end) { path_ = std::string_view(start, end - start); }
+    std::string_view path() const { return path_; }
 
-    void setQuery(const char* start, const char* end) { query_.assign(start, end); }
-    const std::string& query() const { return query_; }
+    void setQuery(const char* start, const char* end) { query_ = std::string_view(start, end - start); }
+    std::string_view query() const { return query_; }
 
     void setReceiveTime(Timestamp t) { receiveTime_ = t; }
     Timestamp receiveTime() const { return receiveTime_; }
 
     void addHeader(const char* start, const char* colon, const char* end) {
-        std::string field(start, colon);
-        ++colon;
-        // 跳过vlaue前面的空格
-        while (colon < end && isspace(*colon)) ++colon;
-        std::string value(colon, end);
-        // 丢掉value后面的空格，通过重新截断大小完成
-        while (!value.empty() && isspace(value[value.size()-1])) value.resize(value.size()-1);
-        headers_[field] = value;
+        const char* valueBegin = colon + 1;
+        // 跳过value前后的空白
+        while (valueBegin < end && isspace(static_cast<unsigned char>(*valueBegin))) ++valueBegin;
+        while (end > valueBegin && isspace(static_cast<unsigned char>(end[-1]))) --end;
+        headers_.push_back(Header{std::string_view(start, colon - start),
+                                  std::string_view(valueBegin, end - valueBegin)});
+    }
+
+    /**
+     * 获取请求首部的值，首部名不区分大小写，不存在时返回空的string_view
+     * @details 首部一般只有十几个，顺序比较比建哈希表快，也不需要分配内存
+     */
+    std::string_view getHeader(std::string_view field) const {
+        for (const Header& header : headers_) {
+            if (header.field.size() == field.size() &&
+                ::strncasecmp(header.field.data(), field.data(), field.size()) == 0) {
+                return header.value;
+            }
+        }
+        return std::string_view();
     }
 
-    // 获取请求首部的对应值，不存在时，返回空字符串
-    std::string getHeadder(const std::string& field) const {
-        std::string res;
-        auto it = headers_.find(field);
-        if (it != headers_.end()) {
-            res = it->second;
+    // 按收到的顺序排列，同名首部出现多次时每次一项
+    const std::vector<Header>& headers() const { return headers_; }
+    void clearHeaders() { headers_.clear(); }
+
+    /**
+     * 完整的请求体：Content-Length的请求体直接指向输入缓冲区，chunked的请求体指向HttpContext中解码后的数据；
+     * 请求体以流的方式交给HttpServer::BodyCallback时为空
+     */
+    void setBody(const char* data, size_t len) { body_ = std::string_view(data, len); }
+    std::string_view body() const { return body_; }
+
+    // 由HttpRouter在匹配时设置，匹配失败回溯时用truncateParams()去掉多加的参数
+    void addParam(std::string_view name, std::string_view value) { params_.push_back(Param{name, value}); }
+    void truncateParams(size_t n) { params_.resize(n); }
+    const std::vector<Param>& params() const { return params_; }
+
+    // 路径参数的值，":id"和"*path"的名字分别是"id"和"path"，不存在时返回空的string_view
+    std::string_view param(std::string_view name) const {
+        for (const Param& param : params_) {
+            if (param.name == name) {
+                return param.value;
+            }
         }
-        return res;
+        return std::string_view();
     }
 
-    const std::unordered_map<std::string, std::string>& headers() const {
-        return headers_;
+    // 清空所有字段，保留headers_和params_的容量，同一个连接上的下一个请求不再分配内存
+    void clear() {
+        method_ = INVALID;
+        version_ = UNKNOWN;
+        path_ = std::string_view();
+        query_ = std::string_view();
+        receiveTime_ = Timestamp();
+        headers_.clear();
+        params_.clear();
+        body_ = std::string_view();
     }
 
     void swap(HttpRequest& other) {
@@ -115,12 +162,16 @@ public:
         swap(other.query_, query_);
         swap(other.receiveTime_, receiveTime_);
         swap(other.headers_, headers_);
+        swap(other.params_, params_);
+        swap(other.body_, body_);
     }
 private:
     Method method_ = INVALID;             // 请求方法
     Version version_ = UNKNOWN;           // 协议版本号
-    std::string path_;                    // 请求路径，即所请求的资源的URI
-    std::string query_;                   // 询问参数，即URI后跟？后的参数
+    std::string_view path_;               // 请求路径，即所请求的资源的URI
+    std::string_view query_;              // 询问参数，即URI后跟？后的参数
     Timestamp receiveTime_ ;              // 请求时间
-    std::unordered_map<std::string, std::string> headers_;  //请求首部
-};
\ No newline at end of file
+    std::vector<Header> headers_;         // 请求首部
+    std::vector<Param> params_;           // 路径参数
+    std::string_view body_;               // 请求体
+};
@@ -4,7 +4,7 @@
 #include <stdio.h>
 #include <string.h>
 
-void HttpResponse::appendToBuffer(Buffer* output) const {
+void HttpResponse::appendToBuffer(Buffer* output, bool withBody) const {
     // 响应行
     char buf[32];
     memset(buf, '\0', sizeof buf);
@@ -27,5 +27,7 @@ void HttpResponse::appendToBuffer(Buffer* output) const {
         output->append("\r\n");
     }
     output->append("\r\n");
-    output->append(body_);
+    if (withBody) {
+        output->append(body_);
+    }
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <string>
 #include <unordered_map>
 
 class Buffer;
@@ -13,6 +14,7 @@ public:
         K301MOVEDPERMANENTLY = 301,
         K400BADREQUEST = 400,
         K404NotFound =404,
+        K413PayloadTooLarge = 413,
     };
 
     explicit HttpResponse(bool close) : closeConnection_(close) {}
@@ -37,7 +39,12 @@ public:
 
     void setBody(const std::string& body){ body_ = body; }
 
-    void appendToBuffer(Buffer* output) const;
+    /**
+     * 把响应写入output
+     * @param withBody HEAD请求的响应为false：保留Content-Length，不写响应体，
+     * 否则长连接上多出的字节会被客户端当作下一个响应的开头
+     */
+    void appendToBuffer(Buffer* output, bool withBody = true) const;
 private:
     std::unordered_map<std::string, std::string> headers_;
     HttpStatusCode statusCode_ = UNKNOWN;
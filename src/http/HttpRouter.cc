@@ -0,0 +1,163 @@
+#include "HttpRouter.h"
+#include "Logging.h"
+
+#include <string.h>
+
+const int HttpRouter::kNumMethods;
+
+HttpRouter::HttpRouter()
+    : numRoutes_(0) {
+}
+
+HttpRouter::~HttpRouter() = default;
+
+void HttpRouter::addRoute(HttpRequest::Method method, std::string_view pattern, Handler handler) {
+    if (method <= HttpRequest::INVALID || method >= kNumMethods || pattern.empty() || pattern[0] != '/') {
+        LOG_FATAL << "HttpRouter::addRoute invalid route " << std::string(pattern);
+    }
+    Node* n = &trees_[method];
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        // 只有段首的':'和'*'表示参数，段中间的是普通字符
+        const bool segmentStart = pos > 0 && pattern[pos - 1] == '/';
+        if (segmentStart && pattern[pos] == ':') {
+            size_t end = pattern.find('/', pos);
+            if (end == std::string_view::npos) {
+                end = pattern.size();
+            }
+            std::string_view name = pattern.substr(pos + 1, end - pos - 1);
+            if (name.empty()) {
+                LOG_FATAL << "HttpRouter::addRoute empty parameter name in " << std::string(pattern);
+            }
+            if (!n->paramChild) {
+                n->paramChild = std::make_unique<Node>();
+                n->paramChild->paramName = std::string(name);
+            } else if (n->paramChild->paramName != name) {
+                LOG_FATAL << "HttpRouter::addRoute parameter :" << std::string(name) << " in " << std::string(pattern)
+                          << " conflicts with :" << n->paramChild->paramName;
+            }
+            n = n->paramChild.get();
+            pos = end;
+            continue;
+        }
+        if (segmentStart && pattern[pos] == '*') {
+            std::string_view name = pattern.substr(pos + 1);
+            if (name.find('/') != std::string_view::npos) {
+                LOG_FATAL << "HttpRouter::addRoute wildcard must be the last segment in " << std::string(pattern);
+            }
+            if (!n->wildcardChild) {
+                n->wildcardChild = std::make_unique<Node>();
+                n->wildcardChild->paramName = std::string(name);
+            } else if (n->wildcardChild->paramName != name) {
+                LOG_FATAL << "HttpRouter::addRoute wildcard *" << std::string(name) << " in " << std::string(pattern)
+                          << " conflicts with *" << n->wildcardChild->paramName;
+            }
+            n = n->wildcardChild.get();
+            break;
+        }
+
+        // 静态部分，直到下一个参数段或通配段
+        size_t end = pos + 1;
+        while (end < pattern.size() && !(pattern[end - 1] == '/' && (pattern[end] == ':' || pattern[end] == '*'))) {
+            ++end;
+        }
+        std::string_view run = pattern.substr(pos, end - pos);
+        pos = end;
+        while (!run.empty()) {
+            const size_t i = n->indices.find(run[0]);
+            if (i == std::string::npos) {
+                auto child = std::make_unique<Node>();
+                child->path = std::string(run);
+                n->indices.push_back(run[0]);
+                n->children.push_back(std::move(child));
+                n = n->children.back().get();
+                break;
+            }
+            Node* child = n->children[i].get();
+            size_t k = 0;
+            while (k < child->path.size() && k < run.size() && child->path[k] == run[k]) {
+                ++k;
+            }
+            if (k < child->path.size()) {
+                // 只有前k个字节相同，拆成公共前缀和余下的两个节点
+                auto prefix = std::make_unique<Node>();
+                prefix->path = child->path.substr(0, k);
+                child->path.erase(0, k);
+                prefix->indices.push_back(child->path[0]);
+                prefix->children.push_back(std::move(n->children[i]));
+                n->children[i] = std::move(prefix);
+                child = n->children[i].get();
+            }
+            n = child;
+            run.remove_prefix(k);
+        }
+    }
+
+    if (n->handler) {
+        LOG_FATAL << "HttpRouter::addRoute duplicate route " << std::string(pattern);
+    }
+    n->handler = std::move(handler);
+    ++numRoutes_;
+}
+
+const HttpRouter::Handler* HttpRouter::route(HttpRequest* req) const {
+    const HttpRequest::Method method = req->method();
+    if (method <= HttpRequest::INVALID || method >= kNumMethods) {
+        return nullptr;
+    }
+    req->truncateParams(0);
+    const Handler* handler = match(&trees_[method], req->path(), req);
+    if (handler == nullptr && method == HttpRequest::HEAD) {
+        req->truncateParams(0);
+        handler = match(&trees_[HttpRequest::GET], req->path(), req);
+    }
+    return handler;
+}
+
+const HttpRouter::Handler* HttpRouter::match(const Node* n, std::string_view path, HttpRequest* req) {
+    if (path.empty()) {
+        if (n->handler) {
+            return &n->handler;
+        }
+        // "/static/*path"也匹配"/static/"，参数为空
+        if (n->wildcardChild) {
+            req->addParam(n->wildcardChild->paramName, path);
+            return &n->wildcardChild->handler;
+        }
+        return nullptr;
+    }
+
+    // 静态子节点的首字节互不相同，最多一个候选
+    if (!n->indices.empty()) {
+        const void* hit = memchr(n->indices.data(), path[0], n->indices.size());
+        if (hit != nullptr) {
+            const Node* child = n->children[static_cast<const char*>(hit) - n->indices.data()].get();
+            if (path.size() >= child->path.size() &&
+                memcmp(path.data(), child->path.data(), child->path.size()) == 0) {
+                if (const Handler* handler = match(child, path.substr(child->path.size()), req)) {
+                    return handler;
+                }
+            }
+        }
+    }
+
+    // 参数段匹配到下一个'/'为止，不能为空
+    if (n->paramChild && path[0] != '/') {
+        size_t end = path.find('/');
+        if (end == std::string_view::npos) {
+            end = path.size();
+        }
+        const size_t mark = req->params().size();
+        req->addParam(n->paramChild->paramName, path.substr(0, end));
+        if (const Handler* handler = match(n->paramChild.get(), path.substr(end), req)) {
+            return handler;
+        }
+        req->truncateParams(mark);
+    }
+
+    if (n->wildcardChild) {
+        req->addParam(n->wildcardChild->paramName, path);
+        return &n->wildcardChild->handler;
+    }
+    return nullptr;
+}
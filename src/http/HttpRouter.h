@@ -0,0 +1,73 @@
+#pragma once
+
+#include "HttpRequest.h"
+#include "noncopyable.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class HttpResponse;
+
+// 按请求方法和路径分发请求的路由表，每个方法一棵压缩前缀树(radix tree)
+// 路由模式由'/'分隔的段组成，每段可以是：
+//   静态段     /users/list
+//   参数段     /users/:id        匹配一个非空的段，不含'/'
+//   通配段     /static/*path     只能在最后，匹配余下的全部路径(可以为空)
+// 静态的部分按公共前缀压缩成一个节点，子节点按首字节查找，
+// 查找的代价只和路径长度、段数有关，与路由的数量无关。
+// 同一位置优先匹配静态段，其次参数段，最后通配段，前面的匹配失败时回溯尝试后面的。
+// 匹配到的参数放进HttpRequest::params()，名字指向路由表，值指向请求路径，都不拷贝。
+// HEAD请求没有匹配的HEAD路由时按GET路由处理，HttpServer不发送它的响应体。
+// addRoute()要在HttpServer::start()之前调用，之后多个IO线程只读地并发查找。
+class HttpRouter : noncopyable {
+public:
+    using Handler = std::function<void (const HttpRequest&, HttpResponse*)>;
+
+    HttpRouter();
+    ~HttpRouter();
+
+    /**
+     * 添加路由，同一方法下重复的路由、同一位置名字不同的参数段、不在最后的通配段是编程错误，LOG_FATAL
+     * @param pattern 以'/'开头的路由模式
+     */
+    void addRoute(HttpRequest::Method method, std::string_view pattern, Handler handler);
+
+    void get(std::string_view pattern, Handler handler) { addRoute(HttpRequest::GET, pattern, std::move(handler)); }
+    void head(std::string_view pattern, Handler handler) { addRoute(HttpRequest::HEAD, pattern, std::move(handler)); }
+    void post(std::string_view pattern, Handler handler) { addRoute(HttpRequest::POST, pattern, std::move(handler)); }
+    void put(std::string_view pattern, Handler handler) { addRoute(HttpRequest::PUT, pattern, std::move(handler)); }
+    void del(std::string_view pattern, Handler handler) { addRoute(HttpRequest::DELETE, pattern, std::move(handler)); }
+
+    /**
+     * 按req的方法和路径查找处理函数，匹配到的参数加入req的params()
+     * HEAD请求先查HEAD路由，没有匹配时再查GET路由
+     * @return 没有匹配的路由时返回nullptr
+     */
+    const Handler* route(HttpRequest* req) const;
+
+    bool empty() const { return numRoutes_ == 0; }
+    size_t numRoutes() const { return numRoutes_; }
+
+private:
+    struct Node {
+        std::string path;      // 压缩后的静态前缀，参数节点和通配节点为空
+        std::string indices;   // 静态子节点path的首字节，与children一一对应
+        std::vector<std::unique_ptr<Node>> children;
+        std::unique_ptr<Node> paramChild;     // ":name"
+        std::unique_ptr<Node> wildcardChild;  // "*name"
+        std::string paramName;                // 参数节点和通配节点的参数名
+        Handler handler;
+    };
+
+    // 请求方法的个数，HttpRequest::Method从INVALID到DELETE
+    static const int kNumMethods = HttpRequest::DELETE + 1;
+
+    // n自身的前缀已经匹配，在它的子树中匹配path的剩余部分
+    static const Handler* match(const Node* n, std::string_view path, HttpRequest* req);
+
+    Node trees_[kNumMethods];
+    size_t numRoutes_;
+};
@@ -3,8 +3,50 @@
 #include "HttpResponse.h"
 #include "HttpContext.h"
 
+#include <string.h>
+#include <strings.h>
+#include <any>
 #include <memory>
 
+const int HttpServer::kDefaultMaxRequestsPerConnection;
+
+/**
+ * 长连接上的请求按到达顺序处理，一次可读事件中读到的多个请求(pipelining)全部解析完，
+ * 响应按顺序追加到output中，最后一次send()发出；
+ * 决定关闭连接之后不再解析后面的请求，之后收到的数据也直接丢弃
+ */
+struct HttpServer::ConnectionState {
+    explicit ConnectionState(size_t maxBodySize) : context(maxBodySize) {}
+
+    HttpContext context;
+    Buffer output;
+    int requests = 0;
+    bool closing = false;
+};
+
+namespace {
+
+// Connection首部的值是逗号分隔的选项列表，选项不区分大小写
+bool hasConnectionOption(std::string_view value, const char* option) {
+    const size_t len = strlen(option);
+    while (!value.empty()) {
+        size_t comma = value.find(',');
+        std::string_view item = value.substr(0, comma);
+        while (!item.empty() && (item.front() == ' ' || item.front() == '\t')) item.remove_prefix(1);
+        while (!item.empty() && (item.back() == ' ' || item.back() == '\t')) item.remove_suffix(1);
+        if (item.size() == len && ::strncasecmp(item.data(), option, len) == 0) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+}  // namespace
+
 /**
  * 默认的http回调函数
  * 设置响应状态码，响应信息并关闭连接
@@ -20,12 +62,15 @@ HttpServer::HttpServer(EventLoop* loop,
                         const std::string& name,
                         TcpServer::Option option)
     : server_(loop, listAddr, name, option),
-      httpCallback_(defaultHttpCallback) {
+      httpCallback_(defaultHttpCallback),
+      maxBodySize_(HttpContext::kDefaultMaxBodySize),
+      maxRequestsPerConnection_(kDefaultMaxRequestsPerConnection) {
     server_.setConnectionCallback(
         std::bind(&HttpServer::onConnection, this, std::placeholders::_1));
     server_.setMessageCallback(
         std::bind(&HttpServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
     server_.setThreadNum(4);
+    server_.setIdleTimeout(kDefaultKeepAliveTimeout);
 }
 
 void HttpServer::start() {
@@ -35,9 +80,11 @@ void HttpServer::start() {
 
 void HttpServer::onConnection(const TcpConnectionPtr& conn) {
     if (conn->connected()) {
-        LOG_INFO << "new Connection arrived";
+        LOG_DEBUG << "new Connection arrived";
+        // 每个连接一个解析器，请求分多次到达时从上次停下的位置继续解析
+        conn->setContext(ConnectionState(maxBodySize_));
     } else {
-        LOG_INFO << "Connection closed";
+        LOG_DEBUG << "Connection closed";
     }
 }
 
@@ -45,49 +92,82 @@ void HttpServer::onConnection(const TcpConnectionPtr& conn) {
 void HttpServer::onMessage(const TcpConnectionPtr& conn,
                             Buffer* buf,
                             Timestamp receiveTime) {
-    // LOG_INFO << "HttpServer::onMessage";
-    std::unique_ptr<HttpContext> context(std::make_unique<HttpContext>());
-
-#if 0
-    // 打印请求报文
-    sdt::string request = buf->GetBufferAllAsString();
-    std::cout << request << std::endl;
-#endif
-    // 进行状态机解析
-    // 错误则发送 BAD REQUEST 半关闭
-    if (!context->parseRequest(buf, receiveTime)) {
-        LOG_INFO << "parseRequest failed!";
-        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-        conn->shutdown();
+    ConnectionState* state = std::any_cast<ConnectionState>(conn->getMutableContext());
+    if (state->closing) {
+        // 已经决定关闭连接，等待对端关闭，后面的数据不再处理
+        buf->retrieveAll();
+        return;
     }
+    HttpContext* context = &state->context;
 
-    // 如果成功解析
-    if (context->gotAll()) {
-        LOG_INFO << "parseRequest success!";
-        onRequest(conn, context->request());
+    // 设置了bodyCallback_时请求体以流的方式交给它
+    HttpContext::BodyCallback sink;
+    if (bodyCallback_) {
+        sink = [this, &conn](const HttpRequest& req, std::string_view data, bool last) {
+            bodyCallback_(conn, req, data, last);
+        };
+    }
+
+    // 缓冲区中可能有多个请求，逐个解析处理，直到数据不完整或者要关闭连接
+    while (!state->closing) {
+        // 进行状态机解析
+        // 错误则回复 BAD REQUEST 或 PAYLOAD TOO LARGE 并半关闭
+        if (!context->parseRequest(buf, receiveTime, bodyCallback_ ? &sink : nullptr)) {
+            LOG_DEBUG << "parseRequest failed!";
+            if (context->error() == HttpContext::kBodyTooLarge) {
+                state->output.append("HTTP/1.1 413 Payload Too Large\r\nConnection: close\r\n\r\n");
+            } else {
+                state->output.append("HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n");
+            }
+            state->closing = true;
+            break;
+        }
+
+        // 客户端在等待100 Continue才发送请求体，排在前面请求的响应之后
+        if (context->takeContinueRequest()) {
+            state->output.append("HTTP/1.1 100 Continue\r\n\r\n");
+        }
+        if (!context->gotAll()) {
+            break;
+        }
+
+        // request()中的字段指向buf，处理完之后才能取走请求的数据
+        state->closing = onRequest(context->request(), state);
+        buf->retrieve(context->requestBytes());
         context->reset();
     }
+
+    // 这次读到的所有请求的响应一起发送
+    if (state->output.readableBytes() > 0) {
+        conn->send(&state->output);
+    }
+    if (state->closing) {
+        buf->retrieveAll();
+        conn->shutdown();
+    }
 }
 
-void HttpServer::onRequest(const TcpConnectionPtr& conn, const HttpRequest& req) {
-    const std::string connection = req.getHeadder("Connection");
+bool HttpServer::onRequest(HttpRequest& req, ConnectionState* state) {
+    const std::string_view connection = req.getHeader("Connection");
 
-    // 判断长连接还是短连接
-    bool close = connection == "close" ||
-        (req.version() == HttpRequest::HTTP10 && connection != "Keep-Alive");
-    // TODO:这里有问题，但是强制改写了
-    close = true;
+    // 判断长连接还是短连接：HTTP/1.1默认长连接，HTTP/1.0要显式要求Keep-Alive
+    bool close = hasConnectionOption(connection, "close") ||
+        (req.version() == HttpRequest::HTTP10 && !hasConnectionOption(connection, "keep-alive"));
+    ++state->requests;
+    if (maxRequestsPerConnection_ > 0 && state->requests >= maxRequestsPerConnection_) {
+        close = true;
+    }
     // 响应信息
     HttpResponse response(close);
-    // httpCallback_ 由用户传入，怎么写响应体由用户决定
-    // 此处初始化了一些response的信息，比如响应码，回复OK
-    httpCallback_(req,&response);
-    Buffer buf;
-    response.appendToBuffer(&buf);
-    // TODO:需要重载 TcpConnection::send 使其可以接收一个缓冲区
-    conn->send(&buf);
-    if (response.closeConnection()) {
-        conn->shutdown();
+    // 先按路由表分发，没有匹配的路由时交给httpCallback_
+    // 处理函数由用户传入，怎么写响应体由用户决定
+    const HttpRouter::Handler* handler = router_.empty() ? nullptr : router_.route(&req);
+    if (handler != nullptr) {
+        (*handler)(req, &response);
+    } else {
+        httpCallback_(req, &response);
     }
+    // HEAD的响应只有首部，Content-Length仍按响应体的长度
+    response.appendToBuffer(&state->output, req.method() != HttpRequest::HEAD);
+    return response.closeConnection();
 }
-
@@ -1,9 +1,11 @@
 #pragma once
 
+#include "HttpRouter.h"
 #include "TcpServer.h"
 #include "noncopyable.h"
 #include "Logging.h"
 #include <string>
+#include <string_view>
 
 class HttpRequest;
 class HttpResponse;
@@ -12,23 +14,61 @@ class HttpServer : noncopyable {
 public:
     using HttpCallback = std::function<void (const HttpRequest&, HttpResponse*)>;
 
+    static constexpr double kDefaultKeepAliveTimeout = 60.0;
+    static const int kDefaultMaxRequestsPerConnection = 1000;
+    // 流式接收请求体：每收到一段调用一次，最后以last = true、data为空调用一次，然后才调用HttpCallback
+    using BodyCallback = std::function<void (const TcpConnectionPtr&, const HttpRequest&,
+                                             std::string_view data, bool last)>;
+
     HttpServer(EventLoop* loop,
                 const InetAddress& listAddr,
                 const std::string& name,
                 TcpServer::Option option = TcpServer::kNoReusePort);
     
     EventLoop* getLoop() const { return server_.getLoop(); }
+    // 没有匹配的路由时调用，默认回复404
     void setHttpCallback(const HttpCallback& cb) {
         httpCallback_ = cb;
     }
+    // 按方法和路径分发请求的路由表，在start()之前添加路由
+    HttpRouter& router() { return router_; }
+    /**
+     * 设置后请求体不再缓冲到HttpRequest::body()中，而是边收边交给cb，适合大的上传
+     * 在start()之前设置
+     */
+    void setBodyCallback(const BodyCallback& cb) {
+        bodyCallback_ = cb;
+    }
+    // 请求体的最大长度，超过时回复413并关闭连接，0表示不限制；只影响之后建立的连接
+    void setMaxBodySize(size_t maxBodySize) {
+        maxBodySize_ = maxBodySize;
+    }
+    /**
+     * 长连接空闲超时，单位秒，在start()之前调用，<= 0表示不限制
+     * @details 用TcpServer的读空闲超时实现，这么久没有收到任何数据(包括停在半个请求上)的连接被关闭
+     */
+    void setKeepAliveTimeout(double seconds) {
+        server_.setIdleTimeout(seconds);
+    }
+    // 一个连接上最多处理的请求数，最后一个请求的响应带上"Connection: close"，0表示不限制
+    void setMaxRequestsPerConnection(int maxRequests) {
+        maxRequestsPerConnection_ = maxRequests;
+    }
     void start();
 private:
     void onConnection(const TcpConnectionPtr& conn);
     void onMessage(const TcpConnectionPtr& conn,
                     Buffer* buf,
                     Timestamp receiveTime);
-    void onRequest(const TcpConnectionPtr&, const HttpRequest&);
+    // 每个连接的状态，保存在TcpConnection::setContext()中
+    struct ConnectionState;
+    // 把响应追加到state的输出缓冲区中，返回是否要在响应之后关闭连接
+    bool onRequest(HttpRequest& req, ConnectionState* state);
 
     TcpServer server_;
     HttpCallback httpCallback_;
+    HttpRouter router_;
+    BodyCallback bodyCallback_;
+    size_t maxBodySize_;
+    int maxRequestsPerConnection_;
 };
\ No newline at end of file
@@ -4,9 +4,12 @@
 #include "HttpContext.h"
 #include "Timestamp.h"
 
+#include <iostream>
+
 extern char favicon[555];
 bool benchmark = false;
 
+// 没有匹配的路由时调用：打印请求，回复404
 void onRequest(const HttpRequest& req, HttpResponse* resp)
 {
     std::cout << "Headers " << req.methodString() << " " << req.path() << std::endl;
@@ -14,52 +17,56 @@ void onRequest(const HttpRequest& req, HttpResponse* resp)
     // 打印头部
     if (!benchmark)
     {
-        const std::unordered_map<std::string, std::string>& headers = req.headers();
-        for (const auto& header : headers)
+        for (const HttpRequest::Header& header : req.headers())
         {
-            std::cout << header.first << ": " << header.second << std::endl;
+            std::cout << header.field << ": " << header.value << std::endl;
         }
     }
 
-    if (req.path() == "/")
-    {
-        resp->setStatusCode(HttpResponse::K200OK);
-        resp->setStatusMessage("OK");
-        resp->setContentType("text/html");
-        resp->addHeader("Server", "Muduo");
-        std::string now = Timestamp::now().toFormattedString();
-        resp->setBody("<html><head><title>This is title</title></head>"
-            "<body><h1>Hello</h1>Now is " + now +
-            "</body></html>");
-    }
-    else if (req.path() == "/favicon.ico")
-    {
-        resp->setStatusCode(HttpResponse::K200OK);
-        resp->setStatusMessage("OK");
-        resp->setContentType("image/png");
-        resp->setBody(std::string(favicon, sizeof favicon));
-    }
-    else if (req.path() == "/hello")
-    {
-        resp->setStatusCode(HttpResponse::K200OK);
-        resp->setStatusMessage("OK");
-        resp->setContentType("text/plain");
-        resp->addHeader("Server", "Muduo");
-        resp->setBody("hello, world!\n");
-    }
-    else
-    {
-        resp->setStatusCode(HttpResponse::K404NotFound);
-        resp->setStatusMessage("Not Found");
-        resp->setCloseConnection(true);
-    }
+    resp->setStatusCode(HttpResponse::K404NotFound);
+    resp->setStatusMessage("Not Found");
+    resp->setCloseConnection(true);
+}
+
+void onIndex(const HttpRequest&, HttpResponse* resp)
+{
+    resp->setStatusCode(HttpResponse::K200OK);
+    resp->setStatusMessage("OK");
+    resp->setContentType("text/html");
+    resp->addHeader("Server", "Muduo");
+    std::string now = Timestamp::now().toFormattedString();
+    resp->setBody("<html><head><title>This is title</title></head>"
+        "<body><h1>Hello</h1>Now is " + now +
+        "</body></html>");
+}
 
+void onFavicon(const HttpRequest&, HttpResponse* resp)
+{
+    resp->setStatusCode(HttpResponse::K200OK);
+    resp->setStatusMessage("OK");
+    resp->setContentType("image/png");
+    resp->setBody(std::string(favicon, sizeof favicon));
+}
+
+void onHello(const HttpRequest& req, HttpResponse* resp)
+{
+    resp->setStatusCode(HttpResponse::K200OK);
+    resp->setStatusMessage("OK");
+    resp->setContentType("text/plain");
+    resp->addHeader("Server", "Muduo");
+    // /hello/:name 带路径参数，/hello 没有
+    std::string_view name = req.param("name");
+    resp->setBody("hello, " + (name.empty() ? std::string("world") : std::string(name)) + "!\n");
 }
 
 int main(int argc, char* argv[])
 {
     EventLoop loop;
     HttpServer server(&loop, InetAddress(8080), "http-server");
+    server.router().get("/", onIndex);
+    server.router().get("/favicon.ico", onFavicon);
+    server.router().get("/hello", onHello);
+    server.router().get("/hello/:name", onHello);
     server.setHttpCallback(onRequest);
     server.start();
     loop.loop();
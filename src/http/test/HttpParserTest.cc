@@ -0,0 +1,419 @@
+#include "HttpContext.h"
+#include "Buffer.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <string_view>
+
+// HttpContext的行为测试：请求一次完整到达、逐字节到达和流水线(pipelining)到达的结果相同，
+// chunked请求体的扩展和trailer，bare LF行尾，Content-Length与Transfer-Encoding同时出现时拒绝(请求走私)，
+// 首部、chunk大小行、trailer和请求体的长度限制，流式接收请求体
+// 失败时返回非0
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                      \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            ++g_failures;                                                \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);       \
+        }                                                                \
+    } while (0)
+
+// 解析出来的请求，string_view指向的缓冲区会被取走，拷贝出来比较
+struct Parsed {
+    bool ok = false;
+    bool gotAll = false;
+    HttpContext::ParseError error = HttpContext::kNoError;
+    HttpRequest::Method method = HttpRequest::INVALID;
+    HttpRequest::Version version = HttpRequest::Version::UNKNOWN;
+    std::string path;
+    std::string query;
+    std::string headers;  // "name=value\n"...
+    std::string body;
+    size_t requestBytes = 0;
+
+    bool operator==(const Parsed& rhs) const {
+        return ok == rhs.ok && gotAll == rhs.gotAll && error == rhs.error && method == rhs.method &&
+               version == rhs.version && path == rhs.path && query == rhs.query && headers == rhs.headers &&
+               body == rhs.body && requestBytes == rhs.requestBytes;
+    }
+};
+
+Parsed capture(const HttpContext& context, bool ok) {
+    Parsed p;
+    p.ok = ok;
+    p.gotAll = context.gotAll();
+    p.error = context.error();
+    if (ok && context.gotAll()) {
+        const HttpRequest& req = context.request();
+        p.method = req.method();
+        p.version = req.version();
+        p.path = std::string(req.path());
+        p.query = std::string(req.query());
+        for (const HttpRequest::Header& header : req.headers()) {
+            p.headers += std::string(header.field) + "=" + std::string(header.value) + "\n";
+        }
+        p.body = std::string(req.body());
+        p.requestBytes = context.requestBytes();
+    }
+    return p;
+}
+
+// 每次到达step字节，每次都调用parseRequest()，直到出错或请求完整
+Parsed parse(const std::string& data, size_t step, size_t maxBodySize = HttpContext::kDefaultMaxBodySize) {
+    HttpContext context(maxBodySize);
+    Buffer buf;
+    size_t fed = 0;
+    while (fed < data.size()) {
+        const size_t n = std::min(step, data.size() - fed);
+        buf.append(data.data() + fed, n);
+        fed += n;
+        const bool ok = context.parseRequest(&buf, Timestamp::now());
+        if (!ok || context.gotAll()) {
+            // 请求完整时后面不应该还有数据(测试用例都是单个请求)
+            if (ok && fed != data.size()) {
+                printf("FAIL request complete after %zu of %zu bytes\n", fed, data.size());
+                ++g_failures;
+            }
+            return capture(context, ok);
+        }
+    }
+    return capture(context, true);
+}
+
+// 一次完整到达、每次一个字节、每次7个字节的结果都相同
+Parsed parseAllWays(const std::string& data, size_t maxBodySize = HttpContext::kDefaultMaxBodySize) {
+    Parsed whole = parse(data, data.size(), maxBodySize);
+    Parsed bytes = parse(data, 1, maxBodySize);
+    Parsed sevens = parse(data, 7, maxBodySize);
+    if (!(whole == bytes) || !(whole == sevens)) {
+        ++g_failures;
+        printf("FAIL split parsing differs for request:\n%s\n", data.substr(0, 200).c_str());
+    }
+    return whole;
+}
+
+void testGet() {
+    Parsed p = parseAllWays(
+        "GET /search?q=a+b&x=1?2 HTTP/1.1\r\n"
+        "Host: example.com\r\n"
+        "X-Spaces: \t padded value \t\r\n"
+        "X-Colon: a:b:c\r\n"
+        "\r\n");
+    CHECK(p.ok && p.gotAll);
+    CHECK(p.method == HttpRequest::GET);
+    CHECK(p.version == HttpRequest::Version::HTTP11);
+    CHECK(p.path == "/search");
+    CHECK(p.query == "q=a+b&x=1?2");
+    CHECK(p.headers == "Host=example.com\nX-Spaces=padded value\nX-Colon=a:b:c\n");
+    CHECK(p.body.empty());
+
+    // 行尾只有LF，没有查询参数，HTTP/1.0
+    p = parseAllWays("HEAD /index.html HTTP/1.0\nHost: a\n\n");
+    CHECK(p.ok && p.gotAll);
+    CHECK(p.method == HttpRequest::HEAD);
+    CHECK(p.version == HttpRequest::Version::HTTP10);
+    CHECK(p.path == "/index.html");
+    CHECK(p.query.empty());
+    CHECK(p.headers == "Host=a\n");
+}
+
+void testBadRequestLine() {
+    const char* const bad[] = {
+        "GET /\r\n\r\n",
+        "GET / HTTP/1.1 extra\r\n\r\n",
+        " GET / HTTP/1.1\r\n\r\n",
+        "BREW /pot HTTP/1.1\r\n\r\n",
+        "GET / HTTP/2.0\r\n\r\n",
+        "GET / HTTP/1.2\r\n\r\n",
+        "GET / HTTP/1.1\r\nNoColon\r\n\r\n",
+        "GET / HTTP/1.1\r\n: empty name\r\n\r\n",
+    };
+    for (const char* request : bad) {
+        Parsed p = parseAllWays(request);
+        if (p.ok || p.error != HttpContext::kBadRequest) {
+            ++g_failures;
+            printf("FAIL accepted bad request: %s\n", request);
+        }
+    }
+}
+
+void testContentLength() {
+    Parsed p = parseAllWays(
+        "POST /upload HTTP/1.1\r\n"
+        "Content-Length: 11\r\n"
+        "Content-Length: 11\r\n"
+        "\r\n"
+        "hello world");
+    CHECK(p.ok && p.gotAll);
+    CHECK(p.method == HttpRequest::POST);
+    CHECK(p.body == "hello world");
+
+    // Content-Length: 0和没有Content-Length都没有请求体
+    p = parseAllWays("POST /a HTTP/1.1\r\nContent-Length: 0\r\n\r\n");
+    CHECK(p.ok && p.gotAll && p.body.empty());
+
+    const char* const bad[] = {
+        "POST / HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 6\r\n\r\nhello!",
+        "POST / HTTP/1.1\r\nContent-Length: +5\r\n\r\nhello",
+        "POST / HTTP/1.1\r\nContent-Length: 5 5\r\n\r\nhello",
+        "POST / HTTP/1.1\r\nContent-Length: 0x5\r\n\r\nhello",
+        "POST / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\nhello",
+    };
+    for (const char* request : bad) {
+        p = parseAllWays(request);
+        if (p.ok || p.error != HttpContext::kBadRequest) {
+            ++g_failures;
+            printf("FAIL accepted bad Content-Length: %s\n", request);
+        }
+    }
+}
+
+void testChunked() {
+    Parsed p = parseAllWays(
+        "POST /chunked HTTP/1.1\r\n"
+        "Transfer-Encoding: gzip, chunked\r\n"
+        "\r\n"
+        "5;name=value;other\r\n"
+        "hello\r\n"
+        "1 ; ext\r\n"
+        " \r\n"
+        "A\r\n"
+        "0123456789\r\n"
+        "0\r\n"
+        "X-Trailer: yes\r\n"
+        "X-Other: 1\r\n"
+        "\r\n");
+    CHECK(p.ok && p.gotAll);
+    CHECK(p.body == "hello 0123456789");
+    // trailer不加入首部
+    CHECK(p.headers == "Transfer-Encoding=gzip, chunked\n");
+
+    // 大写的十六进制，bare LF，没有trailer
+    p = parseAllWays("POST / HTTP/1.1\nTransfer-Encoding: chunked\n\n1F\n0123456789012345678901234567890\n0\n\n");
+    CHECK(p.ok && p.gotAll);
+    CHECK(p.body == "0123456789012345678901234567890");
+
+    const char* const bad[] = {
+        // Content-Length和Transfer-Encoding同时出现，无论先后
+        "POST / HTTP/1.1\r\nContent-Length: 5\r\nTransfer-Encoding: chunked\r\n\r\n0\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 5\r\n\r\n0\r\n\r\n",
+        // 最后一个编码不是chunked
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked, gzip\r\n\r\n0\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: identity\r\n\r\nhello",
+        // chunk大小不是十六进制，数据后面不是CRLF
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\nhello\r\n0\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n;ext\r\n0\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhelloXX\r\n0\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5 x\r\nhello\r\n0\r\n\r\n",
+        "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nFFFFFFFFFFFFFFFFF\r\n",
+    };
+    for (const char* request : bad) {
+        p = parseAllWays(request);
+        if (p.ok || p.error != HttpContext::kBadRequest) {
+            ++g_failures;
+            printf("FAIL accepted bad chunked request: %s\n", request);
+        }
+    }
+}
+
+void testHeaderLimits() {
+    // 首部超过kMaxHeaderBytes：一直没有行尾，或者很多行
+    std::string longLine = "GET /" + std::string(HttpContext::kMaxHeaderBytes, 'a');
+    Parsed p = parse(longLine, 4096);
+    CHECK(!p.ok && p.error == HttpContext::kBadRequest);
+    std::string manyHeaders = "GET / HTTP/1.1\r\n";
+    while (manyHeaders.size() <= HttpContext::kMaxHeaderBytes) {
+        manyHeaders += "X-Filler: " + std::string(100, 'x') + "\r\n";
+    }
+    manyHeaders += "\r\n";
+    p = parse(manyHeaders, manyHeaders.size());
+    CHECK(!p.ok && p.error == HttpContext::kBadRequest);
+}
+
+void testBodyLimits() {
+    // Content-Length超过maxBodySize，不等请求体到达就拒绝
+    Parsed p = parse("POST / HTTP/1.1\r\nContent-Length: 101\r\n\r\n", 1000, 100);
+    CHECK(!p.ok && p.error == HttpContext::kBodyTooLarge);
+    p = parseAllWays("POST / HTTP/1.1\r\nContent-Length: 100\r\n\r\n" + std::string(100, 'b'), 100);
+    CHECK(p.ok && p.gotAll && p.body.size() == 100);
+
+    // chunked解码后超过maxBodySize
+    std::string chunked = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+    std::string body = chunked + "32\r\n" + std::string(50, 'c') + "\r\n" + "32\r\n" + std::string(50, 'c') + "\r\n";
+    p = parseAllWays(body + "0\r\n\r\n", 100);
+    CHECK(p.ok && p.gotAll && p.body.size() == 100);
+    p = parseAllWays(body + "1\r\nc\r\n0\r\n\r\n", 100);
+    CHECK(!p.ok && p.error == HttpContext::kBodyTooLarge);
+
+    // chunk大小行(含扩展)超过kMaxChunkLine
+    std::string ext(HttpContext::kMaxChunkLine, 'e');
+    p = parse(chunked + "1;" + ext + "\r\nc\r\n0\r\n\r\n", 64);
+    CHECK(!p.ok && p.error == HttpContext::kBadRequest);
+    p = parse(chunked + "1;" + ext, 64);
+    CHECK(!p.ok && p.error == HttpContext::kBadRequest);
+
+    // trailer总长超过kMaxHeaderBytes
+    std::string trailers = chunked + "0\r\n";
+    while (trailers.size() <= chunked.size() + HttpContext::kMaxHeaderBytes) {
+        trailers += "X-Trailer: " + std::string(100, 't') + "\r\n";
+    }
+    p = parse(trailers + "\r\n", 4096);
+    CHECK(!p.ok && p.error == HttpContext::kBadRequest);
+
+    // 缓冲方式下很小的chunk加很长的扩展，解码后没有超过maxBodySize，但原始字节超过maxBodySize + kMaxHeaderBytes
+    std::string framing = chunked;
+    const std::string tinyChunk = "1;" + std::string(HttpContext::kMaxChunkLine - 10, 'e') + "\r\nc\r\n";
+    while (framing.size() <= chunked.size() + 1000 + HttpContext::kMaxHeaderBytes) {
+        framing += tinyChunk;
+    }
+    p = parse(framing + "0\r\n\r\n", 4096, 1000);
+    CHECK(!p.ok && p.error == HttpContext::kBodyTooLarge);
+}
+
+// 同一个缓冲区中连续的多个请求，逐个解析、取走、reset()
+void testPipelining() {
+    const std::string requests[] = {
+        "GET /first HTTP/1.1\r\nHost: a\r\n\r\n",
+        "POST /second HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc",
+        "POST /third HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n2\r\nde\r\n0\r\n\r\n",
+        "GET /fourth?x HTTP/1.0\r\n\r\n",
+    };
+    const char* const paths[] = {"/first", "/second", "/third", "/fourth"};
+    const char* const bodies[] = {"", "abc", "de", ""};
+    std::string all;
+    for (const std::string& request : requests) {
+        all += request;
+    }
+    // 一次全部到达，或者每次到达step字节
+    const size_t steps[] = {all.size(), 1, 5, 13};
+    for (size_t step : steps) {
+        HttpContext context;
+        Buffer buf;
+        size_t fed = 0;
+        int done = 0;
+        while (done < 4) {
+            if (!context.parseRequest(&buf, Timestamp::now())) {
+                ++g_failures;
+                printf("FAIL pipelined request %d rejected, step %zu\n", done, step);
+                break;
+            }
+            if (context.gotAll()) {
+                const HttpRequest& req = context.request();
+                if (req.path() != paths[done] || req.body() != bodies[done] ||
+                    context.requestBytes() != requests[done].size()) {
+                    ++g_failures;
+                    printf("FAIL pipelined request %d, step %zu\n", done, step);
+                }
+                buf.retrieve(context.requestBytes());
+                context.reset();
+                ++done;
+                continue;
+            }
+            if (fed == all.size()) {
+                ++g_failures;
+                printf("FAIL pipelined requests incomplete, step %zu\n", step);
+                break;
+            }
+            const size_t n = std::min(step, all.size() - fed);
+            buf.append(all.data() + fed, n);
+            fed += n;
+        }
+        CHECK(buf.readableBytes() == 0);
+    }
+}
+
+// 流式接收：请求体分段交给回调并从缓冲区中取走，最后以last = true回调一次
+void testStreaming() {
+    struct Case {
+        std::string request;
+        std::string body;
+    };
+    const Case cases[] = {
+        {"PUT /file HTTP/1.1\r\nContent-Length: 26\r\n\r\nabcdefghijklmnopqrstuvwxyz", "abcdefghijklmnopqrstuvwxyz"},
+        {"PUT /file HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3;x=y\r\nabc\r\n4\r\ndefg\r\n0\r\nT: 1\r\n\r\n",
+         "abcdefg"},
+    };
+    for (const Case& c : cases) {
+        const size_t steps[] = {c.request.size(), 1, 3};
+        for (size_t step : steps) {
+            HttpContext context;
+            Buffer buf;
+            std::string received;
+            int lastCalls = 0;
+            bool pathOk = true;
+            HttpContext::BodyCallback callback = [&](const HttpRequest& req, std::string_view data, bool last) {
+                pathOk = pathOk && req.path() == "/file" && req.method() == HttpRequest::PUT;
+                if (last) {
+                    CHECK(data.empty());
+                    ++lastCalls;
+                } else {
+                    CHECK(!data.empty());
+                    received.append(data.data(), data.size());
+                }
+            };
+            bool ok = true;
+            for (size_t fed = 0; fed < c.request.size() && ok && !context.gotAll(); fed += step) {
+                buf.append(c.request.data() + fed, std::min(step, c.request.size() - fed));
+                ok = context.parseRequest(&buf, Timestamp::now(), &callback);
+                // 首部收齐之后，缓冲区中不会堆积请求体
+                CHECK(!ok || context.gotAll() || received.empty() || buf.readableBytes() < 8);
+            }
+            CHECK(ok && context.gotAll());
+            CHECK(received == c.body);
+            CHECK(lastCalls == 1);
+            CHECK(pathOk);
+            CHECK(context.request().body().empty());
+            CHECK(context.requestBytes() == buf.readableBytes());
+        }
+    }
+
+    // 流式接收同样限制请求体的长度
+    HttpContext context(4);
+    Buffer buf;
+    HttpContext::BodyCallback callback = [](const HttpRequest&, std::string_view, bool) {};
+    buf.append(std::string("PUT / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n2\r\nde\r\n"));
+    CHECK(!context.parseRequest(&buf, Timestamp::now(), &callback));
+    CHECK(context.error() == HttpContext::kBodyTooLarge);
+}
+
+void testExpectContinue() {
+    HttpContext context;
+    Buffer buf;
+    buf.append(std::string("POST / HTTP/1.1\r\nExpect: 100-continue\r\nContent-Length: 2\r\n\r\n"));
+    CHECK(context.parseRequest(&buf, Timestamp::now()));
+    CHECK(!context.gotAll());
+    CHECK(context.takeContinueRequest());
+    CHECK(!context.takeContinueRequest());
+    buf.append(std::string("ok"));
+    CHECK(context.parseRequest(&buf, Timestamp::now()));
+    CHECK(context.gotAll() && context.request().body() == "ok");
+
+    // HTTP/1.0的客户端不等待100 Continue
+    HttpContext context10;
+    Buffer buf10;
+    buf10.append(std::string("POST / HTTP/1.0\r\nExpect: 100-continue\r\nContent-Length: 2\r\n\r\n"));
+    CHECK(context10.parseRequest(&buf10, Timestamp::now()));
+    CHECK(!context10.takeContinueRequest());
+}
+
+}  // namespace
+
+int main() {
+    testGet();
+    testBadRequestLine();
+    testContentLength();
+    testChunked();
+    testHeaderLimits();
+    testBodyLimits();
+    testPipelining();
+    testStreaming();
+    testExpectContinue();
+    printf("%s\n", g_failures == 0 ? "ok" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
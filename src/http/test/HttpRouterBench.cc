@@ -0,0 +1,132 @@
+#include "HttpRouter.h"
+#include "HttpRequest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+// 路由查找的耗时和每次查找的堆分配次数，路由数从100增加到10000
+// 路由表模仿REST API：每个资源有列表、详情(:id)、子资源(:id/xxx)和静态文件(*path)几种路由
+// 对照组是逐个比较路由的顺序匹配(相当于在回调里写if/else)，耗时随路由数线性增长
+// 用法: HttpRouterBench [lookups]
+
+static std::atomic<int64_t> g_allocs{0};
+
+void* operator new(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(n ? n : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+// 顺序匹配的对照组，一个段一个段地比较，':'开头的段匹配任意非空段，'*'开头的段匹配余下的全部
+bool linearMatch(const std::string& pattern, const std::string& path) {
+    size_t i = 0;
+    size_t j = 0;
+    while (i < pattern.size() && j < path.size()) {
+        if (pattern[i] == '*') {
+            return true;
+        }
+        if (pattern[i] == ':') {
+            while (i < pattern.size() && pattern[i] != '/') ++i;
+            size_t begin = j;
+            while (j < path.size() && path[j] != '/') ++j;
+            if (j == begin) {
+                return false;
+            }
+            continue;
+        }
+        if (pattern[i] != path[j]) {
+            return false;
+        }
+        ++i;
+        ++j;
+    }
+    return i == pattern.size() && j == path.size();
+}
+
+void bench(int resources, int lookups) {
+    HttpRouter router;
+    std::vector<std::string> patterns;
+    int hits = 0;
+    for (int i = 0; i < resources; ++i) {
+        const std::string base = "/api/v1/resource" + std::to_string(i);
+        patterns.push_back(base);
+        patterns.push_back(base + "/:id");
+        patterns.push_back(base + "/:id/history");
+        patterns.push_back("/static/" + std::to_string(i) + "/*path");
+    }
+    for (const std::string& pattern : patterns) {
+        router.get(pattern, [&hits](const HttpRequest&, HttpResponse*) { ++hits; });
+    }
+
+    // 查找的路径均匀分布在所有资源上
+    std::vector<std::string> paths;
+    for (int i = 0; i < 64; ++i) {
+        const std::string id = std::to_string(i * 7919 % resources);
+        paths.push_back("/api/v1/resource" + id + "/" + std::to_string(i * 31 + 1000));
+        paths.push_back("/api/v1/resource" + id + "/" + std::to_string(i) + "/history");
+        paths.push_back("/static/" + id + "/css/site.css");
+    }
+
+    HttpRequest req;
+    const char method[] = "GET";
+    req.setMethod(method, method + 3);
+    size_t checksum = 0;
+    // 预热，HttpRequest的params_容量分配好之后查找不再分配内存
+    for (const std::string& path : paths) {
+        req.setPath(path.data(), path.data() + path.size());
+        router.route(&req);
+    }
+    int64_t allocsBefore = g_allocs.load();
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < lookups; ++i) {
+        const std::string& path = paths[i % paths.size()];
+        req.setPath(path.data(), path.data() + path.size());
+        const HttpRouter::Handler* handler = router.route(&req);
+        if (handler == nullptr) {
+            printf("no route for %s\n", path.c_str());
+            exit(1);
+        }
+        checksum += req.params().size() + req.params()[0].value.size();
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    double radixNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / lookups;
+    double allocs = static_cast<double>(g_allocs.load() - allocsBefore) / lookups;
+
+    // 顺序匹配只跑少量次数，路由多时太慢
+    int linearLookups = std::max(1000, lookups / resources);
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < linearLookups; ++i) {
+        const std::string& path = paths[i % paths.size()];
+        for (const std::string& pattern : patterns) {
+            if (linearMatch(pattern, path)) {
+                ++checksum;
+                break;
+            }
+        }
+    }
+    t1 = std::chrono::steady_clock::now();
+    double linearNs = std::chrono::duration<double, std::nano>(t1 - t0).count() / linearLookups;
+
+    printf("%6zu routes: radix %7.1f ns/lookup, %.2f allocations per lookup; linear %10.1f ns/lookup (checksum %zu)\n",
+           router.numRoutes(), radixNs, allocs, linearNs, checksum);
+}
+
+int main(int argc, char* argv[]) {
+    int lookups = argc > 1 ? atoi(argv[1]) : 2000000;
+    const int resources[] = {25, 250, 2500};
+    for (int n : resources) {
+        bench(n, lookups);
+    }
+    return 0;
+}
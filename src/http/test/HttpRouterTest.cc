@@ -0,0 +1,163 @@
+#include "HttpRouter.h"
+#include "HttpRequest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// HttpRouter的行为测试：静态段、参数段、通配段的匹配和优先级，匹配失败后的回溯，
+// 公共前缀拆分节点，参数值，各方法分开的路由表，HEAD按GET路由处理
+// 失败时返回非0
+
+namespace {
+
+int g_failures = 0;
+
+struct Case {
+    const char* method;
+    const char* path;
+    const char* route;   // 期望匹配的路由，nullptr表示没有匹配
+    const char* params;  // 期望的参数，"name=value,name=value"
+};
+
+const Case kCases[] = {
+    {"GET", "/", "GET /", ""},
+    {"GET", "/users", "GET /users", ""},
+    // 静态段优先于参数段
+    {"GET", "/users/new", "GET /users/new", ""},
+    {"GET", "/users/42", "GET /users/:id", "id=42"},
+    {"GET", "/users/ne", "GET /users/:id", "id=ne"},
+    {"GET", "/users/newer", "GET /users/:id", "id=newer"},
+    {"GET", "/users/42/posts", "GET /users/:id/posts", "id=42"},
+    {"GET", "/users/42/posts/7", "GET /users/:id/posts/:post", "id=42,post=7"},
+    {"GET", "/users/admin/posts", "GET /users/admin/posts", ""},
+    // 静态的"admin"之后没有匹配，回溯到参数段
+    {"GET", "/users/admin", "GET /users/:id", "id=admin"},
+    {"GET", "/users/admin/posts/7", "GET /users/:id/posts/:post", "id=admin,post=7"},
+    // 参数段不能为空，也不匹配多余的'/'
+    {"GET", "/users//posts", nullptr, ""},
+    {"GET", "/users/", nullptr, ""},
+    {"GET", "/users/42/", nullptr, ""},
+    // 参数段优先于通配段，参数段之后匹配失败时回溯到通配段，去掉参数段加入的参数
+    {"GET", "/files/a.txt", "GET /files/:name", "name=a.txt"},
+    {"GET", "/files/a/b/c", "GET /files/*rest", "rest=a/b/c"},
+    {"GET", "/files/", "GET /files/*rest", "rest="},
+    {"GET", "/org/acme/repo/mymuduo", "GET /org/:org/repo/:repo", "org=acme,repo=mymuduo"},
+    {"GET", "/org/acme/repo", "GET /org/:org/*rest", "org=acme,rest=repo"},
+    {"GET", "/org/acme/repo/", "GET /org/:org/*rest", "org=acme,rest=repo/"},
+    {"GET", "/org/acme/issues/1", "GET /org/:org/*rest", "org=acme,rest=issues/1"},
+    // 通配段匹配空的剩余路径
+    {"GET", "/static/", "GET /static/*path", "path="},
+    {"GET", "/static/css/site.css", "GET /static/*path", "path=css/site.css"},
+    {"GET", "/static", nullptr, ""},
+    // 公共前缀拆分出来的节点
+    {"GET", "/a", "GET /a", ""},
+    {"GET", "/ab", "GET /ab", ""},
+    {"GET", "/abc", "GET /abc", ""},
+    {"GET", "/abd", "GET /abd", ""},
+    {"GET", "/abe", nullptr, ""},
+    {"GET", "/search", "GET /search", ""},
+    {"GET", "/search/", nullptr, ""},
+    {"GET", "/sea", nullptr, ""},
+    // 段中间的':'和'*'是普通字符
+    {"GET", "/v1:batch", "GET /v1:batch", ""},
+    {"GET", "/v1:other", nullptr, ""},
+    {"GET", "/x*y", "GET /x*y", ""},
+    // 每个方法一棵树
+    {"POST", "/users", "POST /users", ""},
+    {"POST", "/users/42", nullptr, ""},
+    {"PUT", "/users/42", "PUT /users/:uid", "uid=42"},
+    {"DELETE", "/users/42", "DELETE /users/:id", "id=42"},
+    {"DELETE", "/users", nullptr, ""},
+    // HEAD先查HEAD路由，没有匹配时按GET路由处理
+    {"HEAD", "/users", "GET /users", ""},
+    {"HEAD", "/users/42/posts/7", "GET /users/:id/posts/:post", "id=42,post=7"},
+    {"HEAD", "/health", "HEAD /health", ""},
+    {"HEAD", "/users/42/avatar", "HEAD /users/:id/avatar", "id=42"},
+    {"HEAD", "/nothing", nullptr, ""},
+};
+
+const char* const kRoutes[][2] = {
+    {"GET", "/"},
+    {"GET", "/users"},
+    {"GET", "/users/new"},
+    {"GET", "/users/:id"},
+    {"GET", "/users/:id/posts"},
+    {"GET", "/users/:id/posts/:post"},
+    {"GET", "/users/admin/posts"},
+    {"GET", "/files/:name"},
+    {"GET", "/files/*rest"},
+    {"GET", "/org/:org/repo/:repo"},
+    {"GET", "/org/:org/*rest"},
+    {"GET", "/static/*path"},
+    {"GET", "/abd"},
+    {"GET", "/abc"},
+    {"GET", "/a"},
+    {"GET", "/ab"},
+    {"GET", "/search"},
+    {"GET", "/v1:batch"},
+    {"GET", "/x*y"},
+    {"POST", "/users"},
+    {"PUT", "/users/:uid"},
+    {"DELETE", "/users/:id"},
+    {"HEAD", "/health"},
+    {"HEAD", "/users/:id/avatar"},
+};
+
+HttpRequest::Method toMethod(const char* method) {
+    HttpRequest req;
+    req.setMethod(method, method + strlen(method));
+    return req.method();
+}
+
+std::string paramsOf(const HttpRequest& req) {
+    std::string s;
+    for (const HttpRequest::Param& param : req.params()) {
+        if (!s.empty()) {
+            s += ",";
+        }
+        s += std::string(param.name) + "=" + std::string(param.value);
+    }
+    return s;
+}
+
+}  // namespace
+
+int main() {
+    HttpRouter router;
+    std::string matched;
+    for (const auto& route : kRoutes) {
+        const std::string name = std::string(route[0]) + " " + route[1];
+        router.addRoute(toMethod(route[0]), route[1],
+                        [&matched, name](const HttpRequest&, HttpResponse*) { matched = name; });
+    }
+    if (router.numRoutes() != sizeof kRoutes / sizeof kRoutes[0]) {
+        ++g_failures;
+        printf("FAIL numRoutes() %zu\n", router.numRoutes());
+    }
+
+    // 同一个HttpRequest反复使用，上一次的参数不能残留
+    HttpRequest req;
+    for (int round = 0; round < 2; ++round) {
+        for (const Case& c : kCases) {
+            req.setMethod(c.method, c.method + strlen(c.method));
+            req.setPath(c.path, c.path + strlen(c.path));
+            matched.clear();
+            const HttpRouter::Handler* handler = router.route(&req);
+            if (handler != nullptr) {
+                (*handler)(req, nullptr);
+            }
+            const std::string want = c.route != nullptr ? c.route : "";
+            const std::string params = handler != nullptr ? paramsOf(req) : "";
+            if (matched != want || params != c.params) {
+                ++g_failures;
+                printf("FAIL %s %s: matched \"%s\" params \"%s\", want \"%s\" params \"%s\"\n", c.method, c.path,
+                       matched.c_str(), params.c_str(), want.c_str(), c.params);
+            }
+        }
+    }
+
+    printf("%s\n", g_failures == 0 ? "ok" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}
@@ -117,14 +117,24 @@ const char* getErrnoMsg(int savedErrno);
 // Logger::TRACE 日志等级TRACE
 // __func__ 是一个宏, 表示当前代码所在函数名
 
+/**
+ * 编译期的最低日志等级(0 = TRACE ... 5 = FATAL)，编译时用-DMYMUDUO_MIN_LOG_LEVEL=n指定。
+ * 低于它的LOG_TRACE/LOG_DEBUG/LOG_INFO的条件是常量false，整条语句(包括参数的求值)被编译器去掉；
+ * 不低于它的语句再按运行时的logLevel()过滤。
+ * 默认去掉TRACE，网络库每轮循环、每次事件的诊断信息都用TRACE，正常构建中没有任何开销
+ */
+#ifndef MYMUDUO_MIN_LOG_LEVEL
+#define MYMUDUO_MIN_LOG_LEVEL 1
+#endif
+
 //3个可屏蔽日志
-#define LOG_TRACE if (logLevel() <= Logger::TRACE) \
+#define LOG_TRACE if (MYMUDUO_MIN_LOG_LEVEL <= 0 && logLevel() <= Logger::TRACE) \
         Logger(__FILE__, __LINE__, Logger::TRACE, __func__).stream()
 
-#define LOG_DEBUG if (logLevel() <= Logger::DEBUG) \
+#define LOG_DEBUG if (MYMUDUO_MIN_LOG_LEVEL <= 1 && logLevel() <= Logger::DEBUG) \
         Logger(__FILE__, __LINE__, Logger::DEBUG, __func__).stream()
 
-#define LOG_INFO if (logLevel() <= Logger::INFO) \
+#define LOG_INFO if (MYMUDUO_MIN_LOG_LEVEL <= 2 && logLevel() <= Logger::INFO) \
         Logger(__FILE__, __LINE__).stream()
 
 //3个不可屏蔽日志
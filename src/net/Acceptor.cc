@@ -2,15 +2,20 @@
 #include "InetAddress.h"
 #include "SocketsOps.h"
 #include "EventLoop.h"
+#include "Logging.h"
 
 #include <functional>
-#include <iostream>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+const int Acceptor::kDefaultAcceptBatch;
 
 static int createNonblocking()
 {
     int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
     if (sockfd < 0) {
-        std::cout << "listen socket create err " << errno <<std::endl;
+        LOG_ERROR << "listen socket create err " << errno;
         // LOG_FATAL("%s:%s:%d listen socket create err:%d \n", __FILE__, __FUNCTION__, __LINE__, errno);
     }
     return sockfd;
@@ -19,8 +24,9 @@ static int createNonblocking()
 Acceptor::Acceptor(EventLoop* loop,const InetAddress& listenAddr, bool reuseport)
     : loop_(loop),
       acceptSocket_(createNonblocking()),
-      acceptChannel_(loop, acceptSocket_.fd())
-      /*idleFd_(::open("/dev/null",O_RDONLY | O_CLOEXEC))*/{
+      acceptChannel_(loop, acceptSocket_.fd()),
+      acceptBatch_(kDefaultAcceptBatch),
+      idleFd_(::open("/dev/null", O_RDONLY | O_CLOEXEC)) {
     acceptSocket_.setReuseAddr(true);
     acceptSocket_.setReusePort(reuseport);
     acceptSocket_.bindAddress(listenAddr);
@@ -38,12 +44,12 @@ Acceptor::~Acceptor() {
     // 移除用于接收连接的Channel
     // 调用EventLoop->removeChannel => Poller->removeChannel 把Poller的ChannelMap对应的部分删除
     acceptChannel_.remove();
-    // ::close(idleFd_);
+    ::close(idleFd_);
 }
 
 //令用于接收连接的套接字进入监听状态，使能监听Channel读事件
 void Acceptor::listen() {
-    std::cout << "start listen" << std::endl;
+    LOG_INFO << "start listen";
     listening_ = true;
     acceptSocket_.listen();  //让用于接收连接的套接字进入监听状态
     acceptChannel_.enableReading();  //使对应Channel对象能监听读事件
@@ -57,26 +63,57 @@ void Acceptor::listen() {
  */
 
 //此函数即为当绑定了用于接收连接的套接字的Channel对象触发读事件时，应调用的回调函数
-void Acceptor::handleRead(Timestamp when) {
-    std::cout << "new Connection Establised" << when.toFormattedString() << std::endl;
-    InetAddress peerAddr;
-    // 接受新连接
-    std::cout << "new Connection estavlished in Acceptor" << std::endl;
-    int connfd = acceptSocket_.accept(&peerAddr);  //接收连接并获取对端地址信息
-    if(connfd >= 0) {
-        if(newConnectionCallback_) {
-            //如果用于创建TcpConnection的回调函数已经设置好，则调用之
-            newConnectionCallback_(connfd, peerAddr);
-        } else {
-            // LOG_DEBUG("connfd < 0 accept failed");
-            std::cout << "no newConnectionCallback() function" <<std::endl;
-            sockets::close(connfd);
+/**
+ * 一次可读事件最多accept acceptBatch_次，直到EAGAIN，然后把这一批连接一起交给上层
+ * @details fd耗尽(EMFILE/ENFILE)时listenfd一直可读，水平触发下loop会空转占满CPU：
+ * 这时关闭预留的idleFd_空出一个fd，接受连接后立即关闭，再重新占住预留fd，
+ * 让对端及时收到关闭而不是一直等在backlog中
+ */
+void Acceptor::handleRead(Timestamp) {
+    accepted_.clear();
+    for (int i = 0; i < acceptBatch_; ++i) {
+        InetAddress peerAddr;
+        int connfd = acceptSocket_.accept(&peerAddr);  //接收连接并获取对端地址信息
+        if (connfd >= 0) {
+            accepted_.push_back(AcceptedConnection{connfd, peerAddr});
+            continue;
         }
-    }else{
-        //发生错误
-        std::cout << "accept() failed" <<std::endl;
-        if(errno == EMFILE){
+        int savedErrno = errno;
+        if (savedErrno == EAGAIN) {
+            break;
+        } else if (savedErrno == EINTR || savedErrno == ECONNABORTED || savedErrno == EPROTO) {
+            // 这个连接在accept之前已经被对端放弃，继续取下一个
+            continue;
+        } else if ((savedErrno == EMFILE || savedErrno == ENFILE) && idleFd_ >= 0) {
             //文件描述符资源耗尽错误
+            LOG_ERROR << "Acceptor::handleRead - accept() failed: too many open files, rejecting a connection";
+            ::close(idleFd_);
+            idleFd_ = ::accept(acceptSocket_.fd(), nullptr, nullptr);
+            if (idleFd_ >= 0) {
+                ::close(idleFd_);
+            }
+            idleFd_ = ::open("/dev/null", O_RDONLY | O_CLOEXEC);
+            continue;
+        } else {
+            //发生错误
+            LOG_ERROR << "Acceptor::handleRead - accept() failed, errno = " << savedErrno;
+            break;
         }
     }
-}
\ No newline at end of file
+    if (accepted_.empty()) {
+        return;
+    }
+    if (newConnectionBatchCallback_) {
+        newConnectionBatchCallback_(accepted_);
+    } else if (newConnectionCallback_) {
+        //如果用于创建TcpConnection的回调函数已经设置好，则调用之
+        for (const AcceptedConnection& conn : accepted_) {
+            newConnectionCallback_(conn.sockfd, conn.peerAddr);
+        }
+    } else {
+        LOG_ERROR << "no newConnectionCallback() function";
+        for (const AcceptedConnection& conn : accepted_) {
+            sockets::close(conn.sockfd);
+        }
+    }
+}
@@ -3,11 +3,12 @@
 #include "noncopyable.h"
 #include "Socket.h"
 #include "Channel.h"
+#include "InetAddress.h"
 
 #include <functional>
+#include <vector>
 
 class EventLoop;
-class InetAddress;
 
 /** 
  * Acceptor是TcpServer的一个内部类，主要职责是用来获得新连接的fd,
@@ -16,6 +17,12 @@ class InetAddress;
 class Acceptor : public noncopyable{
 public:
     using NewConnectionCallback = std::function<void(int sockfd, const InetAddress&)>;
+    // 一次可读事件中接受的一批连接
+    struct AcceptedConnection {
+        int sockfd;
+        InetAddress peerAddr;
+    };
+    using NewConnectionBatchCallback = std::function<void(const std::vector<AcceptedConnection>&)>;
 
     Acceptor(EventLoop* loop,const InetAddress& listenAddr,bool reuseport);
     ~Acceptor();
@@ -24,10 +31,23 @@ public:
     void setNewConnectionCallback(const NewConnectionCallback& cb) {
         newConnectionCallback_ = cb;
     }
+    // 设置之后，每次可读事件接受的一批连接一起交给cb，不再逐个回调newConnectionCallback_
+    void setNewConnectionBatchCallback(const NewConnectionBatchCallback& cb) {
+        newConnectionBatchCallback_ = cb;
+    }
+    // 每次可读事件最多accept的连接数，剩下的留给下一轮poll，避免连接风暴时一直占着loop
+    void setAcceptBatch(int n) { acceptBatch_ = n > 0 ? n : 1; }
     //进入监听状态
     void listen();
     //判断是否正在监听
     bool listening() const {  return listening_; }
+    // 见Socket::attachReusePortCpuSteering()，在组内所有socket都listen()之后调用
+    bool attachReusePortCpuSteering(int groupSize, const std::vector<int>& socketCpus = std::vector<int>()) {
+        return acceptSocket_.attachReusePortCpuSteering(groupSize, socketCpus);
+    }
+
+    static const int kDefaultAcceptBatch = 64;
+
 private:
     void handleRead(Timestamp);   //调用newConnectionCallback_
     
@@ -35,6 +55,9 @@ private:
     Socket acceptSocket_;   //关联的是专门用于接收连接的套接字
     Channel acceptChannel_; //绑定上述套接字的通道，专门用于接收连接
     NewConnectionCallback newConnectionCallback_;  //建立新连接的回调，每当与一个客户端建立连接后，就调用此函数创建对应TcpConnection对象
+    NewConnectionBatchCallback newConnectionBatchCallback_;
     bool listening_ = false; //监听状态
-    // int idleFd_;  //空闲fd，fd资源不足时，可以空出来一个作为新建连接conn fd
+    int acceptBatch_;
+    int idleFd_;  //空闲fd，fd资源不足时，可以空出来一个作为新建连接conn fd
+    std::vector<AcceptedConnection> accepted_;  // 复用的批量缓冲区
 };
@@ -0,0 +1,37 @@
+#include "BlockPool.h"
+#include "CurrentThread.h"
+
+const size_t BlockPool::kBlockSize;
+const size_t BlockPool::kMaxFreeBlocks;
+
+BlockPool::BlockPool()
+    : threadId_(CurrentThread::tid()) {
+}
+
+BlockPool::~BlockPool() {
+    for (char* block : free_) {
+        delete[] block;
+    }
+}
+
+char* BlockPool::allocate() {
+    if (CurrentThread::tid() == threadId_ && !free_.empty()) {
+        char* block = free_.back();
+        free_.pop_back();
+        return block;
+    }
+    return new char[kBlockSize];
+}
+
+void BlockPool::deallocate(char* block) {
+    if (CurrentThread::tid() == threadId_ && free_.size() < kMaxFreeBlocks) {
+        free_.push_back(block);
+    } else {
+        delete[] block;
+    }
+}
+
+const std::shared_ptr<BlockPool>& BlockPool::threadLocalPool() {
+    static thread_local std::shared_ptr<BlockPool> pool(std::make_shared<BlockPool>());
+    return pool;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <memory>
+#include <vector>
+
+/**
+ * 固定大小(16KB)数据块的空闲链表，每个线程一个，EventLoop持有所在线程的池。
+ * ChainBuffer和OutputQueue的数据块都从这里取，释放的块留在链表中复用，
+ * 大块数据进出连接时不再反复malloc/free，也不会像连续缓冲区那样扩容搬移。
+ * 所有块都用同一种方式分配，可以归还给任何一个池；
+ * 只有所属线程使用空闲链表，在其他线程中分配和释放直接走new/delete，所以跨线程传递数据块是安全的。
+ */
+class BlockPool : noncopyable {
+public:
+    static const size_t kBlockSize = 16 * 1024;
+    // 空闲链表最多缓存的块数，即每个线程最多缓存4MB
+    static const size_t kMaxFreeBlocks = 256;
+
+    BlockPool();
+    ~BlockPool();
+
+    // 返回kBlockSize字节的块
+    char* allocate();
+    void deallocate(char* block);
+
+    size_t numFree() const { return free_.size(); }
+
+    // 调用线程的池，线程退出且没有缓冲区再引用它时销毁
+    static const std::shared_ptr<BlockPool>& threadLocalPool();
+
+private:
+    const pid_t threadId_;
+    std::vector<char*> free_;
+};
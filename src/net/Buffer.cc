@@ -3,13 +3,46 @@
 #include <cerrno>
 #include <sys/uio.h>
 #include <unistd.h>
+#include <memory>
 
 const char Buffer::kCRLF[] = "\r\n";
 
+const size_t Buffer::kCheapPrepend;
+const size_t Buffer::kInitialSize;
+const size_t Buffer::kSpillSize;
+const size_t Buffer::kMinReadHint;
+const size_t Buffer::kMaxReadHint;
+
+const char* Buffer::findCRLF(const char* begin, const char* end) {
+    const char* p = begin + 1;  // '\n'前面至少有一个'\r'
+    while (p < end) {
+        const char* lf = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (lf == nullptr) {
+            return nullptr;
+        }
+        if (lf[-1] == '\r') {
+            return lf - 1;
+        }
+        p = lf + 1;
+    }
+    return nullptr;
+}
+
+namespace {
+
+// readFd()的溢出区, 线程第一次读数据时分配. 同一线程中的Buffer共用, readFd()返回前数据已经拷走
+char* spillArea(){
+    static thread_local std::unique_ptr<char[]> spill(new char[Buffer::kSpillSize]);
+    return spill.get();
+}
+
+}  // namespace
+
 Buffer::Buffer(size_t initialSize)
     : buffer_(kCheapPrepend+initialSize),
       readerIndex_(kCheapPrepend),
-      writerIndex_(kCheapPrepend)
+      writerIndex_(kCheapPrepend),
+      readHint_(kMinReadHint)
 {}
 
 void Buffer::retrieve(size_t len){
@@ -48,7 +81,7 @@ int8_t Buffer::peekInt8()const{
 
 void Buffer::prepend(const void* data,size_t len){
     assert(prependableBytes()>=len);
-    auto startPos=&buffer_[readerIndex_];
+    auto startPos=begin()+readerIndex_;
     memcpy(startPos-len,data,len);
 }
 
@@ -59,6 +92,16 @@ void Buffer::shrink(size_t reserve){
     }
 }
 
+bool Buffer::shrinkIfIdle(){
+    if(readableBytes() > 0 || buffer_.capacity() <= kCheapPrepend + 2*std::max(kInitialSize, readHint_)){
+        return false;
+    }
+    std::vector<char>(kCheapPrepend).swap(buffer_);
+    readerIndex_ = kCheapPrepend;
+    writerIndex_ = kCheapPrepend;
+    return true;
+}
+
 void Buffer::makeSpace(size_t len){
     if(writeableBytes()+prependableBytes() < len+kCheapPrepend){
         // writable 空间大小 + prependable空间大小不足以存放len byte数据, resize内部缓冲区大小
@@ -67,7 +110,7 @@ void Buffer::makeSpace(size_t len){
         // writable 空间大小 + prependable空间大小 足以存放len byte数据, 移动readable空间数据, 合并多余prependable空间到writable空间
         assert(kCheapPrepend < readerIndex_);
         auto readSize=readableBytes();
-        memmove(&*buffer_.begin()+kCheapPrepend,peek(),readSize);
+        memmove(begin()+kCheapPrepend,peek(),readSize);
         readerIndex_ = kCheapPrepend;
         writerIndex_ = readerIndex_ + readSize;
         assert(readSize == readableBytes());
@@ -75,26 +118,37 @@ void Buffer::makeSpace(size_t len){
 }
 
 ssize_t Buffer::readFd(int fd, int& savedErrno){
-    char extrabuf[65536]; //65536 = 64k bytes
+    if(readHint_ > kSpillSize){
+        // 预计这次会读到大量数据, 先扩容让数据直接读进buffer_, 省掉从溢出区的拷贝
+        ensureWritableBytes(readHint_);
+    }
+    char* spill = spillArea();
     struct iovec vec[2];
     const size_t writable = writeableBytes();
     vec[0].iov_base = beginWrite();
     vec[0].iov_len = writable;
-    vec[1].iov_base = extrabuf;
-    vec[1].iov_len = sizeof extrabuf;
+    vec[1].iov_base = spill;
+    vec[1].iov_len = kSpillSize;
 
-    const int iovcnt = (writable < sizeof extrabuf) ? 2 : 1;
-    const size_t n=sockets::readv(fd,vec,iovcnt);
+    const int iovcnt = (writable < kSpillSize) ? 2 : 1;
+    const ssize_t n=sockets::readv(fd,vec,iovcnt);
     if(n < 0){
-        // ::readv系统调用错误
+        // ::readv系统调用错误，包括非阻塞socket上没有数据可读时的EAGAIN
         savedErrno=errno;
-    }else if(n <= writable) {
+        return n;
+    }
+    if(static_cast<size_t>(n) <= writable) {
         writerIndex_ += n;
     }else {
-        // 读取的数据超过现有内部buffer_的writable空间大小时, 启用备用的extrabuf 64KB空间, 并将这些数据添加到内部buffer_的末尾
+        // 读取的数据超过现有内部buffer_的writable空间大小时, 超出部分在溢出区中, 将这些数据添加到内部buffer_的末尾
         // 过程可能会合并多余prependable空间或resize buffer_大小, 以腾出足够writable空间存放数据
         writerIndex_ = buffer_.size();
-        append(extrabuf, n-writable);
+        append(spill, n-writable);
+    }
+    if(static_cast<size_t>(n) >= readHint_){
+        readHint_ = std::min(readHint_*2, kMaxReadHint);
+    }else if(static_cast<size_t>(n) < readHint_/4){
+        readHint_ = std::max(readHint_/2, kMinReadHint);
     }
     return n;
-}
\ No newline at end of file
+}
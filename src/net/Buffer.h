@@ -21,8 +21,25 @@ class Buffer: public copyable{
 public:
     static const size_t kCheapPrepend=8;   //初始预留的prependable空间大小
     static const size_t kInitialSize=1024; // Buffer初始大小
+    static const size_t kSpillSize=65536;  // readFd()溢出区大小，每个线程一块
+    static const size_t kMinReadHint=1024;       // readFd()估计的读取量下限
+    static const size_t kMaxReadHint=1024*1024;  // readFd()估计的读取量上限
 
     explicit Buffer(size_t initialSize = kInitialSize);
+    Buffer(const Buffer&) = default;
+    Buffer& operator=(const Buffer&) = default;
+    // 移动之后other变为只有prependable空间的空缓冲区，与Buffer(0)相同，可以继续使用
+    Buffer(Buffer&& other)
+        : Buffer(0) {
+        swap(other);
+    }
+    Buffer& operator=(Buffer&& other) {
+        if (this != &other) {
+            Buffer tmp(std::move(other));
+            swap(tmp);
+        }
+        return *this;
+    }
 
     // 返回 readable 空间大小
     size_t readableBytes()const{ return writerIndex_ - readerIndex_; }
@@ -30,20 +47,25 @@ public:
     size_t writeableBytes()const{ return buffer_.size() - writerIndex_; }
     size_t prependableBytes()const{return readerIndex_; }
     // readIndex 对应元素地址，即待读数据的首地址
-    const char* peek()const{ return &buffer_[readerIndex_]; }
+    // 用data() + 下标而不是&buffer_[下标]：空闲时buffer_只有prependable空间，下标等于size()
+    const char* peek()const{ return buffer_.data() + readerIndex_; }
     // 返回待写入数据的首地址, 即writable空间首地址
-    char* beginWrite(){ return &buffer_[writerIndex_]; }
-    const char* beginWrite()const{ return &buffer_[writerIndex_]; }
+    char* beginWrite(){ return buffer_.data() + writerIndex_; }
+    const char* beginWrite()const{ return buffer_.data() + writerIndex_; }
     // 返回缓冲区的起始位置, 也是prependable空间起始位置
-    char* begin(){ return &*buffer_.begin(); }
-    const char* begin()const{ return &*buffer_.cbegin(); }
+    char* begin(){ return buffer_.data(); }
+    const char* begin()const{ return buffer_.data(); }
     // 返回buffer_的容量capacity()
     size_t internalCapacity() const{ return buffer_.capacity(); }
 
+    // readFd()根据最近几次的读取量估计的下一次读取量
+    size_t readHint()const{ return readHint_; }
+
     void swap(Buffer& other){
         buffer_.swap(other.buffer_);
         std::swap(other.writerIndex_,writerIndex_);
         std::swap(other.readerIndex_,readerIndex_);
+        std::swap(other.readHint_,readHint_);
     }
 
     // 将writerIndex_往后移动len byte, 需要确保writable空间足够大
@@ -148,6 +170,12 @@ public:
 
     // 收缩缓冲区空间, 将缓冲区中数据拷贝到新缓冲区, 确保writable空间最终大小为reserve
     void shrink(size_t reserve);
+    /**
+     * 没有可读数据, 且内部缓冲区远大于最近的读取量(一次突发的大数据已经处理完)时, 释放内部缓冲区,
+     * 只保留prependable空间, 下次读到数据时再按需分配
+     * @return 是否释放了内部缓冲区
+     */
+    bool shrinkIfIdle();
     /**
      * writable空间不足以写入len byte数据时,
      * 1)如果writable空间 + prependable空间不足以存放数据, 就resize 申请新的更大的内部缓冲区buffer_
@@ -195,6 +223,9 @@ public:
 
     /**
     * 从fd读取数据到内部缓冲区, 将系统调用错误保存至savedErrno
+    * @details 类似TCP接收窗口的自动调整: 一次读满估计量readHint()就加倍, 远小于估计量就减半.
+    * 估计量超过溢出区大小时(批量传输)先扩容, 数据直接读进内部缓冲区;
+    * 否则writable空间不够的部分先读进线程共享的溢出区, 再按实际读到的大小append, 空闲连接不会预先占用内存
     * @param 要读取的fd, 通常是代表连接的conn fd
     * @param savedErrno[out] 保存的错误号
     * @return 读取数据结果. < 0, 发生错误; >= 成功, 读取到的字节数
@@ -204,15 +235,13 @@ public:
     // 在readable空间找CRLF位置, 返回第一个出现CRLF的位置
     // CR = '\r', LF = '\n'
     const char* findCRLF() const{
-        const char* crlf = std::search(peek(),beginWrite(),kCRLF,kCRLF+2);
-        return crlf == beginWrite() ? nullptr : crlf;
+        return findCRLF(peek(), beginWrite());
     }
     // 在start~writable首地址 之间找CRLF, 要求start在readable地址空间中
     const char* findCRLF(const char* start) const{
         assert(peek() <= start);
         assert(beginWrite() > start);
-        const char* crlf=std::search(start,beginWrite(),kCRLF,kCRLF+2);
-        return crlf == beginWrite() ? nullptr : crlf;
+        return findCRLF(start, beginWrite());
     }
 
     // 在readable空间中找EOL, 即LF('\n')
@@ -226,14 +255,22 @@ public:
     const char* findEOL(const char* start) const{
         assert(peek() <= start);
         assert(beginWrite() > start);
-        const void* eol=memchr(start, '\n', readableBytes());
+        const void* eol=memchr(start, '\n', beginWrite() - start);
         return static_cast<const char*>(eol);
     }
 
 private:
+    /**
+     * 在[begin, end)中找CRLF，没有时返回nullptr
+     * @details 用memchr找'\n'再检查前一个字节，memchr由glibc按CPU选择SIMD实现，
+     * 比std::search逐字节比较两个字符快得多
+     */
+    static const char* findCRLF(const char* begin, const char* end);
+
     std::vector<char> buffer_; //存储数据的线性缓冲区，大小可变
     size_t readerIndex_;       //可读数据首地址
     size_t writerIndex_;       //可写数据首地址
+    size_t readHint_;          //readFd()估计的下一次读取量
 
     static const char kCRLF[];
 };
\ No newline at end of file
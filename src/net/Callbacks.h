@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include "InplaceFunction.h"
+
 #include <functional>
 #include <memory>
 
@@ -37,7 +39,7 @@ class Timestamp;
 
 using TcpConnectionPtr = std::shared_ptr<TcpConnection>;
 
-using TimerCallback = std::function<void ()>;
+using TimerCallback = InplaceFunction<void ()>;
 using ConnectionCallback = std::function<void (const TcpConnectionPtr&)>;
 using CloseCallback = std::function<void (const TcpConnectionPtr&)>;
 using WriteCompleteCallback = std::function<void (const TcpConnectionPtr&)>;
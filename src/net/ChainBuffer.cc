@@ -0,0 +1,243 @@
+#include "ChainBuffer.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+
+const size_t ChainBuffer::kBlockSize;
+const int ChainBuffer::kReadBlocks;
+
+ChainBuffer::ChainBuffer(std::shared_ptr<BlockPool> pool)
+    : bytes_(0),
+      pool_(std::move(pool)) {
+}
+
+ChainBuffer::~ChainBuffer() {
+    retrieveAll();
+}
+
+ChainBuffer::ChainBuffer(ChainBuffer&& other) noexcept
+    : blocks_(std::move(other.blocks_)),
+      bytes_(other.bytes_),
+      pool_(other.pool_) {
+    other.blocks_.clear();
+    other.bytes_ = 0;
+}
+
+ChainBuffer& ChainBuffer::operator=(ChainBuffer&& other) noexcept {
+    if (this != &other) {
+        retrieveAll();
+        blocks_.swap(other.blocks_);
+        std::swap(bytes_, other.bytes_);
+    }
+    return *this;
+}
+
+void ChainBuffer::swap(ChainBuffer& other) {
+    blocks_.swap(other.blocks_);
+    std::swap(bytes_, other.bytes_);
+    pool_.swap(other.pool_);
+}
+
+const char* ChainBuffer::peek() const {
+    return blocks_.empty() ? nullptr : blocks_.front().data + blocks_.front().readIndex;
+}
+
+size_t ChainBuffer::contiguousBytes() const {
+    return blocks_.empty() ? 0 : blocks_.front().writeIndex - blocks_.front().readIndex;
+}
+
+/**
+ * 把跨块的前n字节拷贝到一个新块中，放在队头
+ * @details n不超过kBlockSize时新块来自pool_，否则单独分配一个n字节的块
+ */
+const char* ChainBuffer::pullup(size_t n) {
+    assert(n <= bytes_);
+    if (n == 0 || contiguousBytes() >= n) {
+        return peek();
+    }
+    Block block = newBlock(std::max(n, kBlockSize));
+    size_t copied = 0;
+    while (copied < n) {
+        Block& front = blocks_.front();
+        size_t len = std::min(n - copied, front.writeIndex - front.readIndex);
+        memcpy(block.data + copied, front.data + front.readIndex, len);
+        copied += len;
+        front.readIndex += len;
+        if (front.readIndex == front.writeIndex) {
+            releaseBlock(front);
+            blocks_.pop_front();
+        }
+    }
+    block.writeIndex = n;
+    blocks_.push_front(block);
+    return peek();
+}
+
+void ChainBuffer::retrieve(size_t len) {
+    assert(len <= bytes_);
+    bytes_ -= len;
+    while (len > 0) {
+        Block& front = blocks_.front();
+        size_t readable = front.writeIndex - front.readIndex;
+        if (len < readable) {
+            front.readIndex += len;
+            return;
+        }
+        // 读完的块立即归还，包括队尾块
+        len -= readable;
+        releaseBlock(front);
+        blocks_.pop_front();
+    }
+}
+
+void ChainBuffer::retrieveAll() {
+    for (const Block& block : blocks_) {
+        releaseBlock(block);
+    }
+    blocks_.clear();
+    bytes_ = 0;
+}
+
+std::string ChainBuffer::retrieveAsString(size_t len) {
+    assert(len <= bytes_);
+    std::string result;
+    result.reserve(len);
+    size_t left = len;
+    for (const Block& block : blocks_) {
+        if (left == 0) {
+            break;
+        }
+        size_t n = std::min(left, block.writeIndex - block.readIndex);
+        result.append(block.data + block.readIndex, n);
+        left -= n;
+    }
+    retrieve(len);
+    return result;
+}
+
+std::string ChainBuffer::toString() const {
+    std::string result;
+    result.reserve(bytes_);
+    for (const Block& block : blocks_) {
+        result.append(block.data + block.readIndex, block.writeIndex - block.readIndex);
+    }
+    return result;
+}
+
+void ChainBuffer::append(const char* data, size_t len) {
+    bytes_ += len;
+    if (!blocks_.empty()) {
+        Block& tail = blocks_.back();
+        size_t n = std::min(len, tail.capacity - tail.writeIndex);
+        memcpy(tail.data + tail.writeIndex, data, n);
+        tail.writeIndex += n;
+        data += n;
+        len -= n;
+    }
+    while (len > 0) {
+        Block block = newBlock();
+        size_t n = std::min(len, block.capacity);
+        memcpy(block.data, data, n);
+        block.writeIndex = n;
+        blocks_.push_back(block);
+        data += n;
+        len -= n;
+    }
+}
+
+int ChainBuffer::readableIovec(struct iovec* vec, int maxIov) const {
+    int iovcnt = 0;
+    for (const Block& block : blocks_) {
+        if (iovcnt == maxIov) {
+            break;
+        }
+        if (block.writeIndex > block.readIndex) {
+            vec[iovcnt].iov_base = block.data + block.readIndex;
+            vec[iovcnt].iov_len = block.writeIndex - block.readIndex;
+            ++iovcnt;
+        }
+    }
+    return iovcnt;
+}
+
+ssize_t ChainBuffer::readFd(int fd, int& savedErrno) {
+    struct iovec vec[kReadBlocks + 1];
+    Block fresh[kReadBlocks];
+    int iovcnt = 0;
+    size_t tailSpare = 0;
+    if (!blocks_.empty()) {
+        Block& tail = blocks_.back();
+        tailSpare = tail.capacity - tail.writeIndex;
+        if (tailSpare > 0) {
+            vec[iovcnt].iov_base = tail.data + tail.writeIndex;
+            vec[iovcnt].iov_len = tailSpare;
+            ++iovcnt;
+        }
+    }
+    for (int i = 0; i < kReadBlocks; ++i) {
+        fresh[i] = newBlock();
+        vec[iovcnt].iov_base = fresh[i].data;
+        vec[iovcnt].iov_len = fresh[i].capacity;
+        ++iovcnt;
+    }
+
+    const ssize_t n = ::readv(fd, vec, iovcnt);
+    if (n < 0) {
+        savedErrno = errno;
+    }
+    size_t left = n > 0 ? static_cast<size_t>(n) : 0;
+    bytes_ += left;
+    if (tailSpare > 0) {
+        size_t used = std::min(left, tailSpare);
+        blocks_.back().writeIndex += used;
+        left -= used;
+    }
+    for (int i = 0; i < kReadBlocks; ++i) {
+        if (left > 0) {
+            size_t used = std::min(left, fresh[i].capacity);
+            fresh[i].writeIndex = used;
+            blocks_.push_back(fresh[i]);
+            left -= used;
+        } else {
+            releaseBlock(fresh[i]);
+        }
+    }
+    return n;
+}
+
+ssize_t ChainBuffer::writeFd(int fd, int& savedErrno) {
+    struct iovec vec[IOV_MAX];
+    int iovcnt = readableIovec(vec, IOV_MAX);
+    if (iovcnt == 0) {
+        return 0;
+    }
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0) {
+        savedErrno = errno;
+    } else {
+        retrieve(n);
+    }
+    return n;
+}
+
+ChainBuffer::Block ChainBuffer::newBlock(size_t capacity) {
+    Block block;
+    block.data = (capacity == kBlockSize) ? pool_->allocate() : new char[capacity];
+    block.capacity = capacity;
+    block.readIndex = 0;
+    block.writeIndex = 0;
+    return block;
+}
+
+void ChainBuffer::releaseBlock(const Block& block) {
+    if (block.capacity == kBlockSize) {
+        pool_->deallocate(block.data);
+    } else {
+        delete[] block.data;
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "BlockPool.h"
+
+#include <sys/types.h>
+#include <deque>
+#include <memory>
+#include <string>
+
+struct iovec;
+class OutputQueue;
+
+/**
+ * 由固定大小数据块串成的缓冲区，块来自BlockPool。
+ * 与连续的Buffer相比，追加数据只会在队尾新开块，已有数据从不搬移或扩容，适合几十MB的大块数据；
+ * readFd()/writeFd()直接用readv/writev跨块读写，不需要先拼成连续内存。
+ * 接口与Buffer保持一致：数据在一个块内时peek()就是全部可读数据；
+ * 解析跨块的数据时，先用pullup(n)把前n字节整理到连续内存中。
+ * 同一时刻只能在一个线程中使用。
+ *
+ * +---------------------+     +---------------------+     +---------------------+
+ * | retrieved | readable | --> |      readable       | --> | readable | writable |
+ * +---------------------+     +---------------------+     +---------------------+
+ */
+class ChainBuffer : noncopyable {
+public:
+    static const size_t kBlockSize = BlockPool::kBlockSize;
+    // readFd()一次最多读入的新块数，与Buffer::readFd()的64KB栈上缓冲区相当
+    static const int kReadBlocks = 4;
+
+    explicit ChainBuffer(std::shared_ptr<BlockPool> pool = BlockPool::threadLocalPool());
+    ~ChainBuffer();
+    ChainBuffer(ChainBuffer&& other) noexcept;
+    ChainBuffer& operator=(ChainBuffer&& other) noexcept;
+
+    void swap(ChainBuffer& other);
+
+    size_t readableBytes() const { return bytes_; }
+    // 第一个块中的可读数据，数据跨块时只是一部分，长度见contiguousBytes()
+    const char* peek() const;
+    size_t contiguousBytes() const;
+    // 保证前n字节(n <= readableBytes())在连续内存中，返回其首地址
+    const char* pullup(size_t n);
+    size_t numBlocks() const { return blocks_.size(); }
+
+    void retrieve(size_t len);
+    void retrieveAll();
+    std::string retrieveAsString(size_t len);
+    std::string retrieveAllAsString() { return retrieveAsString(readableBytes()); }
+    std::string toString() const;
+
+    void append(const char* data, size_t len);
+    void append(const void* data, size_t len) { append(static_cast<const char*>(data), len); }
+    void append(const std::string& str) { append(str.data(), str.size()); }
+
+    // 把可读数据依次填入vec，最多maxIov段，返回填入的段数
+    int readableIovec(struct iovec* vec, int maxIov) const;
+
+    /**
+     * 从fd读取数据：用readv一次读进队尾块的剩余空间和最多kReadBlocks个新块，没用到的新块立即归还
+     * @param savedErrno[out] 保存的错误号
+     * @return < 0, 发生错误; >= 0, 读取到的字节数
+     */
+    ssize_t readFd(int fd, int& savedErrno);
+    // 用writev把可读数据写入fd(最多IOV_MAX块)，并取走写出的部分
+    ssize_t writeFd(int fd, int& savedErrno);
+
+private:
+    friend class OutputQueue;
+
+    struct Block {
+        char* data;
+        size_t capacity;     // kBlockSize的块归还给pool_，pullup()分配的大块直接delete[]
+        size_t readIndex;
+        size_t writeIndex;
+    };
+
+    Block newBlock(size_t capacity = kBlockSize);
+    void releaseBlock(const Block& block);
+
+    std::deque<Block> blocks_;
+    size_t bytes_;
+    std::shared_ptr<BlockPool> pool_;
+};
@@ -1,7 +1,7 @@
 #include "Channel.h"
 #include "EventLoop.h"
 #include "Timestamp.h"
-#include <iostream>
+#include "Logging.h"
 
 #include <sstream>
 #include <sys/epoll.h>
@@ -15,6 +15,8 @@ Channel::Channel(EventLoop* loop, int fd)
 	  fd_(fd),
 	  events_(POLLIN),
 	  revents_(0),
+	  edgeTriggered_(false),
+	  lastUpdatedEvents_(-1),
 	  index_(-1), //初始化时，状态为kNew，表示还没被添加到Poller的map中
 	  tied_(false){}
 
@@ -33,7 +35,7 @@ void Channel::tie(const std::shared_ptr<void>& obj) {
 * @param recevieTime Poller中调用epoll_wait/poll返回后的时间. 用户可能需要该参数.
 */
 void Channel::handleEvent(Timestamp receiveTime) {
-    std::cout << "new Event" << std::endl;
+    LOG_TRACE << "new Event";
     /**
      * 调用了Channel::tie会设置tid_=true
      * 而TcpConnection::connectEstablished会调用channel_->tie(shared_from_this());
@@ -69,22 +71,35 @@ void Channel::handleEventWithGuard(Timestamp receiveTime) {
     //     }
     //     std::cout<< "Connection has been closed" << std::endl;
     // }
+    // 只有POLLHUP而没有POLLIN，说明连接已经断开且没有数据可读了
+    if ((revents_ & POLLHUP) && !(revents_ & POLLIN)) {
+        if (closeCallback_) {
+            closeCallback_();
+        }
+        return;
+    }
     if (revents_ & POLLNVAL) {
         //无效请求，fd没开
         //log
-        printf("Channel::handle_event() POLLNVAL");
-    } else if (revents_ & POLLERR) {
+        LOG_WARN << "Channel::handle_event() POLLNVAL fd = " << fd_;
+        return;
+    }
+    if (revents_ & POLLERR) {
         // 错误条件, 或 无效请求, fd没打开
         if (errorCallback_) {
             errorCallback_();
         }
-    } else if (revents_ & (POLLIN | POLLPRI)) {
+    }
+    // 读写事件分别处理：边缘触发时可读和可写会在同一次通知中到达，漏掉任何一个都不会再被通知
+    // 边缘触发模式下注册了全部事件，所以要按当前关注的事件过滤
+    if ((revents_ & (POLLIN | POLLPRI)) && (events_ & kReadEvent)) {
         // 读事件
         // 有待读数据, 或 紧急数据(e.g. TCP带外数据)或 对方断开了连接（发送一个EOF）
         if (readCallback_) {
             readCallback_(receiveTime);
         }
-    } else if (revents_ & POLLOUT) {
+    }
+    if ((revents_ & POLLOUT) && (events_ & kWriteEvent)) {
         // 可写事件
         if (writeCallback_) {
             writeCallback_();
@@ -92,12 +107,22 @@ void Channel::handleEventWithGuard(Timestamp receiveTime) {
     }
 }
 
+int Channel::registeredEvents() const {
+    return events_ == kNoneEvent ? kNoneEvent : (kReadEvent | kWriteEvent | EPOLLET);
+}
+
 void Channel::update() {
+    // 边缘触发模式下，注册的事件没有变化时不必再通知poller，省掉一次epoll_ctl
+    if (edgeTriggered_ && index_ != -1 && events() == lastUpdatedEvents_) {
+        return;
+    }
+    lastUpdatedEvents_ = events();
     // 通过该channel所属的EventLoop，调用poller对应的方法，注册fd的events事件
     loop_->updateChannel(this);
 }
 
 void Channel::remove(){
+    lastUpdatedEvents_ = -1;
     // 在channel所属的EventLoop中，把当前的channel删除掉
   	loop_->removeChannel(this);
 }
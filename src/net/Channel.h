@@ -1,8 +1,8 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "InplaceFunction.h"
 
-#include <functional>
 #include <poll.h>
 #include <memory>
 
@@ -18,8 +18,9 @@ class Timestamp;
 // 这些需要监听指定文件描述符上事件的类，将fd通过构造函数传递给Channel。
 class Channel : noncopyable {
 public:
-    using EventCallback = std::function<void()>;
-    using ReadEventCallback = std::function<void(Timestamp)>;
+    // 事件回调存放在Channel内部的固定缓冲区中，不会在堆上分配内存
+    using EventCallback = InplaceFunction<void()>;
+    using ReadEventCallback = InplaceFunction<void(Timestamp)>;
 
     Channel(EventLoop* loop, int fd);
     ~Channel();
@@ -28,25 +29,36 @@ public:
     void handleEvent(Timestamp receiveTime);
     
     //设置事件回调，由Channel对象持有者即TcpConnection处理Channel事件时回调
-    void setReadCallback(const ReadEventCallback& cb) { readCallback_ = cb; }
-    void setWriteCallback(const EventCallback& cb) { writeCallback_ = cb; }
-    void setErrorCallback(const EventCallback& cb) { errorCallback_ = cb; }
-    void setCloseCallback(const EventCallback& cb) { closeCallback_ = cb; }
+    void setReadCallback(ReadEventCallback cb) { readCallback_ = std::move(cb); }
+    void setWriteCallback(EventCallback cb) { writeCallback_ = std::move(cb); }
+    void setErrorCallback(EventCallback cb) { errorCallback_ = std::move(cb); }
+    void setCloseCallback(EventCallback cb) { closeCallback_ = std::move(cb); }
 
     // Tie this channel to the owner object managed by shared_ptr,
     // prevent the owner object being destroyed in handleEvent.
     void tie(const std::shared_ptr<void>&);
 
     int fd() const { return fd_; }
-    int events() const { return events_; }
+    // 交给poller注册的事件，边缘触发模式下与enableWriting()等设置的关注事件不同，见registeredEvents()
+    int events() const { return edgeTriggered_ ? registeredEvents() : events_; }
     //user by poller
     void set_revents(int revt) { revents_ = revt; }
+    int revents() const { return revents_; }
 
     //for poller
     int index() { return index_; }
     //for poller
     void set_index(int idx) { index_ = idx; }
 
+    /**
+     * 边缘触发(EPOLLET)模式，必须在第一次注册之前设置，IoUringPoller中对应multishot poll。
+     * 此模式下只要关注了任何事件，就一次性向epoll注册可读、可写和EPOLLET，
+     * enableWriting()/disableWriting()只修改关注的事件，不再产生EPOLL_CTL_MOD系统调用，
+     * 分发事件时再按关注的事件过滤。使用者需要在每次事件中一直读写到EAGAIN
+     */
+    void setEdgeTriggered(bool on) { edgeTriggered_ = on; }
+    bool edgeTriggered() const { return edgeTriggered_; }
+
     void enableReading() {
         events_ |= kReadEvent;
         update();
@@ -86,6 +98,8 @@ private:
     void update();
     // 根据不同的事件源激活不同的回调函数，来处理事件
     void handleEventWithGuard(Timestamp receiveTime);
+    // 边缘触发模式下实际注册到epoll的事件
+    int registeredEvents() const;
     
     static const int kNoneEvent;
     static const int kReadEvent;
@@ -95,6 +109,8 @@ private:
     const int fd_;
     int events_;       //poll关心的事件
     int revents_;      //实际发生的事件，Poller类设置
+    bool edgeTriggered_;
+    int lastUpdatedEvents_;  // 上一次交给poller的events()，用于跳过不改变注册事件的update()
     
     //used by Poller,
     //在PollPoller中，记录Channel所管理的文件描述符在pollfds_数组中的下标
@@ -0,0 +1,114 @@
+#include "ConnectionReaper.h"
+#include "EventLoop.h"
+#include "TcpConnection.h"
+
+#include <stdint.h>
+#include <algorithm>
+
+namespace {
+
+int64_t toMicroSeconds(double seconds) {
+    return seconds > 0 ? static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond) : 0;
+}
+
+} // namespace
+
+ConnectionReaper::ConnectionReaper(EventLoop* loop, double readIdleSeconds, double writeIdleSeconds)
+    : loop_(loop),
+      readIdleUs_(toMicroSeconds(readIdleSeconds)),
+      writeIdleUs_(toMicroSeconds(writeIdleSeconds)),
+      maxIdleUs_(std::max(readIdleUs_, writeIdleUs_)),
+      readIdleReaped_(0),
+      writeIdleReaped_(0) {
+    // 桶的时长取较小超时的1/8，限制在[10ms, 1s]之间：连接最多在超时之后一个tick内被关闭
+    int64_t minIdleUs = readIdleUs_ > 0 && writeIdleUs_ > 0 ? std::min(readIdleUs_, writeIdleUs_) : maxIdleUs_;
+    const int64_t kMaxTickUs = Timestamp::kMicroSecondsPerSecond;
+    tickUs_ = std::min(std::max<int64_t>(minIdleUs / 8, 10 * 1000), kMaxTickUs);
+    lastTick_ = Timestamp::now().microSecondsSinceEpoch() / tickUs_;
+    // 截止时刻最晚在maxIdleUs_之后，多留两个桶，保证放入的桶不会与当前的桶重合
+    buckets_.resize(static_cast<size_t>(maxIdleUs_ / tickUs_ + 2));
+}
+
+ConnectionReaper::~ConnectionReaper() {
+    // 在所属loop线程中，取消立即生效，之后定时器不会再回调
+    loop_->cancel(timerId_);
+    // 还没有connectDestroyed()的连接可能比回收器活得久，不能再指向它
+    for (std::vector<TcpConnection*>& bucket : buckets_) {
+        for (TcpConnection* conn : bucket) {
+            conn->reaper_ = nullptr;
+            conn->reaperBucket_ = -1;
+        }
+    }
+}
+
+void ConnectionReaper::start() {
+    // 回收器在所属loop线程中先取消定时器再析构，定时器回调中可以直接使用this
+    timerId_ = loop_->runEvery(static_cast<double>(tickUs_) / Timestamp::kMicroSecondsPerSecond,
+                               [this]() { onTick(); });
+}
+
+void ConnectionReaper::add(TcpConnection* conn) {
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    place(conn, now + (readIdleUs_ > 0 ? readIdleUs_ : maxIdleUs_));
+}
+
+void ConnectionReaper::remove(TcpConnection* conn) {
+    int index = conn->reaperBucket_;
+    if (index < 0) {
+        return;
+    }
+    // 与桶中最后一个连接交换后删除，O(1)
+    std::vector<TcpConnection*>& bucket = buckets_[index];
+    TcpConnection* last = bucket.back();
+    bucket[conn->reaperIndex_] = last;
+    last->reaperIndex_ = conn->reaperIndex_;
+    bucket.pop_back();
+    conn->reaperBucket_ = -1;
+}
+
+void ConnectionReaper::place(TcpConnection* conn, int64_t deadline) {
+    int64_t tick = (deadline + tickUs_ - 1) / tickUs_;
+    int index = static_cast<int>(tick % static_cast<int64_t>(buckets_.size()));
+    std::vector<TcpConnection*>& bucket = buckets_[index];
+    conn->reaperBucket_ = index;
+    conn->reaperIndex_ = bucket.size();
+    bucket.push_back(conn);
+}
+
+void ConnectionReaper::onTick() {
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    int64_t tick = now / tickUs_;
+    // 定时器可能被推迟，补上中间错过的tick，最多一圈
+    int64_t first = std::max(lastTick_ + 1, tick - static_cast<int64_t>(buckets_.size()) + 1);
+    lastTick_ = tick;
+
+    std::vector<TcpConnection*> due;
+    for (int64_t t = first; t <= tick; ++t) {
+        due.swap(buckets_[t % static_cast<int64_t>(buckets_.size())]);
+        // 先全部标记为不在桶中，关闭连接时的回调即使触发了其他连接的remove()，也不会改动due
+        for (TcpConnection* conn : due) {
+            conn->reaperBucket_ = -1;
+        }
+        for (TcpConnection* conn : due) {
+            if (conn->disconnected()) {
+                continue;
+            }
+            // 有待发送数据时按写空闲计算，否则按读空闲计算
+            bool writing = !conn->outputQueue_.empty();
+            int64_t idleUs = writing ? writeIdleUs_ : readIdleUs_;
+            int64_t last = (writing ? conn->lastWriteTime_ : conn->lastReadTime_).microSecondsSinceEpoch();
+            if (idleUs > 0 && last + idleUs <= now) {
+                if (writing) {
+                    writeIdleReaped_.fetch_add(1, std::memory_order_relaxed);
+                } else {
+                    readIdleReaped_.fetch_add(1, std::memory_order_relaxed);
+                }
+                conn->forceClose();
+            } else {
+                // 期间有过读写，或者这一项不检查：按新的截止时刻重新放入
+                place(conn, idleUs > 0 ? last + idleUs : now + maxIdleUs_);
+            }
+        }
+        due.clear();
+    }
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "TimerId.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+class EventLoop;
+class TcpConnection;
+
+/**
+ * 一个IO loop上的空闲连接回收器，强制关闭读空闲或写空闲超时的连接。
+ * 1) 读空闲：没有待发送数据，并且超过readIdle秒没有收到任何字节(包括只发送请求头的一部分就停住的慢速连接)；
+ * 2) 写空闲：有待发送的数据，但超过writeIdle秒没有写出任何字节(对端不再读取)。
+ * 连接按截止时刻放入环形的时间桶中，每个tick检查一个桶。
+ * TcpConnection在handleRead/handleWrite中只更新自己的时间戳，不移动桶；
+ * 桶到期时才重新计算截止时刻，还没有超时的连接再放入新的桶(惰性重排)，
+ * 所以活跃连接每个超时周期最多被检查一次，不需要为每个连接创建定时器。
+ * 由TcpServer持有，连接只保存不拥有的指针。
+ * 除构造、start()和计数之外，只能在所属loop线程中使用，也必须在所属loop线程中析构。
+ */
+class ConnectionReaper : noncopyable {
+public:
+    // 超时时间单位为秒，<= 0表示不检查这一项
+    ConnectionReaper(EventLoop* loop, double readIdleSeconds, double writeIdleSeconds);
+    // 取消定时器，并清除仍在桶中的连接指向自己的指针
+    ~ConnectionReaper();
+
+    // 开始周期检查，可以在其他线程调用
+    void start();
+
+    // 连接建立/销毁时调用
+    void add(TcpConnection* conn);
+    void remove(TcpConnection* conn);
+
+    // 因读空闲/写空闲被关闭的连接数，可以在其他线程调用
+    int64_t numReadIdleReaped() const { return readIdleReaped_.load(std::memory_order_relaxed); }
+    int64_t numWriteIdleReaped() const { return writeIdleReaped_.load(std::memory_order_relaxed); }
+
+private:
+    void onTick();
+    // 把连接放入截止时刻deadline(us)所在的桶
+    void place(TcpConnection* conn, int64_t deadline);
+
+    EventLoop* loop_;
+    const int64_t readIdleUs_;
+    const int64_t writeIdleUs_;
+    // 两项超时中较大的一个，连接的截止时刻最晚是现在加上它
+    const int64_t maxIdleUs_;
+    // 每个桶的时长，也是检查的周期
+    int64_t tickUs_;
+    // 已经检查过的最后一个tick
+    int64_t lastTick_;
+    std::vector<std::vector<TcpConnection*>> buckets_;
+    TimerId timerId_;
+
+    std::atomic<int64_t> readIdleReaped_;
+    std::atomic<int64_t> writeIdleReaped_;
+};
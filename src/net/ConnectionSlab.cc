@@ -0,0 +1,77 @@
+#include "ConnectionSlab.h"
+#include "CurrentThread.h"
+
+#include <assert.h>
+#include <new>
+
+const size_t ConnectionSlab::kSlotsPerChunk;
+
+namespace {
+
+// 槽位按operator new的默认对齐取整，保证放得下任何普通对象
+size_t roundUp(size_t size) {
+    const size_t align = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+    return (size + align - 1) / align * align;
+}
+
+}  // namespace
+
+ConnectionSlab::ConnectionSlab()
+    : threadId_(CurrentThread::tid()),
+      slotSize_(0),
+      free_(nullptr),
+      remoteFree_(nullptr) {
+}
+
+ConnectionSlab::~ConnectionSlab() {
+    // 每个分配出去的对象都通过SlabAllocator持有slab，走到这里时所有槽位都已经归还，直接释放整块内存
+}
+
+void* ConnectionSlab::allocate(size_t size) {
+    assert(CurrentThread::tid() == threadId_);
+    if (slotSize_ == 0) {
+        slotSize_ = roundUp(size);
+    }
+    if (roundUp(size) != slotSize_) {
+        return ::operator new(size);
+    }
+    if (free_ == nullptr) {
+        free_ = remoteFree_.exchange(nullptr, std::memory_order_acquire);
+        if (free_ == nullptr) {
+            addChunk();
+        }
+    }
+    FreeSlot* slot = free_;
+    free_ = slot->next;
+    return slot;
+}
+
+void ConnectionSlab::deallocate(void* p, size_t size) {
+    if (roundUp(size) != slotSize_) {
+        ::operator delete(p);
+        return;
+    }
+    FreeSlot* slot = static_cast<FreeSlot*>(p);
+    if (CurrentThread::tid() == threadId_) {
+        slot->next = free_;
+        free_ = slot;
+    } else {
+        // 只有push和整体exchange，没有单个pop，不存在ABA问题
+        FreeSlot* head = remoteFree_.load(std::memory_order_relaxed);
+        do {
+            slot->next = head;
+        } while (!remoteFree_.compare_exchange_weak(head, slot, std::memory_order_release,
+                                                    std::memory_order_relaxed));
+    }
+}
+
+void ConnectionSlab::addChunk() {
+    std::unique_ptr<char[]> chunk(new char[slotSize_ * kSlotsPerChunk]);
+    char* base = chunk.get();
+    for (size_t i = kSlotsPerChunk; i > 0; --i) {
+        FreeSlot* slot = reinterpret_cast<FreeSlot*>(base + (i - 1) * slotSize_);
+        slot->next = free_;
+        free_ = slot;
+    }
+    chunks_.push_back(std::move(chunk));
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * 固定大小对象的slab，每个EventLoop一个，TcpConnection(连同shared_ptr的控制块)从这里分配。
+ * 槽位大小由第一次分配决定，之后大小不同的请求直接走operator new/delete。
+ * 分配只能在所属线程中进行；释放可以在任意线程：所属线程放回本地空闲链表，
+ * 其他线程(最后一个TcpConnectionPtr在别处释放)无锁地压入远程空闲栈(Treiber栈)，
+ * 所属线程在本地空闲链表用完时一次取走整个远程栈。
+ * 空闲槽位不归还给系统，连接数回落后仍保留峰值时的内存。
+ *
+ *   free_  -> slot -> slot -> nullptr            只有所属线程访问
+ *   remoteFree_ -> slot -> slot -> nullptr       其他线程push，所属线程exchange(nullptr)整体取走
+ */
+class ConnectionSlab : noncopyable {
+public:
+    // 每次向系统申请的槽位数
+    static const size_t kSlotsPerChunk = 64;
+
+    ConnectionSlab();
+    ~ConnectionSlab();
+
+    void* allocate(size_t size);
+    void deallocate(void* p, size_t size);
+
+    size_t slotSize() const { return slotSize_; }
+    // 向系统申请过的槽位总数
+    size_t numSlots() const { return chunks_.size() * kSlotsPerChunk; }
+
+private:
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    void addChunk();
+
+    const pid_t threadId_;
+    size_t slotSize_;     // 0表示还没有分配过
+    FreeSlot* free_;
+    std::atomic<FreeSlot*> remoteFree_;
+    std::vector<std::unique_ptr<char[]>> chunks_;
+};
+
+/**
+ * 从ConnectionSlab分配的标准分配器，供std::allocate_shared使用，
+ * 对象和控制块在同一个槽位中，控制块中保存的分配器持有slab，最后一个对象释放之前slab不会被销毁
+ */
+template <typename T>
+class SlabAllocator {
+public:
+    using value_type = T;
+
+    explicit SlabAllocator(std::shared_ptr<ConnectionSlab> slab) : slab_(std::move(slab)) {}
+    template <typename U>
+    SlabAllocator(const SlabAllocator<U>& other) : slab_(other.slab_) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(slab_->allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) { slab_->deallocate(p, n * sizeof(T)); }
+
+    template <typename U>
+    bool operator==(const SlabAllocator<U>& other) const { return slab_ == other.slab_; }
+    template <typename U>
+    bool operator!=(const SlabAllocator<U>& other) const { return slab_ != other.slab_; }
+
+private:
+    template <typename U>
+    friend class SlabAllocator;
+
+    std::shared_ptr<ConnectionSlab> slab_;
+};
@@ -0,0 +1,215 @@
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "SocketsOps.h"
+#include "Logging.h"
+
+#include <algorithm>
+#include <assert.h>
+#include <functional>
+#include <errno.h>
+
+const int Connector::kInitRetryDelayMs;
+const int Connector::kMaxRetryDelayMs;
+const double Connector::kDefaultConnectTimeout = 3.0;
+
+Connector::Connector(EventLoop* loop, const InetAddress& serverAddr)
+    : loop_(loop),
+      serverAddr_(serverAddr),
+      connect_(false),
+      state_(kDisconnected),
+      connectTimeout_(kDefaultConnectTimeout),
+      initRetryDelayMs_(kInitRetryDelayMs),
+      maxRetryDelayMs_(kMaxRetryDelayMs),
+      retryDelayMs_(kInitRetryDelayMs),
+      maxRetries_(-1),
+      retries_(0) {
+}
+
+Connector::~Connector() {
+    assert(!channel_);
+}
+
+void Connector::start() {
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop() {
+    if (connect_ && state_ == kDisconnected) {
+        connect();
+    }
+}
+
+void Connector::restart() {
+    setState(kDisconnected);
+    retryDelayMs_ = initRetryDelayMs_;
+    retries_ = 0;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::stop() {
+    connect_ = false;
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop() {
+    loop_->cancel(retryTimer_);
+    loop_->cancel(timeoutTimer_);
+    if (state_ == kConnecting) {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        sockets::close(sockfd);
+    }
+}
+
+/**
+ * 发起一次非阻塞连接
+ * @details 按connect()的errno分三类：正在连接，等待可写；暂时性错误，稍后重试；其他错误，放弃
+ */
+void Connector::connect() {
+    int sockfd = sockets::createNonblockingOrDie(AF_INET);
+    int ret = sockets::connect(sockfd, reinterpret_cast<const struct sockaddr*>(serverAddr_.getSockAddr()));
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch (savedErrno) {
+        case 0:
+        case EINPROGRESS:
+        case EINTR:
+        case EISCONN:
+            connecting(sockfd);
+            break;
+
+        case EAGAIN:
+        case EADDRINUSE:
+        case EADDRNOTAVAIL:
+        case ECONNREFUSED:
+        case ENETUNREACH:
+            retry(sockfd);
+            break;
+
+        case EACCES:
+        case EPERM:
+        case EAFNOSUPPORT:
+        case EALREADY:
+        case EBADF:
+        case EFAULT:
+        case ENOTSOCK:
+        default:
+            //log
+            LOG_ERROR << "Connector::connect() error " << savedErrno << " to " << serverAddr_.toIpPort();
+            sockets::close(sockfd);
+            setState(kDisconnected);
+            if (connectFailedCallback_) {
+                connectFailedCallback_();
+            }
+            break;
+    }
+}
+
+void Connector::connecting(int sockfd) {
+    setState(kConnecting);
+    channel_.reset(new Channel(loop_, sockfd));
+    // 回调在loop线程中执行，此时Connector一定还活着：channel_只在resetChannel()中释放
+    channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+    channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+    // 连接被拒绝时会同时报告EPOLLERR和EPOLLHUP，Channel只调用closeCallback
+    channel_->setCloseCallback(std::bind(&Connector::handleError, this));
+    channel_->enableWriting();
+
+    if (connectTimeout_ > 0) {
+        std::weak_ptr<Connector> weakSelf(shared_from_this());
+        timeoutTimer_ = loop_->runAfter(connectTimeout_, [weakSelf, sockfd]() {
+            std::shared_ptr<Connector> self(weakSelf.lock());
+            if (self) {
+                self->handleTimeout(sockfd);
+            }
+        });
+    }
+}
+
+int Connector::removeAndResetChannel() {
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 可能正在Channel::handleEvent()中，不能在这里释放channel_
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel() {
+    channel_.reset();
+}
+
+// socket可写：连接成功或者失败，用SO_ERROR区分
+void Connector::handleWrite() {
+    if (state_ != kConnecting) {
+        return;
+    }
+    loop_->cancel(timeoutTimer_);
+    int sockfd = removeAndResetChannel();
+    int err = sockets::getSocketError(sockfd);
+    if (err) {
+        //log
+        LOG_WARN << "Connector::handleWrite - SO_ERROR = " << err << " " << strerror(err);
+        retry(sockfd);
+    } else if (sockets::isSelfConnect(sockfd)) {
+        // 连接本机未监听的端口时，可能与自己分配到的临时端口相同而连上自己
+        LOG_WARN << "Connector::handleWrite - Self connect";
+        retry(sockfd);
+    } else {
+        setState(kConnected);
+        if (connect_ && newConnectionCallback_) {
+            newConnectionCallback_(sockfd);
+        } else {
+            sockets::close(sockfd);
+        }
+    }
+}
+
+void Connector::handleError() {
+    if (state_ == kConnecting) {
+        loop_->cancel(timeoutTimer_);
+        int sockfd = removeAndResetChannel();
+        int err = sockets::getSocketError(sockfd);
+        //log
+        LOG_WARN << "Connector::handleError - SO_ERROR = " << err << " " << strerror(err);
+        retry(sockfd);
+    }
+}
+
+void Connector::handleTimeout(int sockfd) {
+    // 只处理本次尝试的超时，fd号可能已被后来的尝试复用，但那时定时器已经被取消
+    if (state_ == kConnecting && channel_ && channel_->fd() == sockfd) {
+        //log
+        LOG_WARN << "Connector::handleTimeout - connect to " << serverAddr_.toIpPort() << " timed out";
+        removeAndResetChannel();
+        retry(sockfd);
+    }
+}
+
+void Connector::retry(int sockfd) {
+    sockets::close(sockfd);
+    setState(kDisconnected);
+    if (!connect_) {
+        return;
+    }
+    if (maxRetries_ >= 0 && retries_ >= maxRetries_) {
+        if (connectFailedCallback_) {
+            connectFailedCallback_();
+        }
+        return;
+    }
+    ++retries_;
+    //log
+    LOG_INFO << "Connector::retry - Retry connecting to " << serverAddr_.toIpPort()
+             << " in " << retryDelayMs_ << " milliseconds.";
+    std::weak_ptr<Connector> weakSelf(shared_from_this());
+    retryTimer_ = loop_->runAfter(retryDelayMs_ / 1000.0, [weakSelf]() {
+        std::shared_ptr<Connector> self(weakSelf.lock());
+        if (self) {
+            self->startInLoop();
+        }
+    });
+    retryDelayMs_ = std::min(retryDelayMs_ * 2, maxRetryDelayMs_);
+}
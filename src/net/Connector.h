@@ -0,0 +1,92 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+#include "TimerId.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class Channel;
+class EventLoop;
+
+/**
+ * 主动发起连接，是TcpClient/UpstreamPool的内部类，与Acceptor相对。
+ * 非阻塞connect，等待socket可写后用SO_ERROR判断是否连接成功，成功后把sockfd交给newConnectionCallback_，
+ * 由上层创建TcpConnection；Connector本身不持有连接。
+ * 连接失败或超时后按指数退避重试：初始间隔kInitRetryDelayMs，每次加倍，最大kMaxRetryDelayMs。
+ * 用shared_ptr管理，定时器和排队的任务只持有弱引用或临时的强引用。
+ */
+class Connector : noncopyable,
+                  public std::enable_shared_from_this<Connector> {
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+    // 重试次数用完之后调用
+    using ConnectFailedCallback = std::function<void()>;
+
+    Connector(EventLoop* loop, const InetAddress& serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback& cb) { newConnectionCallback_ = cb; }
+    void setConnectFailedCallback(const ConnectFailedCallback& cb) { connectFailedCallback_ = cb; }
+
+    // 每次尝试的超时时间，单位秒，<= 0表示只依赖内核的超时；在start()之前调用
+    void setConnectTimeout(double seconds) { connectTimeout_ = seconds; }
+    // 重试间隔的初始值和上限，单位毫秒；在start()之前调用
+    void setRetryDelay(int initMs, int maxMs) {
+        initRetryDelayMs_ = initMs;
+        maxRetryDelayMs_ = maxMs;
+        retryDelayMs_ = initMs;
+    }
+    // 失败后最多重试的次数，< 0表示一直重试；在start()之前调用
+    void setMaxRetries(int n) { maxRetries_ = n; }
+
+    const InetAddress& serverAddress() const { return serverAddr_; }
+
+    // 开始连接，可以在任意线程调用
+    void start();
+    // 连接断开后重新开始，重试间隔和次数复位，只能在loop线程调用
+    void restart();
+    // 停止连接和重试，可以在任意线程调用
+    void stop();
+
+    static const int kInitRetryDelayMs = 500;
+    static const int kMaxRetryDelayMs = 30 * 1000;
+    static const double kDefaultConnectTimeout;
+
+private:
+    enum States { kDisconnected, kConnecting, kConnected };
+
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    // connect()返回EINPROGRESS，等待socket可写
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void handleTimeout(int sockfd);
+    // 关闭sockfd，按退避间隔安排下一次尝试
+    void retry(int sockfd);
+    // 从poller中移除channel_并返回它的fd；channel_在本轮事件处理之后才能释放
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop* loop_;
+    InetAddress serverAddr_;
+    std::atomic_bool connect_;   // 是否要连接，stop()之后为false；start()/stop()可在任意线程调用，loop线程读取
+    States state_;
+    std::unique_ptr<Channel> channel_;
+    NewConnectionCallback newConnectionCallback_;
+    ConnectFailedCallback connectFailedCallback_;
+
+    double connectTimeout_;
+    int initRetryDelayMs_;
+    int maxRetryDelayMs_;
+    int retryDelayMs_;
+    int maxRetries_;
+    int retries_;
+    TimerId retryTimer_;
+    TimerId timeoutTimer_;
+};
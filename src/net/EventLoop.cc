@@ -4,12 +4,13 @@
 #include "Timestamp.h"
 #include "TimerQueue.h"
 #include "CurrentThread.h"
+#include "Logging.h"
 
 #include <assert.h>
 #include <algorithm>
+#include <functional>
 #include <sys/eventfd.h>
 #include <unistd.h>
-#include <iostream>
 
 // 防止一个线程创建多个EventLoop
 __thread EventLoop* t_loopInThisThread = nullptr;
@@ -22,7 +23,7 @@ int createEventfd() {
     int evfd = ::eventfd(0,  EFD_NONBLOCK | EFD_CLOEXEC);
     if (evfd < 0) {
         //log
-        std::cout<< "eventfd error: " << errno <<std::endl;
+        LOG_ERROR << "eventfd error: " << errno;
     }
     return evfd;
 }
@@ -31,24 +32,31 @@ EventLoop* getEventLoopOfCurrentThread() {
     return t_loopInThisThread;
 }
 
-EventLoop::EventLoop()
+EventLoop::EventLoop(Poller::Type pollerType)
     : threadId_(CurrentThread::tid()),
       looping_(false),
       quit_(false),
       callingPendingFunctors_(false),
-      poller_(Poller::newDefaultPoller(this)),
+      poller_(Poller::newDefaultPoller(this, pollerType)),
       timerQueue_(std::make_unique<TimerQueue>(this)),
       wakeupFd_(createEventfd()),
       wakeupChannel_(new Channel(this, wakeupFd_)),
       currentActiveChannel_(nullptr),
-      iteration_(0){
+      queueSize_(0),
+      wakeupPending_(false),
+      iteration_(0),
+      numConnections_(std::make_shared<std::atomic_int>(0)),
+      busyMicroSeconds_(0),
+      busySince_(0),
+      blockPool_(BlockPool::threadLocalPool()),
+      connectionSlab_(std::make_shared<ConnectionSlab>()) {
     //日志操作
-    std::cout << "EventLoop created " << this << " the index is " << threadId_ <<std::endl;
-    std::cout << "EventLoop created wakeupFd " << wakeupChannel_->fd() <<std::endl;
+    LOG_DEBUG << "EventLoop created " << this << " the index is " << threadId_;
+    LOG_DEBUG << "EventLoop created wakeupFd " << wakeupChannel_->fd();
     if (t_loopInThisThread) {
         //当前线程的EventLoop对象不为空，说明重复创建了
         //日志操作
-        std::cout << "Another EventLoop" << t_loopInThisThread << " exists in this thread " << threadId_  <<std::endl;
+        LOG_ERROR << "Another EventLoop" << t_loopInThisThread << " exists in this thread " << threadId_;
     } else {
         //当前线程尚未包含EventLoop对象
         t_loopInThisThread = this;
@@ -87,9 +95,11 @@ void EventLoop::loop() {
     while (!quit_) {
         activeChannels_.clear(); //清空激活通道列表
         //开始轮询
-        std::cout<< "have polled: "<< iteration_ <<std::endl;
+        LOG_TRACE << "have polled: "<< iteration_;
         pollReturnTime_ = poller_->poll(kPollTimeMs, activeChannels_);
         ++iteration_; //轮询次数加1
+        int64_t busySince = pollReturnTime_.microSecondsSinceEpoch();
+        busySince_.store(busySince, std::memory_order_relaxed);
         
         //处理所有激活事件
         //TODO：sort channel by priority queue
@@ -106,12 +116,26 @@ void EventLoop::loop() {
          * 这些回调函数在 std::vector<Functor> pendingFunctors_; 之中
          */
         doPendingFunctors();
+        // 只有loop线程写，不需要原子的加法
+        int64_t busy = Timestamp::now().microSecondsSinceEpoch() - busySince;
+        busyMicroSeconds_.store(busyMicroSeconds_.load(std::memory_order_relaxed) + busy, std::memory_order_relaxed);
+        busySince_.store(0, std::memory_order_relaxed);
     }
     //log
-    printf("EventLoop stop looping\n");
+    LOG_DEBUG << "EventLoop " << this << " stop looping";
     looping_ = false;
 }
 
+int64_t EventLoop::busyMicroSeconds() const {
+    int64_t busy = busyMicroSeconds_.load(std::memory_order_relaxed);
+    int64_t since = busySince_.load(std::memory_order_relaxed);
+    if (since > 0) {
+        // 一个很长的回调还没有返回时，也要算作忙碌
+        busy += std::max<int64_t>(0, Timestamp::now().microSecondsSinceEpoch() - since);
+    }
+    return busy;
+}
+
 void EventLoop::quit() {
     quit_ = true;
     /**
@@ -124,7 +148,8 @@ void EventLoop::quit() {
     // There is a chance that loop() just executes while(!quit_) and exits,
     // then EventLoop destructs, then we are accessing an invalid object.
     // Can be fixed using mutex_ in both places.
-    if (isInLoopThread()) {
+    // 在其他线程中调用时，loop线程可能阻塞在poll中，要唤醒它才能退出循环
+    if (!isInLoopThread()) {
         wakeup();
     }
 }
@@ -159,11 +184,17 @@ bool EventLoop::hasChannel(Channel* channel){
 }
 
 
-// //取消指定的定时器
-// //调用此函数的不必是loop线程
-// void EventLoop::cancel(TimerId timerId){
-//     timerQueue_->cancel(timerId);
-// }
+//取消指定的定时器
+//调用此函数的不必是loop线程
+void EventLoop::cancel(TimerId timerId){
+    timerQueue_->cancel(timerId);
+}
+
+//重置指定的定时器
+//调用此函数的不必是loop线程
+void EventLoop::resetTimerAt(TimerId timerId, Timestamp when){
+    timerQueue_->reset(timerId, when);
+}
 
 /**
 * 执行用户任务
@@ -176,7 +207,7 @@ void EventLoop::runInLoop(Functor cb){
     if (isInLoopThread()) {
         cb();
     } else {
-        queueInLoop(cb);
+        queueInLoop(std::move(cb));
     }
 }
 
@@ -185,12 +216,13 @@ void EventLoop::runInLoop(Functor cb){
 * @param cb 用户任务函数
 * @note 如果当前线程不是创建当前EventLoop对象的线程，或者正在调用pending functor，
 * 就唤醒loop线程，避免loop线程阻塞.
+* 入队是无锁的，多个线程同时投递任务不会互相阻塞；
+* 并且从上一次处理队列以来只有第一次入队才会真正写eventfd，其余的入队省去这次系统调用.
 */
 void EventLoop::queueInLoop(Functor cb){
-    {
-        std::lock_guard<std::mutex> lk(mutex_);
-        pendingFuntors_.push_back(cb);
-    }
+    // 先计数再入队，保证loop线程减去计数时不会出现下溢
+    queueSize_.fetch_add(1, std::memory_order_relaxed);
+    pendingFunctors_.push(std::move(cb));
     // 唤醒相应的，需要执行上面回调操作的loop线程
     /** 
      * TODO:
@@ -199,7 +231,11 @@ void EventLoop::queueInLoop(Functor cb){
      * 则这个时候也需要唤醒，否则就会发生有事件到来但是仍被阻塞住的情况，这样，等他处理完当前事件后，就会再次轮询，检查是否有事件发生，此时，就会被唤醒
      */
     if (!isInLoopThread() || callingPendingFunctors_) {
-        wakeup();
+        // 必须在入队之后再检查标志：loop线程先清除标志再取队列，
+        // 所以要么它能取到这个任务，要么这里能看到标志已被清除而重新唤醒
+        if (!wakeupPending_.exchange(true)) {
+            wakeup();
+        }
     }
 }
 
@@ -208,15 +244,10 @@ void EventLoop::wakeup() {
     ssize_t n = write(wakeupFd_, &one, sizeof one);
     if (n != sizeof one) {
         //log
-        std::cout << "EventLoop::wakeup writes " << n << " bytes instead of 8" << std::endl;
+        LOG_ERROR << "EventLoop::wakeup writes " << n << " bytes instead of 8";
     }
 }
 
-size_t EventLoop::queueSize() const {
-    std::lock_guard<std::mutex> lk(mutex_);
-    return pendingFuntors_.size();
-}
-
 //有2处可能导致loop线程阻塞：
 //1）Poller::poll()中调用poll(2)/epoll_wait(7) 监听fd，没有事件就绪时；
 //2）用户任务函数调用了可能导致阻塞的函数；
@@ -231,21 +262,23 @@ void EventLoop::handleRead() {
 }
 
 void EventLoop::doPendingFunctors() {
-    std::vector<Functor> functors;
     callingPendingFunctors_ = true;
+    // 先清除标志再取队列，此后入队的任务都会重新唤醒loop线程
+    wakeupPending_.store(false);
     /**
-     * TODO:
-     * 如果没有生成这个局部的 functors
-     * 则在互斥锁加持下，我们直接遍历pendingFunctors
-     * 其他线程这个时候无法访问，无法向里面注册回调函数，增加服务器时延
+     * 先把当前队列中的任务全部取出，再逐个执行，
+     * 这样执行回调的过程中新加入的任务会留到下一轮循环，与原先交换vector的语义一致，
+     * 也避免了回调不断投递新任务时本轮循环无法结束
      */
-    {
-        std::lock_guard<std::mutex> lk(mutex_);
-        functors.swap(pendingFuntors_);
+    Functor functor;
+    while (pendingFunctors_.pop(functor)) {
+        runningFunctors_.push_back(std::move(functor));
     }
-    for (auto &func : functors) {
+    queueSize_.fetch_sub(runningFunctors_.size(), std::memory_order_relaxed);
+    for (auto &func : runningFunctors_) {
         func();
     }
+    runningFunctors_.clear();
     callingPendingFunctors_ = false;
 }
 
@@ -5,24 +5,28 @@
 #include "CurrentThread.h"
 #include "TimerId.h"
 #include "TimerQueue.h"
+#include "MpscQueue.h"
+#include "InplaceFunction.h"
+#include "Poller.h"
+#include "BlockPool.h"
+#include "ConnectionSlab.h"
 
 #include <thread>
 #include <stdio.h>
 #include <vector>
 #include <memory>
-#include <functional>
 #include <atomic>
-#include <mutex>
 
 class Channel;
-class Poller;
 
 //Reactor模式：one loop per thread，每个线程一个EventLoop,主要包含了两大模块，channel、poller
 class EventLoop : noncopyable {
 public:
-    using Functor = std::function<void()>;
+    // 不会在堆上分配内存的回调，捕获的对象超过64字节时编译报错
+    using Functor = InplaceFunction<void()>;
 
-    EventLoop();
+    // pollerType选择IO复用的实现，默认由环境变量MUDUO_USE_IOURING决定
+    explicit EventLoop(Poller::Type pollerType = Poller::kDefault);
     ~EventLoop();
 
     /* loop循环, 运行一个死循环.
@@ -46,8 +50,26 @@ public:
     
     // 返回迭代的次数
     int64_t iterator() const { return iteration_; }
-    //正在排队的回调cb的个数
-    size_t queueSize()const;
+    //正在排队的回调cb的个数，其他线程读取时只是一个近似值
+    size_t queueSize() const { return queueSize_.load(std::memory_order_relaxed); }
+
+    // 以下负载计数供EventLoopThreadPool选择loop，其他线程读取时只是近似值
+    // 属于这个loop的TcpConnection个数
+    int numConnections() const { return numConnections_->load(std::memory_order_relaxed); }
+    // 累计处理事件和回调(不含阻塞在poll中)的时间，单位us，包括正在进行的这一轮
+    int64_t busyMicroSeconds() const;
+
+    // 本loop线程的数据块池，ChainBuffer和TcpConnection的输出队列从这里取16KB的数据块
+    const std::shared_ptr<BlockPool>& blockPool() const { return blockPool_; }
+    // 本loop的TcpConnection对象slab，只能在loop线程中分配，见TcpConnection::create()
+    const std::shared_ptr<ConnectionSlab>& connectionSlab() const { return connectionSlab_; }
+
+    //internal usage
+    // 连接计数器，TcpConnection构造时持有一份，析构时通过它减计数，连接比loop活得久也不会访问已经销毁的loop
+    const std::shared_ptr<std::atomic_int>& connectionCounter() const { return numConnections_; }
+    // TcpServer在连接构造之前为它占位计数，连接构造后撤销占位，都在loop存活期间调用
+    void connectionCreated() { numConnections_->fetch_add(1, std::memory_order_relaxed); }
+    void connectionDestroyed() { numConnections_->fetch_sub(1, std::memory_order_relaxed); }
 
     //确保cb是在loop线程内运行
     //如果在loop线程中, 立即运行回调cb.
@@ -56,7 +78,7 @@ public:
     void runInLoop(Functor cb);
 
     /**
-     * 把cb放入队列，唤醒loop所在的线程执行cb
+     * 把cb放入无锁队列，唤醒loop所在的线程执行cb
      * 实际情况：
      * 在mainLoop中获取subLoop指针，然后调用相应函数
      * 在queueLoop中发现当前的线程不是创建这个subLoop的线程，将此函数装入subLoop的pendingFunctors容器中
@@ -78,8 +100,8 @@ public:
     * @param time 时间戳对象, 单位us
     * @param cb 超时回调函数. 当前时间超过time代表时间时, EventLoop就会调用cb
     */
-    void runAt(Timestamp when, const Functor& cb) {
-        timerQueue_->addTimer(cb, when, 0.0);
+    TimerId runAt(Timestamp when, Functor cb) {
+        return timerQueue_->addTimer(std::move(cb), when, 0.0);
     }
 
     //在当前时间点延迟delay后运行回调cb，从其他线程调用是安全的
@@ -87,8 +109,8 @@ public:
     * @param delay 相对时间, 单位s, 精度1us(小数)
     * @param cb 超时回调
     */
-    void runAfter(double delay, const Functor& cb) {
-        timerQueue_->addTimer(cb, Timestamp::now() + delay, 0.0);
+    TimerId runAfter(double delay, Functor cb) {
+        return timerQueue_->addTimer(std::move(cb), Timestamp::now() + delay, 0.0);
     }
 
     //每隔interval 秒周期调用回调cb
@@ -98,13 +120,21 @@ public:
     * @param cb 超时回调
     */
     //从其他线程调用是安全的
-    void runEvery(double interval, const Functor& cb) {
-        timerQueue_->addTimer(cb, Timestamp::now() + interval, interval);
+    TimerId runEvery(double interval, Functor cb) {
+        return timerQueue_->addTimer(std::move(cb), Timestamp::now() + interval, interval);
     }
     
     // 取消指定的定时器，TimerId唯一标识定时器Timer
     // 从其他线程调用是安全的
-    // void cancel(TimerId timerfd);
+    void cancel(TimerId timerId);
+
+    // 把定时器的下一次超时时刻改为when，O(1)，适合频繁推迟的空闲超时定时器
+    // 从其他线程调用是安全的
+    void resetTimerAt(TimerId timerId, Timestamp when);
+    // 把定时器的下一次超时时刻改为delay秒之后
+    void resetTimerAfter(TimerId timerId, double delay) {
+        resetTimerAt(timerId, Timestamp::now() + delay);
+    }
 
     //更新Poller监听的channel,只能在channel所属的loop线程中调用
     void updateChannel(Channel* channel);
@@ -121,7 +151,7 @@ private:
 
     //wake up
     // 被设置为唤醒EventLoop后的回调， 其实什么都不做，只是为了让当前线程被唤醒，然后继续沿着loop运行，
-    // 发现没有什么事做，就执行pendingFuntors_中的回调。
+    // 发现没有什么事做，就执行pendingFunctors_中的回调。
     void handleRead();
     //处理pending函数
     void doPendingFunctors();
@@ -158,9 +188,20 @@ private:
     // 当前正在处理的活跃channel
     Channel* currentActiveChannel_;
     
-    mutable std::mutex mutex_; // 用于保护pendingFuntors_
-    // 待调用函数列表，用于存放不在loop线程中调用的函数，
+    // 待调用函数队列，用于存放不在loop线程中调用的函数，
     // 当这些函数被调用时，发现调用它们的线程不是loop线程，则将这些函数存放于此，由loop线程调用
-    std::vector<Functor> pendingFuntors_;
+    // 多个生产者线程无锁入队，只有loop线程出队
+    MpscQueue<Functor> pendingFunctors_;
+    // doPendingFunctors()一次取出的回调，复用其容量，避免每轮循环都分配内存
+    std::vector<Functor> runningFunctors_;
+    std::atomic_size_t queueSize_;
+    // true表示已经写过eventfd且loop线程还没有开始处理队列，此时再入队不必重复wakeup()
+    std::atomic_bool wakeupPending_;
     int64_t iteration_; //loop循环次数
+    std::shared_ptr<std::atomic_int> numConnections_;
+    // 之前各轮循环的忙碌时间之和；正在处理事件时busySince_为本轮poll()返回的时刻，阻塞在poll中时为0
+    std::atomic<int64_t> busyMicroSeconds_;
+    std::atomic<int64_t> busySince_;
+    std::shared_ptr<BlockPool> blockPool_;
+    std::shared_ptr<ConnectionSlab> connectionSlab_;
 };
\ No newline at end of file
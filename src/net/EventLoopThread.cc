@@ -1,11 +1,16 @@
 #include "EventLoopThread.h"
 #include "EventLoop.h"
+#include "CpuTopology.h"
+#include "Logging.h"
 
 #include <assert.h>
 
-EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const std::string& name)
+EventLoopThread::EventLoopThread(const ThreadInitCallback& cb, const std::string& name,
+                                 Poller::Type pollerType, const std::vector<int>& cpus)
     : thread_(std::bind(&EventLoopThread::threadFunc, this), name),
-      callback_(cb){}
+      callback_(cb),
+      pollerType_(pollerType),
+      cpus_(cpus){}
 
 EventLoopThread::~EventLoopThread() {
     exiting_ = true;
@@ -31,7 +36,15 @@ EventLoop* EventLoopThread::startLoop(){
 
 //此函数即为loop线程的运行函数
 void EventLoopThread::threadFunc(){
-    EventLoop loop;
+    // 先绑定CPU再创建EventLoop，poller、定时器队列等都在本地节点上分配
+    if (!cpus_.empty()) {
+        bool ok = CpuTopology::pinCurrentThread(cpus_);
+        //log
+        LOG_INFO << "EventLoopThread [" << thread_.name() << "] tid " << CurrentThread::tid()
+                 << (ok ? " pinned to cpus " : " failed to pin to cpus ") << CpuTopology::formatCpuList(cpus_)
+                 << " (node " << CpuTopology::nodeOfCpu(cpus_.front()) << ")";
+    }
+    EventLoop loop(pollerType_);
     if(callback_){
         callback_(&loop);
     }
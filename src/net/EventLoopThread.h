@@ -2,11 +2,13 @@
 
 #include "noncopyable.h"
 #include "Thread.h"
+#include "Poller.h"
 
 #include <functional>
 #include <string>
 #include <mutex>
 #include <condition_variable>
+#include <vector>
 
 class EventLoop;
 
@@ -14,8 +16,11 @@ class EventLoopThread: public noncopyable {
 public:
     using ThreadInitCallback = std::function<void (EventLoop*)>;
 
+    // cpus不为空时，线程在创建EventLoop之前绑定到这些CPU上，之后loop分配的内存都在本地NUMA节点上
     EventLoopThread(const ThreadInitCallback& cb = ThreadInitCallback(),
-                    const std::string& name = std::string());
+                    const std::string& name = std::string(),
+                    Poller::Type pollerType = Poller::kDefault,
+                    const std::vector<int>& cpus = std::vector<int>());
     ~EventLoopThread();
 
     //启动线程，开始执行loop循环，并返回此线程对应的subloop
@@ -30,4 +35,6 @@ private:
     Thread thread_;
     std::condition_variable cond_;
     ThreadInitCallback callback_;
+    Poller::Type pollerType_;  // 线程中创建的EventLoop使用的poller
+    std::vector<int> cpus_;    // 绑定的CPU，为空表示不绑定
 };
\ No newline at end of file
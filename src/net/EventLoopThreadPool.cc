@@ -1,8 +1,36 @@
 #include "EventLoopThreadPool.h"
 #include "EventLoopThread.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+#include "CpuTopology.h"
+#include "Logging.h"
 
 #include <assert.h>
+#include <algorithm>
 #include <memory>
+#include <set>
+
+const int EventLoopThreadPool::kVirtualNodes;
+
+namespace {
+
+// kLeastBusy每隔100ms采样一次，新的占比与旧值各占一半
+const int64_t kSampleIntervalUs = 100 * 1000;
+const double kBusyAlpha = 0.5;
+// 忙碌占比与最低值相差不超过5%的loop视为一样空闲
+const double kBusyTolerance = 0.05;
+
+// murmur3的32位finalizer，把相邻的整数打散到整个值域，且与进程无关，重启后同一IP仍落在同一个loop
+uint32_t mix32(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+} // namespace
 
 EventLoopThreadPool::EventLoopThreadPool(EventLoop* baseloop,const std::string& nameArg)
     : baseLoop_(baseloop),
@@ -16,9 +44,10 @@ EventLoopThreadPool::~EventLoopThreadPool() {
 
 void EventLoopThreadPool::start(const ThreadInitCallback& cb) {
     started_ = true;
+    loopCpus_ = planAffinity();
     for (int i=0; i<numThreads_; ++i) {
         // IO线程名称: 线程池名称 + 线程编号
-        auto threadPtr= std::make_unique<EventLoopThread>(cb, name_ + std::to_string(i));
+        auto threadPtr= std::make_unique<EventLoopThread>(cb, name_ + std::to_string(i), pollerType_, loopCpus_[i]);
         loops_.push_back(threadPtr->startLoop());
         threads_.push_back(std::move(threadPtr));
     }
@@ -27,6 +56,12 @@ void EventLoopThreadPool::start(const ThreadInitCallback& cb) {
         // 那么不用交给新线程去运行用户回调函数了
         cb(baseLoop_);
     }
+    loads_.resize(loops_.size());
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        loads_[i].lastBusyMicroSeconds = loops_[i]->busyMicroSeconds();
+    }
+    lastSample_ = Timestamp::now();
+    buildHashRing();
 }
 
 //轮流获取每一个loop，实现负载均衡
@@ -56,6 +91,160 @@ EventLoop* EventLoopThreadPool::getLoopForHash(size_t hashCode){
     return loop;
 }
 
+EventLoop* EventLoopThreadPool::getLoopForConnection(const InetAddress& peerAddr) {
+    assert(started_);
+    if (loops_.empty()) {
+        return baseLoop_;
+    }
+    switch (policy_) {
+        case kLeastConnections:
+            return getLeastConnectionsLoop();
+        case kLeastBusy:
+            return getLeastBusyLoop();
+        case kConsistentHash:
+            return getLoopForPeer(peerAddr);
+        case kRoundRobin:
+        default:
+            return getNextLoop();
+    }
+}
+
+// 连接数相同时从next_开始轮流选，避免总是选中第一个loop
+EventLoop* EventLoopThreadPool::getLeastConnectionsLoop() {
+    int n = static_cast<int>(loops_.size());
+    int best = next_;
+    for (int j = 1; j < n; ++j) {
+        int i = (next_ + j) % n;
+        if (loops_[i]->numConnections() < loops_[best]->numConnections()) {
+            best = i;
+        }
+    }
+    next_ = (best + 1) % n;
+    return loops_[best];
+}
+
+EventLoop* EventLoopThreadPool::getLeastBusyLoop() {
+    sampleBusy();
+    double minUtilization = 1.0;
+    for (const LoopLoad& load : loads_) {
+        minUtilization = std::min(minUtilization, load.utilization);
+    }
+    // 采样间隔内忙碌占比不会变化，在差不多空闲的loop之间按连接数分配
+    int n = static_cast<int>(loops_.size());
+    int best = -1;
+    for (int j = 0; j < n; ++j) {
+        int i = (next_ + j) % n;
+        if (loads_[i].utilization > minUtilization + kBusyTolerance) {
+            continue;
+        }
+        if (best < 0 || loops_[i]->numConnections() < loops_[best]->numConnections()) {
+            best = i;
+        }
+    }
+    next_ = (best + 1) % n;
+    return loops_[best];
+}
+
+void EventLoopThreadPool::sampleBusy() {
+    Timestamp now = Timestamp::now();
+    int64_t elapsed = now.microSecondsSinceEpoch() - lastSample_.microSecondsSinceEpoch();
+    if (elapsed < kSampleIntervalUs) {
+        return;
+    }
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        int64_t busy = loops_[i]->busyMicroSeconds();
+        double utilization = std::min(1.0, static_cast<double>(busy - loads_[i].lastBusyMicroSeconds) / elapsed);
+        loads_[i].utilization = kBusyAlpha * utilization + (1 - kBusyAlpha) * loads_[i].utilization;
+        loads_[i].lastBusyMicroSeconds = busy;
+    }
+    lastSample_ = now;
+}
+
+void EventLoopThreadPool::buildHashRing() {
+    ring_.clear();
+    ring_.reserve(loops_.size() * kVirtualNodes);
+    for (size_t i = 0; i < loops_.size(); ++i) {
+        for (int v = 0; v < kVirtualNodes; ++v) {
+            uint32_t node = static_cast<uint32_t>(i * kVirtualNodes + v);
+            ring_.emplace_back(mix32(node ^ 0x9e3779b9), static_cast<int>(i));
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+}
+
+// 只按IP哈希，不含端口：同一客户端的多个连接落在同一个loop
+EventLoop* EventLoopThreadPool::getLoopForPeer(const InetAddress& peerAddr) {
+    uint32_t h = mix32(peerAddr.getSockAddr()->sin_addr.s_addr);
+    auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(h, 0));
+    if (it == ring_.end()) {
+        it = ring_.begin();
+    }
+    return loops_[it->second];
+}
+
+std::vector<std::vector<int>> EventLoopThreadPool::planAffinity() const {
+    std::vector<std::vector<int>> plan(numThreads_);
+    if (affinity_ == kNoAffinity || numThreads_ == 0) {
+        return plan;
+    }
+    std::set<int> excluded(excludedCpus_.begin(), excludedCpus_.end());
+    std::vector<CpuTopology::CpuInfo> available;
+    for (const CpuTopology::CpuInfo& info : CpuTopology::availableCpus()) {
+        if (excluded.count(info.cpu) == 0) {
+            available.push_back(info);
+        }
+    }
+
+    // 每个IO线程可以使用的CPU集合，IO线程多于集合数时循环使用
+    std::vector<std::vector<int>> choices;
+    if (affinity_ == kCpuList) {
+        // 只用在线且进程允许使用的CPU
+        std::set<int> usable;
+        for (const CpuTopology::CpuInfo& info : available) {
+            usable.insert(info.cpu);
+        }
+        for (int cpu : cpuList_) {
+            if (usable.count(cpu) != 0) {
+                choices.push_back(std::vector<int>(1, cpu));
+            }
+        }
+    } else if (affinity_ == kOneLoopPerCore) {
+        // 每个物理核取第一个超线程，先排满一个节点再用下一个节点
+        std::stable_sort(available.begin(), available.end(),
+                         [](const CpuTopology::CpuInfo& a, const CpuTopology::CpuInfo& b) { return a.node < b.node; });
+        std::set<std::pair<int, int>> cores;
+        for (const CpuTopology::CpuInfo& info : available) {
+            if (cores.insert(std::make_pair(info.package, info.core)).second) {
+                choices.push_back(std::vector<int>(1, info.cpu));
+            }
+        }
+    } else if (affinity_ == kNumaNode) {
+        std::vector<int> nodeCpus;
+        for (const CpuTopology::CpuInfo& info : available) {
+            if (info.node == numaNode_) {
+                nodeCpus.push_back(info.cpu);
+            }
+        }
+        if (!nodeCpus.empty()) {
+            choices.push_back(nodeCpus);
+        }
+    }
+
+    //log
+    if (choices.empty()) {
+        LOG_WARN << "EventLoopThreadPool [" << name_ << "] no usable cpu for the affinity policy, threads are not pinned";
+        return plan;
+    }
+    if (affinity_ != kNumaNode && static_cast<int>(choices.size()) < numThreads_) {
+        LOG_INFO << "EventLoopThreadPool [" << name_ << "] " << numThreads_ << " threads share "
+                 << choices.size() << " cpus";
+    }
+    for (int i = 0; i < numThreads_; ++i) {
+        plan[i] = choices[i % choices.size()];
+    }
+    return plan;
+}
+
 std::vector<EventLoop*> EventLoopThreadPool::getAllLoops() {
     assert(started_);
     if (loops_.empty()) {
@@ -1,7 +1,10 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "Poller.h"
+#include "Timestamp.h"
 
+#include <stdint.h>
 #include <functional>
 #include <memory>
 #include <vector>
@@ -9,15 +12,55 @@
 
 class EventLoop;
 class EventLoopThread;
+class InetAddress;
 
 class EventLoopThreadPool : public noncopyable{
 public:
     using ThreadInitCallback = std::function<void (EventLoop*)>;
 
+    // 新连接分配到哪个IO loop
+    enum PlacementPolicy {
+        kRoundRobin,        // 轮询
+        kLeastConnections,  // 当前连接最少的loop
+        /**
+         * 最近一段时间最不忙的loop：周期性地采样各loop处理事件的时间占比并做指数平均，
+         * 选占比最低的；与最低占比相差不大的loop之间再选连接最少的，避免一批新连接都挤到同一个loop
+         */
+        kLeastBusy,
+        /**
+         * 按对端IP做一致性哈希，同一客户端的连接总是落在同一个loop上(会话亲和)，
+         * 每个loop在哈希环上有kVirtualNodes个虚拟节点，loop数变化时只有少部分客户端换loop
+         */
+        kConsistentHash,
+    };
+
+    // IO线程绑定到哪些CPU
+    enum AffinityPolicy {
+        kNoAffinity,      // 不绑定，由内核调度
+        kCpuList,         // 第i个IO线程绑定到setCpuList()给出的第i个CPU
+        kOneLoopPerCore,  // 每个物理核一个IO线程，绑定到核上的第一个超线程，按NUMA节点依次分配
+        kNumaNode,        // 所有IO线程绑定到setNumaNode()给出的节点的全部CPU上，由内核在节点内调度
+    };
+
     EventLoopThreadPool(EventLoop* baseLoop, const std::string& nameArg);
     ~EventLoopThreadPool();
     //设置线程数，需在start()之前调用
     void setThreadNum(int numThreads) { numThreads_ = numThreads; }
+    //设置IO线程的poller实现，需在start()之前调用
+    void setPollerType(Poller::Type type) { pollerType_ = type; }
+    //设置新连接的分配策略，需在start()之前调用
+    void setPlacementPolicy(PlacementPolicy policy) { policy_ = policy; }
+    PlacementPolicy placementPolicy() const { return policy_; }
+    /**
+     * 设置IO线程的CPU绑定，需在start()之前调用
+     * @details 线程在创建EventLoop之前绑定，之后在该线程中分配的poller、连接对象和缓冲区
+     * 按Linux默认的first touch策略都位于本地NUMA节点上；绑定结果在start()时打印出来
+     */
+    void setCpuAffinity(AffinityPolicy policy) { affinity_ = policy; }
+    void setCpuList(const std::vector<int>& cpus) { affinity_ = kCpuList; cpuList_ = cpus; }
+    void setNumaNode(int node) { affinity_ = kNumaNode; numaNode_ = node; }
+    // 不分配给IO线程的CPU(例如隔离出来处理网卡中断或留给其他进程的核)，对所有绑定策略有效
+    void setExcludedCpus(const std::vector<int>& cpus) { excludedCpus_ = cpus; }
     //启动线程池
     void start(const ThreadInitCallback& cb = ThreadInitCallback());
 
@@ -28,20 +71,54 @@ public:
     // with the same hash code, it will always return the same EventLoop
     EventLoop* getLoopForHash(size_t hashCode);
 
+    // 按分配策略为来自peerAddr的新连接选择loop，只在baseLoop线程中调用
+    EventLoop* getLoopForConnection(const InetAddress& peerAddr);
+
     //获取所有的loops
     std::vector<EventLoop*> getAllLoops();
 
+    // 第i个IO线程实际绑定的CPU，为空表示没有绑定；没有IO线程时整个为空，在start()之后有效
+    const std::vector<std::vector<int>>& loopCpus() const { return loopCpus_; }
+
     bool started() const { return started_; }
 
     //获取线程池的名称
     const std::string& name() const { return name_; }
 
+    static const int kVirtualNodes = 64;
+
 private:
+    EventLoop* getLeastConnectionsLoop();
+    EventLoop* getLeastBusyLoop();
+    EventLoop* getLoopForPeer(const InetAddress& peerAddr);
+    // 距上次采样超过kSampleInterval时，更新各loop的忙碌占比
+    void sampleBusy();
+    void buildHashRing();
+    // 按affinity_为每个IO线程算出要绑定的CPU，为空表示不绑定
+    std::vector<std::vector<int>> planAffinity() const;
+
+    // kLeastBusy的采样状态
+    struct LoopLoad {
+        int64_t lastBusyMicroSeconds = 0;
+        double utilization = 0.0;  // 处理事件的时间占比的指数平均，0~1
+    };
+
     EventLoop* baseLoop_; // 与Acceptor所属EventLoop相同，即mainLoop
     std::string name_;    // 线程池名称, 通常由用户指定. 线程池中EventLoopThread名称依赖于线程池名称
     bool started_;        // 线程池是否启动标志
     int numThreads_ = 0;      // 线程数
     int next_ = 0;            // 新连接到来，所选择的EventLoopThread的下标
+    Poller::Type pollerType_ = Poller::kDefault;  // IO线程的poller实现
     std::vector<std::unique_ptr<EventLoopThread>> threads_; // IO线程列表
     std::vector<EventLoop*> loops_;  // EventLoop列表, 指向的是EventLoopThread线程函数创建的EventLoop对象
+    PlacementPolicy policy_ = kRoundRobin;
+    std::vector<LoopLoad> loads_;
+    Timestamp lastSample_;
+    // 一致性哈希环：按哈希值排序的(虚拟节点哈希, loop下标)
+    std::vector<std::pair<uint32_t, int>> ring_;
+    AffinityPolicy affinity_ = kNoAffinity;
+    std::vector<int> cpuList_;
+    int numaNode_ = 0;
+    std::vector<int> excludedCpus_;
+    std::vector<std::vector<int>> loopCpus_;  // start()时planAffinity()的结果
 };
\ No newline at end of file
@@ -0,0 +1,212 @@
+#include "OutputQueue.h"
+#include "Buffer.h"
+#include "ChainBuffer.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+
+const size_t OutputQueue::kBlockSize;
+
+OutputQueue::OutputQueue(std::shared_ptr<BlockPool> pool)
+    : head_(0),
+      bytes_(0),
+      fileBytes_(0),
+      pool_(std::move(pool)) {
+}
+
+OutputQueue::~OutputQueue() {
+    clear();
+}
+
+void OutputQueue::append(const void* data, size_t len) {
+    const char* p = static_cast<const char*>(data);
+    // 先填满队尾数据块的剩余空间
+    if (!empty() && segments_.back().block != nullptr) {
+        Segment& tail = segments_.back();
+        char* end = const_cast<char*>(tail.data) + tail.len;
+        size_t n = std::min(static_cast<size_t>(tail.block + kBlockSize - end), len);
+        memcpy(end, p, n);
+        tail.len += n;
+        bytes_ += n;
+        p += n;
+        len -= n;
+    }
+    // 剩余数据较大时连续开多个块，每个字节只拷贝一次
+    while (len > 0) {
+        size_t n = std::min(len, kBlockSize);
+        Segment seg;
+        seg.block = pool_->allocate();
+        memcpy(seg.block, p, n);
+        seg.data = seg.block;
+        seg.len = n;
+        pushBack(std::move(seg));
+        bytes_ += n;
+        p += n;
+        len -= n;
+    }
+}
+
+void OutputQueue::append(std::string&& message) {
+    if (message.empty()) {
+        return;
+    }
+    auto holder = std::make_shared<std::string>(std::move(message));
+    const char* data = holder->data();
+    size_t len = holder->size();
+    appendSlice(std::move(holder), data, len);
+}
+
+void OutputQueue::append(Buffer&& message) {
+    if (message.readableBytes() == 0) {
+        return;
+    }
+    auto holder = std::make_shared<Buffer>(std::move(message));
+    const char* data = holder->peek();
+    size_t len = holder->readableBytes();
+    appendSlice(std::move(holder), data, len);
+}
+
+void OutputQueue::append(ChainBuffer&& message) {
+    for (const ChainBuffer::Block& block : message.blocks_) {
+        size_t len = block.writeIndex - block.readIndex;
+        if (len == 0 || block.capacity != kBlockSize) {
+            // pullup()分配的大块不是池中的块，拷贝后由message释放
+            append(block.data + block.readIndex, len);
+            message.releaseBlock(block);
+            continue;
+        }
+        // 所有池分配的块可以互相归还，直接接管
+        Segment seg;
+        seg.block = block.data;
+        seg.data = block.data + block.readIndex;
+        seg.len = len;
+        pushBack(std::move(seg));
+        bytes_ += len;
+    }
+    message.blocks_.clear();
+    message.bytes_ = 0;
+}
+
+void OutputQueue::appendSlice(std::shared_ptr<const void> owner, const char* data, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    Segment seg;
+    seg.holder = std::move(owner);
+    seg.data = data;
+    seg.len = len;
+    pushBack(std::move(seg));
+    bytes_ += len;
+}
+
+void OutputQueue::appendFile(std::shared_ptr<const void> owner, int fd, off_t offset, size_t len) {
+    if (len == 0) {
+        return;
+    }
+    Segment seg;
+    seg.holder = std::move(owner);
+    seg.fd = fd;
+    seg.offset = offset;
+    seg.len = len;
+    pushBack(std::move(seg));
+    bytes_ += len;
+    fileBytes_ += len;
+}
+
+ssize_t OutputQueue::writeFd(int fd, int& savedErrno) {
+    if (empty()) {
+        return 0;
+    }
+    Segment& front = segments_[head_];
+    if (front.fd >= 0) {
+        // 文件段，数据直接在内核中从文件拷贝到socket
+        ssize_t n = ::sendfile(fd, front.fd, &front.offset, front.len);
+        if (n < 0) {
+            savedErrno = errno;
+        } else if (n == 0) {
+            // 文件比指定的区间短，剩余部分已经无法发送，丢弃这一段
+            bytes_ -= front.len;
+            fileBytes_ -= front.len;
+            popFront();
+        } else {
+            // sendfile已经更新了offset
+            front.len -= n;
+            bytes_ -= n;
+            fileBytes_ -= n;
+            if (front.len == 0) {
+                popFront();
+            }
+        }
+        return n;
+    }
+
+    // 组装队头连续的内存段，遇到文件段为止
+    struct iovec vec[IOV_MAX];
+    int iovcnt = 0;
+    for (size_t i = head_; i < segments_.size(); ++i) {
+        const Segment& seg = segments_[i];
+        if (seg.fd >= 0 || iovcnt == IOV_MAX) {
+            break;
+        }
+        vec[iovcnt].iov_base = const_cast<char*>(seg.data);
+        vec[iovcnt].iov_len = seg.len;
+        ++iovcnt;
+    }
+    ssize_t n = ::writev(fd, vec, iovcnt);
+    if (n < 0) {
+        savedErrno = errno;
+    } else {
+        retrieve(n);
+    }
+    return n;
+}
+
+void OutputQueue::retrieve(size_t n) {
+    while (n > 0) {
+        Segment& front = segments_[head_];
+        if (n < front.len) {
+            front.data += n;
+            front.len -= n;
+            bytes_ -= n;
+            return;
+        }
+        n -= front.len;
+        bytes_ -= front.len;
+        popFront();
+    }
+}
+
+void OutputQueue::pushBack(Segment&& seg) {
+    if (head_ > 0 && head_ * 2 >= segments_.size()) {
+        // 已经移除的段占了一半以上时整体前移，队列一直不空时数组也不会无限增长
+        segments_.erase(segments_.begin(), segments_.begin() + head_);
+        head_ = 0;
+    }
+    segments_.push_back(std::move(seg));
+}
+
+void OutputQueue::popFront() {
+    Segment& front = segments_[head_];
+    if (front.block != nullptr) {
+        pool_->deallocate(front.block);
+    }
+    front = Segment();
+    ++head_;
+    if (head_ == segments_.size()) {
+        // 队列空了，保留容量给之后的数据
+        segments_.clear();
+        head_ = 0;
+    }
+}
+
+void OutputQueue::clear() {
+    while (!empty()) {
+        popFront();
+    }
+    bytes_ = 0;
+    fileBytes_ = 0;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "BlockPool.h"
+
+#include <sys/types.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Buffer;
+class ChainBuffer;
+
+/**
+ * TcpConnection的输出队列，由若干段(segment)组成，取代原先连续的outputBuffer_。
+ * 段有三种来源：
+ * 1) 拷贝进来的数据：追加到队尾的数据块中，块写满后新开一块，已有数据从不搬移或扩容；
+ *    数据块是BlockPool中的16KB块，发送完立即归还，大块数据进出不会反复malloc/free；
+ * 2) 接管所有权的数据(std::string&&、Buffer&&、ChainBuffer&&)和引用计数的只读切片：只保存引用，不拷贝；
+ * 3) 文件区间：保存(fd, offset, len)，发送时用sendfile，数据不经过用户空间。
+ * 发送时把队头连续的内存段组装成iovec，一次writev最多写IOV_MAX段，
+ * 所以响应头和响应体这样的多段数据可以在一次系统调用中发出。
+ * 段保存在数组中，从head_开始是待发送的段；没有数据排队过的连接不分配任何内存。
+ * 只能在所属loop线程中使用。
+ */
+class OutputQueue : noncopyable {
+public:
+    // 拷贝数据块的容量，小块数据会合并到同一个块中
+    static const size_t kBlockSize = BlockPool::kBlockSize;
+
+    // pool通常是所属loop的EventLoop::blockPool()
+    explicit OutputQueue(std::shared_ptr<BlockPool> pool = BlockPool::threadLocalPool());
+    ~OutputQueue();
+
+    // 拷贝data[len]到队尾
+    void append(const void* data, size_t len);
+    // 接管message的所有权，不拷贝
+    void append(std::string&& message);
+    void append(Buffer&& message);
+    // 直接接管message的数据块，message变为空
+    void append(ChainBuffer&& message);
+    // 引用计数的只读切片，owner保证[data, data+len)在发送完之前一直有效
+    void appendSlice(std::shared_ptr<const void> owner, const char* data, size_t len);
+    // 文件区间[offset, offset+len)，owner保证fd在发送完之前一直打开（例如在析构时关闭fd）
+    void appendFile(std::shared_ptr<const void> owner, int fd, off_t offset, size_t len);
+
+    // 待发送的字节数，包括文件段
+    size_t readableBytes() const { return bytes_; }
+    // 文件段中待发送的字节数，不占用内存
+    size_t fileBytes() const { return fileBytes_; }
+    // 内存段中待发送的字节数
+    size_t memoryBytes() const { return bytes_ - fileBytes_; }
+    bool empty() const { return head_ == segments_.size(); }
+
+    /**
+     * 把队头的数据写入sockfd，只进行一次系统调用：
+     * 队头是内存段时，用writev写出队头连续的内存段(最多IOV_MAX段)；队头是文件段时，用sendfile
+     * @param savedErrno[out] 发生错误时保存的错误号
+     * @return < 0, 发生错误; >= 0, 写出的字节数
+     */
+    ssize_t writeFd(int fd, int& savedErrno);
+
+    // 丢弃所有待发送数据
+    void clear();
+
+private:
+    struct Segment {
+        // 内存段：data[len]是剩余待发送的数据，holder持有数据的所有者
+        std::shared_ptr<const void> holder;
+        const char* data = nullptr;
+        size_t len = 0;
+        // 来自BlockPool的数据块，段移除时归还，可以继续在data+len之后追加数据；其余段为nullptr
+        char* block = nullptr;
+        // 文件段：fd >= 0，从offset开始还剩len字节，holder负责fd的生命期
+        int fd = -1;
+        off_t offset = 0;
+    };
+
+    // 从队头移除已经写出的n字节
+    void retrieve(size_t n);
+    void pushBack(Segment&& seg);
+    void popFront();
+
+    std::vector<Segment> segments_;
+    size_t head_;  // 队头的段在segments_中的下标
+    size_t bytes_;
+    size_t fileBytes_;
+    std::shared_ptr<BlockPool> pool_;
+};
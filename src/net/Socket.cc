@@ -1,13 +1,14 @@
 #include "Socket.h"
 #include "SocketsOps.h"
 #include "InetAddress.h"
+#include "Logging.h"
 
 #include <string.h>
 #include <unistd.h>
 #include <stdio.h>
-#include <iostream>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
+#include <linux/filter.h>
 #include <sys/socket.h>
 #include <sys/types.h>
 
@@ -57,10 +58,9 @@ int Socket::accept(InetAddress* peeraddr) {
     socklen_t len = sizeof(addr);
     ::memset(&addr, 0, sizeof(addr));
     int connfd = ::accept4(sockfd_, (sockaddr *)&addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    // 失败时保留errno，由调用者处理(监听socket非阻塞，取完backlog后总会以EAGAIN结束)
     if (connfd >= 0) {
         peeraddr->setSockAddr(addr);
-    } else {
-        std::cout << "accept4() failed" <<std::endl;
     }
     return connfd;
 }
@@ -79,6 +79,40 @@ void Socket::setReuseAddr(bool on) {
     ::setsockopt(sockfd_, SOL_SOCKET, SO_REUSEADDR, &optval, static_cast<socklen_t>(sizeof optval));
 }
 
+bool Socket::attachReusePortCpuSteering(int groupSize, const std::vector<int>& socketCpus) {
+#ifdef SO_ATTACH_REUSEPORT_CBPF
+    std::vector<struct sock_filter> code;
+    // A = 当前CPU编号
+    code.push_back({ BPF_LD | BPF_W | BPF_ABS, 0, 0, static_cast<__u32>(SKF_AD_OFF + SKF_AD_CPU) });
+    for (size_t i = 0; i < socketCpus.size(); ++i) {
+        // A == socketCpus[i]时执行下一条，返回i；否则跳过它
+        code.push_back({ BPF_JMP | BPF_JEQ | BPF_K, 0, 1, static_cast<__u32>(socketCpus[i]) });
+        code.push_back({ BPF_RET | BPF_K, 0, 0, static_cast<__u32>(i) });
+    }
+    // 其余CPU：A = A % groupSize，返回组内socket的下标
+    code.push_back({ BPF_ALU | BPF_MOD | BPF_K, 0, 0, static_cast<__u32>(groupSize) });
+    code.push_back({ BPF_RET | BPF_A, 0, 0, 0 });
+    if (code.size() > BPF_MAXINSNS) {
+        //log
+        LOG_WARN << "Socket::attachReusePortCpuSteering too many cpus: " << socketCpus.size();
+        return false;
+    }
+    struct sock_fprog prog;
+    prog.len = static_cast<unsigned short>(code.size());
+    prog.filter = code.data();
+    if (::setsockopt(sockfd_, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof prog) < 0) {
+        //log
+        LOG_WARN << "Socket::attachReusePortCpuSteering failed: " << errno;
+        return false;
+    }
+    return true;
+#else
+    (void)groupSize;
+    (void)socketCpus;
+    return false;
+#endif
+}
+
 void Socket::setReusePort(bool on) {
 #ifdef SO_REUSEPORT
     int optval = on ? 1 : 0;
@@ -2,6 +2,8 @@
 
 #include "noncopyable.h"
 
+#include <vector>
+
 class InetAddress;
 
 class Socket : public noncopyable {
@@ -32,6 +34,14 @@ public:
     void setReuseAddr(bool on);
 
     void setReusePort(bool on);
+    /**
+     * 给SO_REUSEPORT组挂一个CBPF程序，按处理SYN的CPU编号选择组内的监听socket，
+     * 组内socket按listen()的顺序编号。只需在组内任意一个socket上设置一次
+     * @param socketCpus 第i个socket所在线程绑定的CPU，在这个CPU上收到的SYN交给第i个socket；
+     * 不在其中的CPU(以及socketCpus为空时的所有CPU)选择第(cpu % groupSize)个socket
+     * @return 内核不支持或程序过长时返回false，此时仍按四元组哈希分配
+     */
+    bool attachReusePortCpuSteering(int groupSize, const std::vector<int>& socketCpus = std::vector<int>());
  
     void setKeepAlive(bool on);
 private:
@@ -1,4 +1,5 @@
 #include "SocketsOps.h"
+#include "Logging.h"
 
 #include <sys/socket.h>
 #include <sys/uio.h>
@@ -9,7 +10,6 @@
 #include <assert.h>
 #include <stdio.h>
 #include <fcntl.h>
-#include <iostream>
 namespace{
 
 typedef struct sockaddr SA;
@@ -93,12 +93,18 @@ int createNonblockingOrDie(sa_family_t family){
     return sockfd;
 }
 
+// 地址结构体的实际长度，不能用sizeof(addr)，那只是指针的大小
+static socklen_t addrLength(const struct sockaddr* addr){
+    return static_cast<socklen_t>(addr->sa_family == AF_INET6 ? sizeof(struct sockaddr_in6)
+                                                              : sizeof(struct sockaddr_in));
+}
+
 int connect(int sockfd,const struct sockaddr* addr){
-    return ::connect(sockfd,addr,sizeof(addr));
+    return ::connect(sockfd,addr,addrLength(addr));
 }
 
 void bindOrDie(int sockfd,const struct sockaddr* addr){
-    auto ret= ::bind(sockfd,addr,sizeof(addr));
+    auto ret= ::bind(sockfd,addr,addrLength(addr));
     if(ret<0){
         //log
     }
@@ -167,6 +173,10 @@ ssize_t write(int sockfd,const void* buf,size_t count){
     return ::write(sockfd,buf,count);
 }
 
+ssize_t writev(int sockfd,const struct iovec* iov,int iovcnt){
+    return ::writev(sockfd, iov, iovcnt);
+}
+
 void close(int sockfd){
     if(::close(sockfd)<0){
         //log
@@ -247,7 +257,7 @@ struct sockaddr_in6 getLocalAddr(int sockfd){
     socklen_t addrlen=static_cast<socklen_t>(sizeof(localaddr));
     if(::getsockname(sockfd,sockaddr_cast(&localaddr),&addrlen)<0){
         //log
-        std::cout << "sockets::getLocalAddr() failed" << std::endl;
+        LOG_ERROR << "sockets::getLocalAddr() failed";
     }
     return localaddr;
 }
@@ -0,0 +1,109 @@
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "SocketsOps.h"
+#include "Logging.h"
+
+#include <functional>
+#include <stdio.h>
+
+namespace {
+
+// TcpClient先于连接销毁时，连接关闭后只需要在它的loop中销毁
+void removeConnection(EventLoop* loop, const TcpConnectionPtr& conn) {
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+} // namespace
+
+TcpClient::TcpClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg)
+    : loop_(loop),
+      connector_(new Connector(loop, serverAddr)),
+      name_(nameArg),
+      connNamePrefix_(std::make_shared<const std::string>(nameArg + ":" + serverAddr.toIpPort())),
+      connectionCallback_([](const TcpConnectionPtr&) {}),
+      messageCallback_([](const TcpConnectionPtr&, Buffer* buf, Timestamp) { buf->retrieveAll(); }),
+      retry_(false),
+      connect_(true),
+      nextConnId_(1) {
+    connector_->setNewConnectionCallback(std::bind(&TcpClient::newConnection, this, _1));
+    //log
+    LOG_DEBUG << "TcpClient::TcpClient[" << name_ << "] - connector " << connector_.get();
+}
+
+TcpClient::~TcpClient() {
+    //log
+    LOG_DEBUG << "TcpClient::~TcpClient[" << name_ << "] - connector " << connector_.get();
+    TcpConnectionPtr conn;
+    bool unique = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unique = connection_.use_count() == 1;
+        conn = connection_;
+    }
+    if (conn) {
+        // 连接可能比TcpClient活得久，关闭时不能再回调this
+        EventLoop* loop = loop_;
+        loop_->runInLoop([conn, loop]() {
+            conn->setCloseCallback(std::bind(&::removeConnection, loop, _1));
+        });
+        if (unique) {
+            conn->forceClose();
+        }
+    } else {
+        // 排队的stopInLoop()持有Connector的强引用，定时器只持有弱引用
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect() {
+    //log
+    LOG_INFO << "TcpClient::connect[" << name_ << "] - connecting to "
+             << connector_->serverAddress().toIpPort();
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect() {
+    connect_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connection_) {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop() {
+    connect_ = false;
+    connector_->stop();
+}
+
+void TcpClient::newConnection(int sockfd) {
+    struct sockaddr_in6 peer = sockets::getPeerAddr(sockfd);
+    struct sockaddr_in6 local = sockets::getLocalAddr(sockfd);
+    InetAddress peerAddr(*sockets::sockaddr_in_cast(sockets::sockaddr_cast(&peer)));
+    InetAddress localAddr(*sockets::sockaddr_in_cast(sockets::sockaddr_cast(&local)));
+    TcpConnectionPtr conn(TcpConnection::create(loop_, connNamePrefix_, nextConnId_, sockfd, localAddr, peerAddr));
+    ++nextConnId_;
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCloseCallback([this](const TcpConnectionPtr& c) { removeConnection(c); });
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr& conn) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_.reset();
+    }
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    if (retry_ && connect_) {
+        //log
+        LOG_INFO << "TcpClient::removeConnection[" << name_ << "] - Reconnecting to "
+                 << connector_->serverAddress().toIpPort();
+        connector_->restart();
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "Connector.h"
+#include "TcpConnection.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class EventLoop;
+
+/**
+ * Tcp客户端，最多持有一个连接，与TcpServer相对。
+ * 用Connector发起非阻塞连接(带超时和指数退避重试)，连上之后与服务端一样用TcpConnection收发数据。
+ * 打开retry之后，连接断开会自动重新连接。
+ */
+class TcpClient : noncopyable {
+public:
+    TcpClient(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg);
+    ~TcpClient();
+
+    // 开始连接，可以在任意线程调用
+    void connect();
+    // 关闭已建立的连接(等待待发送数据写完)
+    void disconnect();
+    // 停止正在进行的连接和重试
+    void stop();
+
+    TcpConnectionPtr connection() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    bool retry() const { return retry_; }
+    // 连接断开后自动重连
+    void enableRetry() { retry_ = true; }
+    const std::string& name() const { return name_; }
+
+    // 连接超时、重试间隔和次数，含义见Connector，在connect()之前调用
+    void setConnectTimeout(double seconds) { connector_->setConnectTimeout(seconds); }
+    void setRetryDelay(int initMs, int maxMs) { connector_->setRetryDelay(initMs, maxMs); }
+    void setMaxRetries(int n) { connector_->setMaxRetries(n); }
+
+    // 以下回调都不是线程安全的，在connect()之前设置
+    void setConnectionCallback(ConnectionCallback cb) { connectionCallback_ = std::move(cb); }
+    void setMessageCallback(MessageCallback cb) { messageCallback_ = std::move(cb); }
+    void setWriteCompleteCallback(WriteCompleteCallback cb) { writeCompleteCallback_ = std::move(cb); }
+    // 重试次数用完仍没有连上
+    void setConnectFailedCallback(Connector::ConnectFailedCallback cb) { connector_->setConnectFailedCallback(std::move(cb)); }
+
+private:
+    // 只在loop线程中调用
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr& conn);
+
+    EventLoop* loop_;
+    std::shared_ptr<Connector> connector_;
+    const std::string name_;
+    // 连接名称的前缀"name:ip:port"，所有连接共用
+    const std::shared_ptr<const std::string> connNamePrefix_;
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    bool retry_;
+    std::atomic_bool connect_;  // connect()/stop()/disconnect()可在任意线程调用，loop线程在removeConnection()中读取
+    int64_t nextConnId_;
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_;  // 由mutex_保护
+};
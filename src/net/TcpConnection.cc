@@ -3,8 +3,10 @@
 #include "Channel.h"
 #include "Timestamp.h"
 #include "EventLoop.h"
+#include "ConnectionReaper.h"
+#include "Logging.h"
 
-#include <iostream>
+#include <algorithm>
 #include <functional>
 #include <string>
 #include <errno.h>
@@ -12,138 +14,427 @@
 #include <sys/socket.h>
 #include <string.h>
 #include <netinet/tcp.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 using namespace std::placeholders;
 
+const size_t TcpConnection::kDefaultIoBudget;
+
 TcpConnection::TcpConnection(EventLoop* loop,
-                            const std::string& name,
+                            std::shared_ptr<const std::string> namePrefix,
+                            int64_t id,
                             int sockfd,
                             const InetAddress& localAddr,
                             const InetAddress& peerAddr)
     : loop_(loop),
-      name_(name),
+      connectionCounter_(loop->connectionCounter()),
+      namePrefix_(std::move(namePrefix)),
+      id_(id),
       state_(kConnecting),
-      socket_(new Socket(sockfd)),
-      channel_(new Channel(loop, sockfd)),
+      socket_(sockfd),
+      channel_(loop, sockfd),
       localAddr_(localAddr),
       peerAddr_(peerAddr),
-      highWaterMark_(64 * 1024 * 1024)
+      highWaterMark_(64 * 1024 * 1024),
+      inputBuffer_(0),
+      outputQueue_(loop->blockPool())
 {
     // 下面给channel设置相应的回调函数 poller给channel通知感兴趣的事件发生了 channel会回调相应的回调函数
-    channel_->setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
-    channel_->setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
-    channel_->setCloseCallback(std::bind(&TcpConnection::handleClose, this));
-    channel_->setErrorCallback(std::bind(&TcpConnection::handleError, this));
+    channel_.setReadCallback(std::bind(&TcpConnection::handleRead, this, std::placeholders::_1));
+    channel_.setWriteCallback(std::bind(&TcpConnection::handleWrite, this));
+    channel_.setCloseCallback(std::bind(&TcpConnection::handleClose, this));
+    channel_.setErrorCallback(std::bind(&TcpConnection::handleError, this));
     //log
-    std::cout << "TcpConnection::ctor[" << name_.c_str() << "] at fd =" << sockfd <<std::endl;
-    socket_->setKeepAlive(true);
+    LOG_DEBUG << "TcpConnection::ctor[" << *namePrefix_ << "#" << id_ << "] at fd =" << sockfd;
+    socket_.setKeepAlive(true);
+    // 构造时就计数，EventLoopThreadPool按连接数分配时能看到已分配但还没建立的连接
+    connectionCounter_->fetch_add(1, std::memory_order_relaxed);
+}
+
+TcpConnectionPtr TcpConnection::create(EventLoop* loop,
+                                       std::shared_ptr<const std::string> namePrefix,
+                                       int64_t id,
+                                       int sockfd,
+                                       const InetAddress& localAddr,
+                                       const InetAddress& peerAddr) {
+    return std::allocate_shared<TcpConnection>(SlabAllocator<TcpConnection>(loop->connectionSlab()),
+                                               loop, std::move(namePrefix), id, sockfd, localAddr, peerAddr);
+}
+
+const std::string& TcpConnection::name() const {
+    std::call_once(nameOnce_, [this]() {
+        char buf[32];
+        snprintf(buf, sizeof buf, "#%lld", static_cast<long long>(id_));
+        name_.reserve(namePrefix_->size() + strlen(buf));
+        name_.append(*namePrefix_).append(buf);
+    });
+    return name_;
+}
+
+const InetAddress& TcpConnection::localAddress() const {
+    std::call_once(localAddrOnce_, [this]() {
+        const sockaddr_in* addr = localAddr_.getSockAddr();
+        if (addr->sin_addr.s_addr != htonl(INADDR_ANY) && addr->sin_port != 0) {
+            return;
+        }
+        sockaddr_in local;
+        ::memset(&local, 0, sizeof(local));
+        socklen_t addrlen = sizeof(local);
+        if (::getsockname(socket_.fd(), (sockaddr *)&local, &addrlen) < 0) {
+            LOG_ERROR << "TcpConnection::localAddress - getsockname() failed";
+        } else {
+            localAddr_.setSockAddr(local);
+        }
+    });
+    return localAddr_;
 }
 
 TcpConnection::~TcpConnection(){
     //log
-    std::cout << "TcpConnection::dtor[" << name_ << "] at fd=" << channel_->fd() << " state=" << static_cast<int>(state_) << std::endl;
+    LOG_DEBUG << "TcpConnection::dtor[" << *namePrefix_ << "#" << id_ << "] at fd=" << channel_.fd() << " state=" << static_cast<int>(state_);
     assert(state_ == kDisconnected);
+    // 最后一个TcpConnectionPtr可能在任意线程、在loop销毁之后释放，不能访问loop_
+    connectionCounter_->fetch_sub(1, std::memory_order_relaxed);
 }
 
-//发送数据，转发给send(const StringPiece&), 最终转交给sendInLoop(const char*, int)
+// 在loop线程直接发送，否则拷贝一份交给loop线程
 void TcpConnection::send(const void *message, int len){
-    send(std::string(static_cast<const char*>(message), len));
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendInLoop(message, len);
+        } else {
+            send(std::string(static_cast<const char*>(message), len));
+        }
+    }
 }
 
 /**
-* 转交给 sendInLoop(const char*, int)
 * 发送消息给对端, 允许在其他线程调用
 * @param message 要发送的消息. 
+* @note 其他线程调用时，调用者返回后message就可能被销毁，
+* 所以不能把message.c_str()交给loop线程，只能拷贝一份再转交给send(std::string&&)
 */
 void TcpConnection::send(const std::string& message) {
     if (state_ == kConnected) {
         if (loop_->isInLoopThread()) {
-            // 当前线程是所属loop线程
-            sendInLoop(message.c_str(), message.size());
+            sendInLoop(message.data(), message.size());
+        } else {
+            send(std::string(message));
+        }
+    }
+}
+
+/**
+* 接管message的所有权后发送, 允许在其他线程调用
+* @details 其他线程调用时，message被移动进任务中，由loop线程直接从这块存储写入socket
+*/
+void TcpConnection::send(std::string&& message) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendInLoop(std::move(message));
         } else {
-            // 当前线程并非所属loop线程，遇到重载函数的绑定，可以使用函数指针来指定确切的函数
-            void(TcpConnection::*fp)(const void*, size_t) = &TcpConnection::sendInLoop;
-            loop_->runInLoop(std::bind(fp, this, message.c_str(), message.size()));
+            loop_->queueInLoop([self = shared_from_this(), msg = std::move(message)]() mutable {
+                self->sendInLoop(std::move(msg));
+            });
         }
     }
 }
 
-// 转交给sendInLoop(const char*, int)
+/**
+* 把head和body作为一个整体发送, 允许在其他线程调用
+* @details 两段数据用一次writev写出, 例如HTTP响应头和响应体, 不需要先拼接到一起
+*/
+void TcpConnection::send(std::string&& head, std::string&& body) {
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendInLoop(std::move(head), std::move(body));
+        } else {
+            // 两个string放不进任务的内部缓冲区，合在一起放到堆上
+            auto parts = std::make_unique<std::pair<std::string, std::string>>(std::move(head), std::move(body));
+            loop_->queueInLoop([self = shared_from_this(), parts = std::move(parts)]() {
+                self->sendInLoop(std::move(parts->first), std::move(parts->second));
+            });
+        }
+    }
+}
+
+/**
+* 发送文件区间, 允许在其他线程调用
+* @param fd 已打开的文件, 函数内部dup一份, 调用者随后可以关闭fd
+* @param offset 文件中的起始位置
+* @param length 要发送的字节数
+*/
+void TcpConnection::sendFile(int fd, off_t offset, size_t length) {
+    if (state_ != kConnected || length == 0) {
+        return;
+    }
+    int ownFd = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+    if (ownFd < 0) {
+        LOG_ERROR << "TcpConnection::sendFile dup() failed: " << errno;
+        return;
+    }
+    // 输出队列中的文件段引用这个holder，段被发送完或丢弃时关闭fd
+    std::shared_ptr<const void> fileHolder(static_cast<const void*>(nullptr),
+                                           [ownFd](const void*) { ::close(ownFd); });
+    if (loop_->isInLoopThread()) {
+        sendFileInLoop(std::move(fileHolder), ownFd, offset, length);
+    } else {
+        loop_->queueInLoop([self = shared_from_this(), fileHolder = std::move(fileHolder), ownFd, offset, length]() mutable {
+            self->sendFileInLoop(std::move(fileHolder), ownFd, offset, length);
+        });
+    }
+}
+
+// 发送buf中所有可读数据，并清空buf
 void TcpConnection::send(Buffer* buf) {
     if (state_ == kConnected) {
         if (loop_->isInLoopThread()) {
             sendInLoop(buf->peek(), buf->readableBytes());
             buf->retrieveAll();
+        } else {
+            // 交换出buf的内部存储，buf变为空，与retrieveAll()的效果一致
+            Buffer message(0);
+            message.swap(*buf);
+            send(std::move(message));
         }
-    } else {
-        // sendInLoop有多重重载，需要使用函数指针确定
-        void(TcpConnection::*fp)(const std::string&) = &TcpConnection::sendInLoop;
-        //为了在所属的loop线程中执行buf的retrieve，只能执行buf->retriAllAsString()，然后把返回string传给转交的sendInLoop
-        loop_->runInLoop(std::bind(fp, this, buf->retrieveAllAsString()));
     }
 }
 
-// 转交给sendInLoop(const void*, int)
-void TcpConnection::sendInLoop(const std::string& message) {
-    sendInLoop(message.data(),message.size());
+/**
+* 接管buf的所有权后发送, 允许在其他线程调用
+* @details buf的内部存储被移动走，不拷贝数据；无论是否立即写完，返回后buf都为空
+*/
+void TcpConnection::send(Buffer&& buf) {
+    Buffer message(std::move(buf));
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendInLoop(std::move(message));
+        } else {
+            loop_->queueInLoop([self = shared_from_this(), message = std::move(message)]() mutable {
+                self->sendInLoop(std::move(message));
+            });
+        }
+    }
+}
+
+/**
+* 接管buf的数据块后发送, 允许在其他线程调用
+* @details 其他线程调用时，ChainBuffer放不进任务的内部缓冲区，移动到堆上交给loop线程；
+* 无论是否立即写完，返回后buf都为空，立即写完的数据块在这里归还
+*/
+void TcpConnection::send(ChainBuffer&& buf) {
+    ChainBuffer message(std::move(buf));
+    if (state_ == kConnected) {
+        if (loop_->isInLoopThread()) {
+            sendInLoop(std::move(message));
+        } else {
+            auto buf = std::make_unique<ChainBuffer>(std::move(message));
+            loop_->queueInLoop([self = shared_from_this(), buf = std::move(buf)]() {
+                self->sendInLoop(std::move(*buf));
+            });
+        }
+    }
 }
 
 /**
  * 在所属loop线程中, 发送data[len]
  * @param data 要发送的缓冲区首地址
  * @param len　要发送的缓冲区大小(bytes)
- * @details 发生write错误, 如果发送缓冲区未满,　对端已发FIN/RST分节 表明tcp连接发生致命错误(faultError为true)
+ * @details 数据属于调用者，未写完的部分只能拷贝进outputQueue_
  */
 void TcpConnection::sendInLoop(const void* data, size_t len) {
-    ssize_t nwrote = 0;
-    size_t remaining = len;
-    bool faultError = false;
-    // 如果之前调用过connection的shutdown，写连接已经关闭，则不能再进行发送了
+    struct iovec vec;
+    vec.iov_base = const_cast<void*>(data);
+    vec.iov_len = len;
+    size_t nwrote = 0;
+    if (writeDirectInLoop(&vec, 1, len, nwrote) && nwrote < len) {
+        size_t oldLen = outputQueue_.memoryBytes();
+        outputQueue_.append(static_cast<const char*>(data) + nwrote, len - nwrote);
+        queuedOutputInLoop(oldLen);
+    }
+}
+
+// 数据的所有权已经转交给连接，未写完的部分作为切片入队，不拷贝
+void TcpConnection::sendInLoop(std::string&& message) {
+    struct iovec vec;
+    vec.iov_base = const_cast<char*>(message.data());
+    vec.iov_len = message.size();
+    size_t nwrote = 0;
+    if (writeDirectInLoop(&vec, 1, message.size(), nwrote) && nwrote < message.size()) {
+        size_t oldLen = outputQueue_.memoryBytes();
+        // 移动之后短字符串的地址会改变，所以要从holder中重新取地址
+        auto holder = std::make_shared<std::string>(std::move(message));
+        outputQueue_.appendSlice(holder, holder->data() + nwrote, holder->size() - nwrote);
+        queuedOutputInLoop(oldLen);
+    }
+}
+
+void TcpConnection::sendInLoop(Buffer&& message) {
+    struct iovec vec;
+    vec.iov_base = const_cast<char*>(message.peek());
+    vec.iov_len = message.readableBytes();
+    size_t nwrote = 0;
+    if (writeDirectInLoop(&vec, 1, message.readableBytes(), nwrote) && nwrote < message.readableBytes()) {
+        size_t oldLen = outputQueue_.memoryBytes();
+        message.retrieve(nwrote);
+        outputQueue_.append(std::move(message));
+        queuedOutputInLoop(oldLen);
+    }
+}
+
+// 各个块用一次writev写出，未写完的块直接移入outputQueue_
+void TcpConnection::sendInLoop(ChainBuffer&& message) {
+    struct iovec vec[IOV_MAX];
+    int iovcnt = message.readableIovec(vec, IOV_MAX);
+    size_t nwrote = 0;
+    // 块数超过IOV_MAX时一次写不完，writeCompleteCallback_按全部数据判断
+    if (writeDirectInLoop(vec, iovcnt, message.readableBytes(), nwrote) && nwrote < message.readableBytes()) {
+        size_t oldLen = outputQueue_.memoryBytes();
+        message.retrieve(nwrote);
+        outputQueue_.append(std::move(message));
+        queuedOutputInLoop(oldLen);
+    }
+}
+
+// head和body用一次writev写出，未写完的部分同样不拷贝
+void TcpConnection::sendInLoop(std::string&& head, std::string&& body) {
+    struct iovec vec[2];
+    vec[0].iov_base = const_cast<char*>(head.data());
+    vec[0].iov_len = head.size();
+    vec[1].iov_base = const_cast<char*>(body.data());
+    vec[1].iov_len = body.size();
+    const size_t total = head.size() + body.size();
+    size_t nwrote = 0;
+    if (writeDirectInLoop(vec, 2, total, nwrote) && nwrote < total) {
+        size_t oldLen = outputQueue_.memoryBytes();
+        if (nwrote < head.size()) {
+            auto holder = std::make_shared<std::string>(std::move(head));
+            outputQueue_.appendSlice(holder, holder->data() + nwrote, holder->size() - nwrote);
+            outputQueue_.append(std::move(body));
+        } else {
+            nwrote -= head.size();
+            auto holder = std::make_shared<std::string>(std::move(body));
+            outputQueue_.appendSlice(holder, holder->data() + nwrote, holder->size() - nwrote);
+        }
+        queuedOutputInLoop(oldLen);
+    }
+}
+
+/**
+ * 文件区间作为一个段加入outputQueue_，没有在等待可写事件时立即sendfile一次，
+ * 之后由handleWrite在每次可写时继续sendfile，内存占用与文件大小无关
+ */
+void TcpConnection::sendFileInLoop(std::shared_ptr<const void> fileHolder, int fd, off_t offset, size_t length) {
     if (state_ == kDisconnected) {
-        std::cout << "disconnected, give up writing" <<std::endl;
+        LOG_WARN << "disconnected, give up sending file";
         return;
     }
-    // write一次, 往对端发送数据, 后面再看是否发生错误, 是否需要高水位回调
-    if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0) {
-        // 如果通道没有监听可写事件, 并且outputBuffer没有待发送数据, 就直接通过socket写
-        nwrote = sockets::write(channel_->fd(), data, len);
-        if (nwrote >= 0) {
-            remaining -= nwrote;
-            if (remaining == 0 && writeCompleteCallback_) {
-                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    size_t oldLen = outputQueue_.memoryBytes();
+    outputQueue_.appendFile(std::move(fileHolder), fd, offset, length);
+    if (!channel_.isWriting()) {
+        // 没有在监听可写事件，说明在这之前队列是空的，文件段就在队头
+        int savedErrno = 0;
+        ssize_t n = outputQueue_.writeFd(channel_.fd(), savedErrno);
+        if (n < 0 && savedErrno != EWOULDBLOCK) {
+            LOG_ERROR << "TcpConnection::sendFileInLoop";
+            if (savedErrno == EPIPE || savedErrno == ECONNRESET) {
+                outputQueue_.clear();
+                return;
             }
-        } else {
-            //< 0,error
-            nwrote = 0;
-            if (errno != EWOULDBLOCK) {
-                // EWOULDBLOCK: 输出缓冲区已满, 且fd已设为nonblocking，那么把剩下的数据发送到应用层的输出缓冲区
-                std::cout << "TcpConnection::sendInLoop" <<std::endl;
-                if (errno == EPIPE || errno == ECONNRESET) {
-                    // EPIPE: 读端已经关闭; ECONNRESET: 对方重置了连接
-                    faultError = true; 
-                }
+        }
+        if (outputQueue_.empty()) {
+            if (writeCompleteCallback_) {
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
             }
-        } 
+            return;
+        }
     }
-    // 处理剩余数据,剩余数据需要保存到输出缓冲区中，且需要改channel注册写事件
-    if (!faultError && remaining > 0) {
-        // 没有故障, 并且还有待发送数据, 可能是发送太快, 对方来不及接收
-        size_t oldLen = outputBuffer_.readableBytes(); //Buffer中待发送的数据
+    queuedOutputInLoop(oldLen);
+}
 
-        if (oldLen + remaining >= highWaterMark_  &&  oldLen < highWaterMark_  && highWaterMarkCallback_) {
-            // Buffer及当前要发送的数据量之和超过高水位(highWaterMark)
-            loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), oldLen + remaining));
+/**
+ * 如果通道没有监听可写事件, 并且outputQueue_没有待发送数据, 就直接通过socket写一次
+ * @param nwrote[out] 直接写出的字节数
+ * @return false表示不能再继续发送：连接已断开，或者对端已发FIN/RST分节，tcp连接发生致命错误
+ */
+bool TcpConnection::writeDirectInLoop(const struct iovec* vec, int iovcnt, size_t total, size_t& nwrote) {
+    nwrote = 0;
+    // 如果之前调用过connection的shutdown，写连接已经关闭，则不能再进行发送了
+    if (state_ == kDisconnected) {
+        LOG_WARN << "disconnected, give up writing";
+        return false;
+    }
+    if (!channel_.isWriting() && outputQueue_.empty()) {
+        ssize_t n = sockets::writev(channel_.fd(), vec, iovcnt);
+        if (n >= 0) {
+            nwrote = n;
+            if (nwrote == total && writeCompleteCallback_) {
+                loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+            }
+        } else if (errno != EWOULDBLOCK) {
+            // EWOULDBLOCK: 输出缓冲区已满, 且fd已设为nonblocking，那么把剩下的数据放到应用层的输出队列
+            LOG_ERROR << "TcpConnection::sendInLoop";
+            if (errno == EPIPE || errno == ECONNRESET) {
+                // EPIPE: 读端已经关闭; ECONNRESET: 对方重置了连接
+                return false;
+            }
         }
-        // 追加数据到输出缓冲区
-        outputBuffer_.append(static_cast<const char*>(data)+nwrote, remaining);
-        // 使当前套接字的channel监听可写事件
-        if (!channel_->isWriting()) {
-            // 如果没有在监听通道可写事件, 就使监听通道可写事件，等待通知
-            channel_->enableWriting();
+    }
+    return true;
+}
+
+/**
+ * 剩余数据追加到outputQueue_之后调用：检查是否越过高水位，并使channel监听可写事件
+ * @param oldLen 追加之前outputQueue_中待发送的内存数据量
+ * @details 高水位只按内存中的数据计算：文件段不占用内存，大文件不应该让背压逻辑停住
+ */
+void TcpConnection::queuedOutputInLoop(size_t oldLen) {
+    size_t newLen = outputQueue_.memoryBytes();
+    if (newLen >= highWaterMark_ && oldLen < highWaterMark_ && highWaterMarkCallback_) {
+        // 待发送的数据量越过高水位(highWaterMark)
+        loop_->queueInLoop(std::bind(highWaterMarkCallback_, shared_from_this(), newLen));
+    }
+    if (!channel_.isWriting()) {
+        // 如果没有在监听通道可写事件, 就使监听通道可写事件，等待通知
+        // 写空闲从开始等待可写算起
+        lastWriteTime_ = loop_->pollReturnTime();
+        channel_.enableWriting();
+        if (edgeTriggered_) {
+            // 直接写的那一次不一定写到了EAGAIN(例如writev受IOV_MAX限制)，此时不会再有可写的边缘通知，
+            // 所以主动接着写一次，直到EAGAIN或写完
+            resumeWriteInLoop();
         }
     }
 }
 
+void TcpConnection::resumeReadInLoop() {
+    if (!readResumeQueued_) {
+        readResumeQueued_ = true;
+        loop_->queueInLoop([self = shared_from_this()]() {
+            self->readResumeQueued_ = false;
+            if (self->channel_.isReading()) {
+                self->handleRead(Timestamp::now());
+            }
+        });
+    }
+}
+
+void TcpConnection::resumeWriteInLoop() {
+    if (!writeResumeQueued_) {
+        writeResumeQueued_ = true;
+        loop_->queueInLoop([self = shared_from_this()]() {
+            self->writeResumeQueued_ = false;
+            if (self->channel_.isWriting()) {
+                self->handleWrite();
+            }
+        });
+    }
+}
+
 // 关闭单向写连接，转交函数
 void TcpConnection::shutdown() {
     // 原子化？
@@ -156,8 +447,23 @@ void TcpConnection::shutdown() {
 // 执行实际工作
 void TcpConnection::shutdownInLoop() {
     //有待写数据的时候，会注册可写事件；因此，若没有注册可写事件，说明我们当前没有待写数据，可以关闭写连接
-    if (!channel_->isWriting()) {
-        socket_->shutdownWrite();
+    if (!channel_.isWriting()) {
+        socket_.shutdownWrite();
+    }
+}
+
+// 强制关闭连接，丢弃待发送的数据
+void TcpConnection::forceClose() {
+    if (state_ == kConnected || state_ == kDisconnecting) {
+        setState(kDisconnecting);
+        loop_->runInLoop(std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop() {
+    if (state_ == kConnected || state_ == kDisconnecting) {
+        // 与收到对端FIN一样处理
+        handleClose();
     }
 }
 
@@ -166,14 +472,19 @@ void TcpConnection::connectEstablished() {
     setState(kConnected);
     /**
      * TODO:tie
-     * channel_->tie(shared_from_this());
+     * channel_.tie(shared_from_this());
      * tie相当于在底层有一个强引用指针记录着，防止析构
      * 为了防止TcpConnection这个资源被误删掉，而这个时候还有许多事件要处理
      * channel->tie 会进行一次判断，是否将弱引用指针变成强引用，变成得话就防止了计数为0而被析构得可能
      */
-    channel_->tie(shared_from_this());
+    channel_.tie(shared_from_this());
+    channel_.setEdgeTriggered(edgeTriggered_);
     // 向poller注册channel的EPOLLIN读事件
-    channel_->enableReading();
+    channel_.enableReading();
+    lastReadTime_ = lastWriteTime_ = Timestamp::now();
+    if (reaper_) {
+        reaper_->add(this);
+    }
     // 新连接建立 执行回调
     connectionCallback_(shared_from_this());
 }
@@ -190,10 +501,14 @@ void TcpConnection::connectEstablished() {
 void TcpConnection::connectDestroyed() {
     if (state_ == kConnected) {  // 只有kConnected的连接, 才有必要采取断开连接动作
         setState(kDisconnected);
-        channel_->disableAll();  // 关闭通道事件监听
+        channel_.disableAll();  // 关闭通道事件监听
         connectionCallback_(shared_from_this());  // 调用连接回调
     }
-    channel_->remove();
+    channel_.remove();
+    if (reaper_) {
+        reaper_->remove(this);
+        reaper_ = nullptr;
+    }
 }
 
 /**
@@ -202,47 +517,88 @@ void TcpConnection::connectDestroyed() {
 * @details 通常是TcpServer/TcpClient运行回调messageCallback_, 将处理机会传递给用户
 */
 void TcpConnection::handleRead(Timestamp receiveTime) {
-    int savedErrno = 0;
-    ssize_t n = inputBuffer_.readFd(socket_->fd(), savedErrno);
-    if (n > 0) {
-        messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
-    } else if(n == 0) {
-        //只有读到了EOF才会返回0，读到了EOF说明对方关闭连接
-        handleClose();
-    } else {
-        errno = savedErrno;
-        //log
-        std::cout << "TcpConnection::handleRead() failed" <<std::endl;
-        handleError();
+    // 水平触发时每次事件只读一次；边缘触发时一直读到EAGAIN，或者用完ioBudget_
+    size_t budget = ioBudget_;
+    do {
+        int savedErrno = 0;
+        ssize_t n = inputBuffer_.readFd(socket_.fd(), savedErrno);
+        if (n > 0) {
+            lastReadTime_ = receiveTime;
+            messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
+            // 数据处理完且之前的突发已经过去时归还内存，空闲连接只占一个空的Buffer
+            inputBuffer_.shrinkIfIdle();
+            budget -= std::min(budget, static_cast<size_t>(n));
+        } else if(n == 0) {
+            //只有读到了EOF才会返回0，读到了EOF说明对方关闭连接
+            handleClose();
+            return;
+        } else {
+            if (edgeTriggered_ && savedErrno == EAGAIN) {
+                // 已经读空，等待下一次边缘通知
+                return;
+            }
+            errno = savedErrno;
+            //log
+            LOG_ERROR << "TcpConnection::handleRead() failed";
+            handleError();
+            return;
+        }
+    } while (edgeTriggered_ && budget > 0 && channel_.isReading());
+
+    if (edgeTriggered_ && channel_.isReading()) {
+        // 预算用完了但socket中可能还有数据，不会再有边缘通知，排到本轮loop末尾继续读
+        resumeReadInLoop();
     }
 }
 
 void TcpConnection::handleWrite() {
-    if (channel_->isWriting()) {
-        int saveErrno = 0;
-        ssize_t n = sockets::write(channel_->fd(), outputBuffer_.peek(), outputBuffer_.readableBytes());
-        if (n > 0) {
-            outputBuffer_.retrieve(n);
-            if (outputBuffer_.readableBytes() == 0) {
-                // 说明buffer可读数据都被TcpConnection读取完毕并写入给了客户端,没东西可写，暂时停止监听可写事件
-                channel_->disableWriting();
-                // 调用用户自定义的写完数据处理函数
-                if ( writeCompleteCallback_) {
-                    loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+    if (channel_.isWriting()) {
+        // 水平触发时每次事件只写一次；边缘触发时一直写到EAGAIN，或者用完ioBudget_
+        size_t budget = ioBudget_;
+        for (;;) {
+            int savedErrno = 0;
+            // 一次writev写出队头的多个段，或者一次sendfile写出队头的文件段
+            ssize_t n = outputQueue_.writeFd(channel_.fd(), savedErrno);
+            if (n >= 0) {
+                if (n > 0) {
+                    lastWriteTime_ = loop_->pollReturnTime();
+                }
+                if (outputQueue_.empty()) {
+                    // 说明队列中的数据都已写给了客户端,没东西可写，暂时停止监听可写事件
+                    channel_.disableWriting();
+                    // 调用用户自定义的写完数据处理函数
+                    if ( writeCompleteCallback_) {
+                        loop_->queueInLoop(std::bind(writeCompleteCallback_, shared_from_this()));
+                    }
+                    //如果连接已经处于正在关闭状态，则可以关闭单向写连接
+                    if (state_ == kDisconnecting) {
+                        shutdownInLoop();
+                    }
+                    return;
                 }
-                //如果连接已经处于正在关闭状态，则可以关闭单向写连接
-                if (state_ == kDisconnecting) {
-                    shutdownInLoop();
+                if (!edgeTriggered_) {
+                    return;
                 }
+                budget -= std::min(budget, static_cast<size_t>(n));
+                if (budget == 0) {
+                    resumeWriteInLoop();
+                    return;
+                }
+            } else {
+                if (edgeTriggered_ && savedErrno == EAGAIN) {
+                    // socket发送缓冲区已满，等待下一次可写的边缘通知
+                    return;
+                }
+                //写失败
+                //log
+                errno = savedErrno;
+                LOG_ERROR << "TcpConnection::handleWrite() failed";
+                return;
             }
-        } else {
-            //写失败
-            //log
-            std::cout << "TcpConnection::handleWrite() failed" <<std::endl;
         }
     } else {
         // state_不为写状态
-        std::cout << "TcpConnection fd=" << channel_->fd() << " is down, no more writing" <<std::endl;
+        LOG_DEBUG << "TcpConnection fd=" << channel_.fd() << " is down, no more writing";
     }
 }
 
@@ -253,7 +609,7 @@ void TcpConnection::handleWrite() {
  */
 void TcpConnection::handleClose(){
     setState(kDisconnected);  // 更新Tcp连接状态，设置为关闭连接状态
-    channel_->disableAll();   // 停止监听所有通道事件
+    channel_.disableAll();   // 停止监听所有通道事件
 
     TcpConnectionPtr guardTHis(shared_from_this());
     connectionCallback_(guardTHis);  // 连接回调
@@ -270,15 +626,15 @@ void TcpConnection::handleClose(){
  * @details 从tcp协议栈获取错误信息
  */
 void TcpConnection::handleError(){
-    int err = sockets::getSocketError(channel_->fd());
+    int err = sockets::getSocketError(channel_.fd());
     //log
-    std::cout << "cpConnection::handleError name:" << name_ << " - SO_ERROR:" << err <<std::endl;
+    LOG_ERROR << "cpConnection::handleError name:" << name() << " - SO_ERROR:" << err;
 }
 
 // 获取string形式的Tcp连接信息
 std::string TcpConnection::getTcpInfoString() const{
     char  buf[1024];
     buf[0] = '\0';
-    socket_->getTcpInfoString(buf, sizeof buf);
+    socket_.getTcpInfoString(buf, sizeof buf);
     return buf;
 }
\ No newline at end of file
@@ -3,16 +3,21 @@
 #include "noncopyable.h"
 #include "Callbacks.h"
 #include "Buffer.h"
+#include "OutputQueue.h"
+#include "ChainBuffer.h"
 #include "Timestamp.h"
 #include "InetAddress.h"
 #include "Socket.h"
+#include "Channel.h"
 
+#include <any>
 #include <memory>
 #include <string>
 #include <atomic>
+#include <mutex>
 
-class Channel;
 class EventLoop;
+class ConnectionReaper;
 
 /**
  * Tcp连接, 为服务器和客户端使用.
@@ -24,16 +29,34 @@ class EventLoop;
 class TcpConnection : public noncopyable,
                     public std::enable_shared_from_this<TcpConnection> {
 public:
+    /**
+     * @param namePrefix 连接名称的前缀，同一个TcpServer/TcpClient的连接共用一份
+     * @param id 连接编号，在namePrefix下唯一
+     */
     TcpConnection(EventLoop* loop,
-                    const std::string& name,
+                    std::shared_ptr<const std::string> namePrefix,
+                    int64_t id,
                     int sockfd,
                     const InetAddress& localAddr,
                     const InetAddress& peerAddr);
     ~TcpConnection();
+    /**
+     * 在loop线程中创建连接，对象和shared_ptr的控制块一起从loop的ConnectionSlab分配，
+     * 频繁建立和断开连接时不再每次都向malloc申请
+     */
+    static TcpConnectionPtr create(EventLoop* loop,
+                                   std::shared_ptr<const std::string> namePrefix,
+                                   int64_t id,
+                                   int sockfd,
+                                   const InetAddress& localAddr,
+                                   const InetAddress& peerAddr);
     //获得其所属的subloop
     EventLoop* getLoop() const {  return loop_; }
-    const std::string& name() const { return name_; }
-    const InetAddress& localAddress() const { return localAddr_; }
+    int64_t id() const { return id_; }
+    // "前缀#id"，第一次调用时才格式化
+    const std::string& name() const;
+    // 构造时给的是通配地址(例如监听在0.0.0.0上)时，第一次调用才用getsockname(2)取得实际地址
+    const InetAddress& localAddress() const;
     const InetAddress& peerAddress() const { return peerAddr_; }
     
     bool connected() const { return state_ == kConnected; }
@@ -42,35 +65,84 @@ public:
     
     std::string getTcpInfoString() const;
 
-    // 发送消息给连接对端
+    /**
+     * 连接上的用户数据，例如协议解析器的状态，在多次可读事件之间保留；
+     * 只应在连接所属的loop线程中访问
+     */
+    void setContext(const std::any& context) { context_ = context; }
+    void setContext(std::any&& context) { context_ = std::move(context); }
+    const std::any& getContext() const { return context_; }
+    std::any* getMutableContext() { return &context_; }
+
+    // 发送消息给连接对端，允许在其他线程调用
+    // 在其他线程调用时，message会被拷贝一次，交给loop线程
     void send(const void* message, int len);
-    // void send(std::string&& message);
     void send(const std::string& message);
-    // void send(Buffer&& message);
+    // 接管message的所有权，跨线程时直接把它移动给loop线程，不拷贝数据
+    void send(std::string&& message);
+    // 发送buf中所有可读数据并清空buf，跨线程时直接取走buf的内部存储，不拷贝数据
     void send(Buffer* message);
+    // 接管message的内部存储，不拷贝数据，返回后message为空
+    void send(Buffer&& message);
+    // 接管message的数据块，跨线程时也不拷贝数据；直接写不完的块原样放入输出队列，返回后message为空
+    void send(ChainBuffer&& message);
+    // 把head和body作为一个整体，用一次writev发送，例如响应头和响应体
+    void send(std::string&& head, std::string&& body);
+    /**
+     * 用sendfile发送文件fd中[offset, offset+length)的内容，数据不经过用户空间，允许在其他线程调用
+     * 连接内部会dup一份fd，调用者返回后即可关闭自己的fd
+     * 文件数据与其他send()的数据按调用顺序发送，全部发送完之后回调writeCompleteCallback_；
+     * 未发送的文件字节不占用内存，不计入高水位，见queuedFileBytes()
+     */
+    void sendFile(int fd, off_t offset, size_t length);
     
     //关闭连接
     void shutdown();
+    // 不等待待发送数据写完，直接关闭连接，允许在其他线程调用
+    void forceClose();
 
-    void setTcpNoDElay(bool on) { socket_->setTcpNoDelay(on); }
+    void setTcpNoDElay(bool on) { socket_.setTcpNoDelay(on); }
 
     //保存用户自定义的回调函数
     void setConnectionCallback(const ConnectionCallback& cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback& cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback& cb) { writeCompleteCallback_ = cb; }
+    // 输出队列中的内存数据越过highWaterMark时回调一次，文件段不计入
     void setHighWaterMarkCallback(const HighWaterMarkCallback& cb, size_t highWaterMark) {
         highWaterMarkCallback_ = cb;
         highWaterMark_ = highWaterMark;
     }
+    // 输出队列中待发送的内存数据量(与高水位比较的量)和文件字节数，只能在loop线程中调用
+    size_t queuedBytes() const { return outputQueue_.memoryBytes(); }
+    size_t queuedFileBytes() const { return outputQueue_.fileBytes(); }
 
     void setCloseCallback(const CloseCallback& cb){
         closeCallback_ = cb;
     }
 
+    /**
+     * 边缘触发模式，必须在connectEstablished()之前设置。
+     * 此模式下每次读写事件都一直读写到EAGAIN，
+     * 但一次事件最多读/写ioBudget字节，超出部分排到本轮loop的末尾继续，避免一个繁忙的连接饿死其他连接
+     */
+    void setEdgeTriggered(bool on, size_t ioBudget = kDefaultIoBudget) {
+        edgeTriggered_ = on;
+        ioBudget_ = ioBudget > 0 ? ioBudget : kDefaultIoBudget;
+    }
+    static const size_t kDefaultIoBudget = 1024 * 1024;
+
+    // 空闲连接回收器，由TcpServer在connectEstablished()之前设置；回收器由TcpServer持有
+    void setReaper(ConnectionReaper* reaper) { reaper_ = reaper; }
+    // 最近一次收到数据的时刻，以及最近一次写出数据(或开始等待可写)的时刻
+    Timestamp lastReadTime() const { return lastReadTime_; }
+    Timestamp lastWriteTime() const { return lastWriteTime_; }
+
     void connectEstablished();
     void connectDestroyed();
 
 private:
+    friend class ConnectionReaper;
+
     enum StateE{
         kDisconnected,
         kConnecting,
@@ -87,23 +159,48 @@ private:
     void handleClose();  // 处理关闭连接事件
     void handleError();
 
-    // loop线程中排队发送消息
-    void sendInLoop(const std::string& message);
+    // loop线程中发送消息，数据直接从调用者的存储写入socket，只有未写完的部分才会拷贝到outputQueue_
     void sendInLoop(const void* message, size_t len);
+    // 以下重载已经拥有数据，未写完的部分直接放入outputQueue_，不拷贝
+    void sendInLoop(std::string&& message);
+    void sendInLoop(Buffer&& message);
+    void sendInLoop(ChainBuffer&& message);
+    void sendInLoop(std::string&& head, std::string&& body);
+    // fileHolder持有dup出来的fd，最后一个引用释放时关闭它
+    void sendFileInLoop(std::shared_ptr<const void> fileHolder, int fd, off_t offset, size_t length);
+    // 没有待发送数据时直接写socket，返回false表示连接已不可写
+    bool writeDirectInLoop(const struct iovec* vec, int iovcnt, size_t total, size_t& nwrote);
+    // 剩余数据入队后，检查高水位并监听可写事件
+    void queuedOutputInLoop(size_t oldLen);
+    // 边缘触发模式下，本次事件用完了读写预算或者没有写到EAGAIN，排到loop的任务队列中继续
+    void resumeReadInLoop();
+    void resumeWriteInLoop();
     
     // loop线程中排队关闭写连接
     void shutdownInLoop();
+    void forceCloseInLoop();
     
     // 连接所属的loop
     EventLoop* loop_;
-    const std::string name_;  //Tcp连接名称
+    // loop的连接计数器，连接可能比loop活得久，析构时通过它减计数
+    const std::shared_ptr<std::atomic_int> connectionCounter_;
+    const std::shared_ptr<const std::string> namePrefix_;
+    const int64_t id_;
+    mutable std::string name_;  //Tcp连接名称，见name()
+    mutable std::once_flag nameOnce_;
     std::atomic_int state_;
     bool reading_ = true;     // 连接是否正在监听读事件
+    bool edgeTriggered_ = false;
+    size_t ioBudget_ = kDefaultIoBudget;  // 边缘触发模式下每次事件最多读/写的字节数
+    bool readResumeQueued_ = false;
+    bool writeResumeQueued_ = false;
    
-    std::unique_ptr<Socket> socket_;
-    std::unique_ptr<Channel> channel_;
+    // 直接作为成员，和连接对象在同一块内存中
+    Socket socket_;
+    Channel channel_;
     
-    const InetAddress localAddr_;   // 本服务器地址
+    mutable InetAddress localAddr_;   // 本服务器地址，见localAddress()
+    mutable std::once_flag localAddrOnce_;
     const InetAddress peerAddr_;    // 对端地址
 
     /**
@@ -117,6 +214,17 @@ private:
     CloseCallback closeCallback_;  // 关闭连接回调
     
     size_t highWaterMark_;  // 高水位阈值
-    Buffer inputBuffer_;
-    Buffer outputBuffer_;
+    Buffer inputBuffer_;      // 初始为空，第一次读到数据时才分配，见Buffer::readFd()
+    // 分段的输出队列，用writev/sendfile发送
+    OutputQueue outputQueue_;
+
+    // 空闲检测：只在loop线程中读写，handleRead/handleWrite中更新时间戳，不移动回收器中的桶
+    Timestamp lastReadTime_;
+    Timestamp lastWriteTime_;
+    // 不拥有，connectDestroyed()或回收器析构时置空；连接可能比回收器和loop活得久
+    ConnectionReaper* reaper_ = nullptr;
+    int reaperBucket_ = -1;    // 在回收器中所在的桶，-1表示不在任何桶中
+    size_t reaperIndex_ = 0;   // 在桶中的下标
+
+    std::any context_;  // 见setContext()
 };
\ No newline at end of file
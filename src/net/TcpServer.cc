@@ -1,30 +1,43 @@
 #include "TcpServer.h"
 #include "TcpConnection.h"
 #include "SocketsOps.h"
+#include "Logging.h"
 
-#include <sstream>
-#include <iostream>
+#include <algorithm>
+#include <future>
+#include <set>
 
 TcpServer::TcpServer(EventLoop* loop,const InetAddress& listenAddr,
                         const std::string& nameArg,Option option)
     : loop_(loop),
+      listenAddr_(listenAddr),
       ipPort_(listenAddr.toIpPort()),
       name_(nameArg),
-      acceptor_(new Acceptor(loop, listenAddr, option == kReusePort)),
+      connNamePrefix_(std::make_shared<const std::string>(nameArg + "-" + ipPort_)),
+      acceptor_(option == kReusePortPerLoop ? nullptr : new Acceptor(loop, listenAddr, option == kReusePort)),
+      perLoopAcceptors_(option == kReusePortPerLoop),
+      cpuSteering_(false),
       threadPool_(new EventLoopThreadPool(loop, name_)),
       connectionCallback_(),
       messageCallback_(),
       writeCompleteCallback_(),
       threadInitCallback_(),
+      edgeTriggered_(false),
+      ioBudget_(TcpConnection::kDefaultIoBudget),
+      acceptBatch_(Acceptor::kDefaultAcceptBatch),
+      readIdleSeconds_(0.0),
+      writeIdleSeconds_(0.0),
       started_(0),
       nextConnTd_(1){
     // 设置用于新建连接的回调，当有新用户连接时，Acceptor类中绑定的acceptChannel_会有读事件发生执行handleRead()调用TcpServer::newConnection回调建立新连接
-    acceptor_->setNewConnectionCallback(std::bind(&TcpServer::newConnnection, this, _1, _2));
+    if (acceptor_) {
+        acceptor_->setNewConnectionBatchCallback(std::bind(&TcpServer::newConnnection, this, _1));
+    }
 }
 
 TcpServer::~TcpServer() {
     //log
-    std::cout << "TcpServer::~TcpServer [" << name_ << "] destructing"<<std::endl;
+    LOG_DEBUG << "TcpServer::~TcpServer [" << name_ << "] destructing";
     for (auto& item : connections_) {
         TcpConnectionPtr conn(item.second);
         // 把原始的智能指针复位,让栈空间的TcpConnectionPtr conn指向该对象，当conn出了其作用域,即可释放智能指针指向的对象
@@ -33,6 +46,33 @@ TcpServer::~TcpServer() {
         conn->getLoop()->runInLoop(
                 std::bind(&TcpConnection::connectDestroyed, conn));
     }
+    // 每个loop的Acceptor和连接都要在该loop线程中销毁，等它完成，之后不会再有回调使用this
+    for (auto& item : loopAcceptors_) {
+        EventLoop* ioLoop = item.first;
+        LoopAcceptor* state = item.second.get();
+        std::promise<void> done;
+        ioLoop->runInLoop([state, &done]() {
+            state->acceptor.reset();
+            for (auto& conn : state->connections) {
+                conn.second->connectDestroyed();
+            }
+            state->connections.clear();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+    // 回收器的定时器在它的loop中取消，所以也在该loop中销毁；排在上面的connectDestroyed()之后，
+    // 仍未销毁的连接(例如被用户持有的)由~ConnectionReaper()清除它们的reaper_
+    for (auto& item : reapers_) {
+        EventLoop* ioLoop = item.first;
+        std::unique_ptr<ConnectionReaper>& reaper = item.second;
+        std::promise<void> done;
+        ioLoop->runInLoop([&reaper, &done]() {
+            reaper.reset();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
 }
 
 
@@ -41,62 +81,219 @@ void TcpServer::start() {
     if (started_.exchange(1) == 0) {
         // 启动底层的lopp线程池
         threadPool_->start(threadInitCallback_);
-        assert(!acceptor_->listening());
-        loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        if (readIdleSeconds_ > 0 || writeIdleSeconds_ > 0) {
+            for (EventLoop* ioLoop : threadPool_->getAllLoops()) {
+                std::unique_ptr<ConnectionReaper> reaper(
+                        new ConnectionReaper(ioLoop, readIdleSeconds_, writeIdleSeconds_));
+                reaper->start();
+                reapers_[ioLoop] = std::move(reaper);
+            }
+        }
+        if (perLoopAcceptors_) {
+            startPerLoopAcceptors();
+        } else {
+            assert(!acceptor_->listening());
+            loop_->runInLoop(std::bind(&Acceptor::listen, acceptor_.get()));
+        }
+    }
+}
+
+/**
+ * 为每个IO loop创建绑定同一地址的SO_REUSEPORT监听socket
+ * @details 依次在各个loop中listen()并等待完成，保证第i个loop的socket是reuseport组中的第i个，
+ * CPU导向的CBPF程序按这个顺序选择socket
+ */
+void TcpServer::startPerLoopAcceptors() {
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    // 先建好整个loopAcceptors_，开始监听之后各loop线程会并发地查找它
+    for (size_t i = 0; i < loops.size(); ++i) {
+        std::unique_ptr<LoopAcceptor> state(new LoopAcceptor);
+        state->index = static_cast<int>(i);
+        state->nextConnId = static_cast<int64_t>(i) + 1;
+        state->acceptor.reset(new Acceptor(loops[i], listenAddr_, true));
+        state->acceptor->setAcceptBatch(acceptBatch_);
+        state->acceptor->setNewConnectionBatchCallback(
+                std::bind(&TcpServer::newConnectionInLoop, this, loops[i], _1));
+        loopAcceptors_[loops[i]] = std::move(state);
+    }
+    for (EventLoop* ioLoop : loops) {
+        Acceptor* acceptor = loopAcceptors_.find(ioLoop)->second->acceptor.get();
+        std::promise<void> listened;
+        ioLoop->runInLoop([acceptor, &listened]() {
+            acceptor->listen();
+            listened.set_value();
+        });
+        listened.get_future().wait();
+    }
+    if (cpuSteering_ && loops.size() > 1) {
+        attachCpuSteering(loops);
+    }
+}
+
+/**
+ * 按IO线程的CPU绑定给reuseport组挂CBPF程序
+ * @details 第i个loop只绑定到一个CPU且各loop的CPU互不相同时，该CPU上的SYN交给第i个loop；
+ * 没有绑定时只能按cpu % n分散连接，没有局部性；一个loop绑定多个CPU(kNumaNode)或多个loop
+ * 共用CPU时，不存在CPU到loop的一一对应，不挂程序，仍按四元组哈希分配
+ */
+void TcpServer::attachCpuSteering(const std::vector<EventLoop*>& loops) {
+    const std::vector<std::vector<int>>& plan = threadPool_->loopCpus();
+    std::vector<int> socketCpus;
+    std::set<int> used;
+    bool pinned = false;
+    for (const std::vector<int>& cpus : plan) {
+        pinned = pinned || !cpus.empty();
+    }
+    if (pinned) {
+        for (const std::vector<int>& cpus : plan) {
+            if (cpus.size() != 1 || !used.insert(cpus[0]).second) {
+                //log
+                LOG_WARN << "TcpServer [" << name_ << "] IO threads are not pinned one per cpu, "
+                         << "reuseport cpu steering is not attached";
+                return;
+            }
+            socketCpus.push_back(cpus[0]);
+        }
+    } else {
+        //log
+        LOG_WARN << "TcpServer [" << name_ << "] IO threads are not pinned, "
+                 << "reuseport cpu steering only spreads connections by cpu % " << loops.size();
+    }
+    loopAcceptors_.find(loops[0])->second->acceptor->attachReusePortCpuSteering(
+            static_cast<int>(loops.size()), socketCpus);
+}
+
+void TcpServer::setAcceptBatch(int n) {
+    acceptBatch_ = n;
+    if (acceptor_) {
+        acceptor_->setAcceptBatch(n);
     }
 }
 
 /**
- * 此函数被设置为Acceptor的newConnection,有一个新用户连接，
- * acceptor会执行这个回调操作，新建一个TcpConnection对象, 用于连接管理，并将此连接关联的Channel分发给subLoop去处理
- * @details 新建的TcpConnection对象会加入内部ConnectionMap.
- * @param sockfd accept返回的连接fd (accepted socket fd)
- * @param peerAddr 对端ip地址信息
+ * 此函数被设置为Acceptor的newConnection,有一批新用户连接，
+ * acceptor会执行这个回调操作，为每个连接选择一个subLoop，在subLoop中新建TcpConnection对象, 用于连接管理
+ * @details TcpConnection在它所属的subLoop线程中构造，IO线程绑定了CPU时，连接对象和它的缓冲区都在本地NUMA节点上。
+ * 同一批中分给同一个subLoop的连接只投递一次任务，一次唤醒；新建的TcpConnection对象再回到baseLoop加入ConnectionMap.
+ * @param accepted accept返回的连接fd和对端ip地址信息
  * @note 必须在所属loop线程运行
  */
-void TcpServer::newConnnection(int sockfd, const InetAddress& peerAddr) {
-    // 轮询算法，从EventLoop线程池中，取出一个subLoop来管理connfd对应的channel,便于均衡各EventLoop负责的连接数
-    EventLoop* ioLoop = threadPool_->getNextLoop();
-    // 设置连接对象名称, 包含基础名称+ip地址+端口号+连接Id，因为要作为ConnectionMap的key, 要确保运行时唯一性
-    std::ostringstream sbuf;
-    sbuf << "-" << ipPort_.c_str() << "#" << nextConnTd_;
-    ++nextConnTd_;
-    std::string connName = name_ + sbuf.str();
-    //log
-    std::cout << "TcpServer::newConnection [" << name_ << "] - new connection [" << connName << "] from " << peerAddr.toIpPort() <<std::endl;
-    //获取套接字在本地的地址信息
-    sockaddr_in local;
-    ::memset(&local, 0, sizeof(local));
-    socklen_t addrlen = sizeof(local);
-    if(::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0) {
-        std::cout << "sockets::getLocalAddr() failed" <<std::endl;
+void TcpServer::newConnnection(const std::vector<Acceptor::AcceptedConnection>& accepted) {
+    std::vector<std::pair<EventLoop*, std::vector<PendingConnection>>> batches;
+    for (const Acceptor::AcceptedConnection& item : accepted) {
+        // 按分配策略(默认轮询)，从EventLoop线程池中，取出一个subLoop来管理connfd对应的channel,便于均衡各EventLoop的负载
+        EventLoop* ioLoop = threadPool_->getLoopForConnection(item.peerAddr);
+        // 连接在ioLoop中构造之前先计数占位，按连接数分配的策略在同一批中也能看到它
+        ioLoop->connectionCreated();
+        auto it = std::find_if(batches.begin(), batches.end(),
+                               [ioLoop](const std::pair<EventLoop*, std::vector<PendingConnection>>& batch) {
+                                   return batch.first == ioLoop;
+                               });
+        if (it == batches.end()) {
+            batches.emplace_back(ioLoop, std::vector<PendingConnection>());
+            it = batches.end() - 1;
+        }
+        it->second.push_back(PendingConnection{nextConnTd_, item.sockfd, item.peerAddr});
+        ++nextConnTd_;
     }
-    InetAddress localAddr(local);
+    for (auto& batch : batches) {
+        EventLoop* ioLoop = batch.first;
+        ioLoop->runInLoop([this, ioLoop, pending = std::move(batch.second)]() {
+            establishConnections(ioLoop, pending);
+        });
+    }
+}
 
-    TcpConnectionPtr conn(std::make_shared<TcpConnection>(ioLoop, connName, sockfd,
-                            localAddr, peerAddr));
-    connections_[connName] = conn;
+// 在ioLoop线程中构造并建立newConnnection()分配过来的一批连接
+void TcpServer::establishConnections(EventLoop* ioLoop, const std::vector<PendingConnection>& pending) {
+    std::vector<TcpConnectionPtr> conns;
+    conns.reserve(pending.size());
+    for (const PendingConnection& item : pending) {
+        conns.push_back(createConnection(ioLoop, item.id, item.sockfd, item.peerAddr));
+        // 连接构造时已经通过ioLoop->connectionCounter()计数，撤销占位
+        ioLoop->connectionDestroyed();
+    }
+    // 先投递加入ConnectionMap的任务，连接建立后再关闭时，removeConnectionInLoop()一定排在它后面
+    loop_->runInLoop([this, conns]() {
+        for (const TcpConnectionPtr& conn : conns) {
+            connections_[conn->id()] = conn;
+        }
+    });
+    for (const TcpConnectionPtr& conn : conns) {
+        conn->connectEstablished();
+    }
+}
+
+/**
+ * kReusePortPerLoop模式下，ioLoop自己的监听socket接受了新连接
+ * @details 连接直接在本线程创建并加入本loop的连接表，不需要跨线程
+ */
+void TcpServer::newConnectionInLoop(EventLoop* ioLoop, const std::vector<Acceptor::AcceptedConnection>& accepted) {
+    LoopAcceptor* state = loopAcceptors_.find(ioLoop)->second.get();
+    const int64_t step = static_cast<int64_t>(loopAcceptors_.size());
+    for (const Acceptor::AcceptedConnection& item : accepted) {
+        TcpConnectionPtr conn(createConnection(ioLoop, state->nextConnId, item.sockfd, item.peerAddr));
+        state->nextConnId += step;
+        state->connections[conn->id()] = conn;
+        conn->connectEstablished();
+    }
+}
+
+TcpConnectionPtr TcpServer::createConnection(EventLoop* ioLoop, int64_t id,
+                                             int sockfd, const InetAddress& peerAddr) {
+    //log
+    LOG_DEBUG << "TcpServer::newConnection [" << name_ << "] - new connection [" << *connNamePrefix_ << "#" << id << "] from " << peerAddr.toIpPort();
+    // 本地地址就是监听地址；监听在通配地址上时，由TcpConnection在第一次用到时再getsockname(2)
+    // 连接名称只保存共用的前缀和编号，需要时才格式化
+    TcpConnectionPtr conn(TcpConnection::create(ioLoop, connNamePrefix_, id, sockfd,
+                            listenAddr_, peerAddr));
 
     // 下面的3个回调都是用户设置给TcpServer => TcpConnection的，至于Channel绑定的则是TcpConnection设置的四个，handleRead,handleWrite... 这下面的回调用于handlexxx函数中
     conn->setConnectionCallback(connectionCallback_);
     conn->setMessageCallback(messageCallback_);
     conn->setWriteCompleteCallback(writeCompleteCallback_);
-    // 设置如何关闭连接的回调
-    conn->setCloseCallback(
-            std::bind(&TcpServer::removeConnnection, this, std::placeholders::_1));
-    
-    ioLoop->runInLoop(std::bind(&TcpConnection::connectEstablished, conn));
+    conn->setEdgeTriggered(edgeTriggered_, ioBudget_);
+    // reapers_在start()之后只读，可以在多个loop线程中同时查找
+    auto reaper = reapers_.find(ioLoop);
+    if (reaper != reapers_.end()) {
+        conn->setReaper(reaper->second.get());
+    }
+    // 设置如何关闭连接的回调；只捕获this的lambda放得进std::function内部的缓冲区，不在堆上分配
+    conn->setCloseCallback([this](const TcpConnectionPtr& c) { removeConnnection(c); });
+    return conn;
 }
 
 void TcpServer::removeConnnection(const TcpConnectionPtr& conn) {
-    loop_->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
+    // 按loop分开保存连接时，连接表就在连接自己的loop中
+    EventLoop* ownerLoop = perLoopAcceptors_ ? conn->getLoop() : loop_;
+    ownerLoop->runInLoop(std::bind(&TcpServer::removeConnectionInLoop, this, conn));
 }
 
 void TcpServer::removeConnectionInLoop(const TcpConnectionPtr& conn) {
     //log
-    std::cout << "TcpServer::removeConnectionInLoop [" << name_.c_str() << "] - connection " << conn->name().c_str() <<std::endl;
-    // 从ConnectionMap中擦除待移除TcpConnection对象
-    connections_.erase(conn->name());
+    LOG_DEBUG << "TcpServer::removeConnectionInLoop [" << name_.c_str() << "] - connection " << conn->id();
     EventLoop* ioLoop = conn->getLoop();
+    // 从ConnectionMap中擦除待移除TcpConnection对象
+    if (perLoopAcceptors_) {
+        loopAcceptors_.find(ioLoop)->second->connections.erase(conn->id());
+    } else {
+        connections_.erase(conn->id());
+    }
     ioLoop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
-}
\ No newline at end of file
+}
+
+int64_t TcpServer::numReadIdleReaped() const {
+    int64_t n = 0;
+    for (const auto& item : reapers_) {
+        n += item.second->numReadIdleReaped();
+    }
+    return n;
+}
+
+int64_t TcpServer::numWriteIdleReaped() const {
+    int64_t n = 0;
+    for (const auto& item : reapers_) {
+        n += item.second->numWriteIdleReaped();
+    }
+    return n;
+}
@@ -8,12 +8,15 @@
 #include "EventLoop.h"
 #include "InetAddress.h"
 #include "Buffer.h"
+#include "ConnectionReaper.h"
 
 #include <functional>
 #include <string>
 #include <atomic>
 #include <map>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
 // Tcp Server, 支持单线程和thread-poll模型，用户只需要设置好callback，然后调用start()即可。
 class TcpServer : noncopyable {
@@ -23,6 +26,12 @@ public:
     enum Option {
         kNoReusePort, //不允许重用本地端口
         kReusePort,   //允许重用本地端口
+        /**
+         * 每个IO loop各有一个用SO_REUSEPORT绑定同一地址的监听socket，由内核把新连接分给各个socket，
+         * 每个loop直接accept并在本线程创建TcpConnection，建立连接的过程不跨线程；
+         * 此时baseLoop不监听，连接表也按loop分开保存
+         */
+        kReusePortPerLoop,
     };
     TcpServer(EventLoop* loop,
                 const InetAddress& listenAddr,
@@ -36,7 +45,21 @@ public:
 
     void setThreadNum(int numthreads) { threadPool_->setThreadNum(numthreads); }
     void setThreadInitCallback(const ThreadInitCallback& cb) {  threadInitCallback_ = cb; }
+    // IO线程使用的poller实现(epoll/io_uring)，在start()之前调用；baseLoop由用户自己创建，在其构造函数中指定
+    void setPollerType(Poller::Type type) { threadPool_->setPollerType(type); }
     std::shared_ptr<EventLoopThreadPool> threadPool() { return threadPool_; }
+    // 新连接分配到哪个IO线程，见EventLoopThreadPool::PlacementPolicy，在start()之前调用；
+    // kReusePortPerLoop模式下由内核(或CBPF程序)分配，不使用这个策略
+    void setPlacementPolicy(EventLoopThreadPool::PlacementPolicy policy) { threadPool_->setPlacementPolicy(policy); }
+    /**
+     * kReusePortPerLoop模式下，挂上按CPU选择监听socket的CBPF程序(SO_ATTACH_REUSEPORT_CBPF)，
+     * 在绑定了处理SYN的那个CPU的loop中accept，连接从网卡中断到应用都在同一个CPU上。
+     * CPU到loop的对应关系取自线程池的CPU绑定(EventLoopThreadPool::loopCpus())，
+     * 需要每个IO线程各绑定一个不同的CPU，否则只打印警告，见attachCpuSteering()。在start()之前调用
+     */
+    void setReusePortCpuSteering(bool on) { cpuSteering_ = on; }
+    // 每次监听socket可读时最多accept的连接数，见Acceptor::setAcceptBatch()，在start()之前调用
+    void setAcceptBatch(int n);
 
     void start();
 
@@ -46,25 +69,81 @@ public:
 
     void setWriteCompleteCallback(const WriteCompleteCallback& cb) { writeCompleteCallback_=cb; }
 
+    /**
+     * 新连接使用边缘触发(EPOLLET)模式，在start()之前调用
+     * @param ioBudget 每个连接每次读写事件最多处理的字节数，用完后排到本轮loop末尾继续，保证连接之间的公平
+     */
+    void setEdgeTriggered(bool on, size_t ioBudget = TcpConnection::kDefaultIoBudget) {
+        edgeTriggered_ = on;
+        ioBudget_ = ioBudget;
+    }
+
+    /**
+     * 空闲超时，在start()之前调用，单位秒，<= 0表示不检查这一项
+     * @param readIdleSeconds 没有待发送数据、且这么久没有收到任何数据的连接被强制关闭
+     * @param writeIdleSeconds 有待发送数据、但这么久没有写出任何数据的连接被强制关闭
+     * @details 每个IO loop一个ConnectionReaper，连接只在读写时更新时间戳，不为每个连接创建定时器
+     */
+    void setIdleTimeout(double readIdleSeconds, double writeIdleSeconds = 0.0) {
+        readIdleSeconds_ = readIdleSeconds;
+        writeIdleSeconds_ = writeIdleSeconds;
+    }
+    // 因读空闲/写空闲被关闭的连接数，在start()之后可以在任意线程调用
+    int64_t numReadIdleReaped() const;
+    int64_t numWriteIdleReaped() const;
+
 private:
+    // 以TcpConnection::id()为键
+    using ConnectionMap = std::unordered_map<int64_t, TcpConnectionPtr>;
+
     /**
      * 同样是连接回调，TcpServer::newConnection()和connectionCallback_的区别：
      * 前者是Acceptor发生连接请求事件时，回调，用来新建一个Tcp连接；
      * 后者是在TcpServer内部新建连接即调用TcpServer::newConnection()时，回调connectionCallback_，用于建立新连接
      */
-    void newConnnection(int sockfd,const InetAddress& peerAddr);
+    void newConnnection(const std::vector<Acceptor::AcceptedConnection>& accepted);
+    // kReusePortPerLoop模式下，ioLoop自己的Acceptor接受了新连接，在ioLoop线程中调用
+    void newConnectionInLoop(EventLoop* ioLoop, const std::vector<Acceptor::AcceptedConnection>& accepted);
+    // newConnnection()分配到ioLoop的连接，还没有构造TcpConnection
+    struct PendingConnection {
+        int64_t id;
+        int sockfd;
+        InetAddress peerAddr;
+    };
+    void establishConnections(EventLoop* ioLoop, const std::vector<PendingConnection>& pending);
+    // 在ioLoop线程中创建TcpConnection并设置回调，由调用者加入连接表并connectEstablished()
+    TcpConnectionPtr createConnection(EventLoop* ioLoop, int64_t id,
+                                      int sockfd, const InetAddress& peerAddr);
+    // kReusePortPerLoop模式下在start()中为每个IO loop创建Acceptor
+    void startPerLoopAcceptors();
+    void attachCpuSteering(const std::vector<EventLoop*>& loops);
     
     // 用于移除一个TcpConnection对象，被设置为TcpConnection的CloseCallback
     void removeConnnection(const TcpConnectionPtr& conn);
     // 在TcpConnection对象所属的loop中具体执行移除操作
     void removeConnectionInLoop(const TcpConnectionPtr& conn);
 
-    using ConnectionMap = std::map<std::string, TcpConnectionPtr>;
+    using ReaperMap = std::unordered_map<EventLoop*, std::unique_ptr<ConnectionReaper>>;
+
+    // kReusePortPerLoop模式下每个IO loop的监听socket和连接，只在该loop线程中访问
+    struct LoopAcceptor {
+        int index;
+        std::unique_ptr<Acceptor> acceptor;
+        ConnectionMap connections;
+        // 各loop的编号从index + 1开始、以loop个数为步长，互不重复
+        int64_t nextConnId;
+    };
+    using LoopAcceptorMap = std::unordered_map<EventLoop*, std::unique_ptr<LoopAcceptor>>;
     
     EventLoop* loop_;
+    const InetAddress listenAddr_;
     const std::string ipPort_;
     const std::string name_;
-    std::unique_ptr<Acceptor> acceptor_;
+    // 连接名称的前缀"name-ip:port"，所有连接共用
+    const std::shared_ptr<const std::string> connNamePrefix_;
+    std::unique_ptr<Acceptor> acceptor_;  // kReusePortPerLoop模式下为空
+    const bool perLoopAcceptors_;
+    bool cpuSteering_;
     std::shared_ptr<EventLoopThreadPool> threadPool_;
     //由具体的服务器类的成员函数包装而成
     ConnectionCallback connectionCallback_;  // 有新连接或连接断开时的回调函数
@@ -72,7 +151,16 @@ private:
     WriteCompleteCallback writeCompleteCallback_;  // 应用层缓冲区的消息发送完以后的回调函数
 
     ThreadInitCallback threadInitCallback_;
+    bool edgeTriggered_;
+    size_t ioBudget_;
+    int acceptBatch_;
+    double readIdleSeconds_;
+    double writeIdleSeconds_;
+    // 每个IO loop的空闲连接回收器，在start()中创建，之后不再修改；析构时在各自的loop中销毁
+    ReaperMap reapers_;
     std::atomic_int32_t started_;
-    int nextConnTd_;             //标识每一个连接的id，每新建一个连接，加1
-    ConnectionMap connections_;  //保存所有的连接
+    int64_t nextConnTd_;         //标识每一个连接的id，每新建一个连接，加1
+    ConnectionMap connections_;  //保存所有的连接，kReusePortPerLoop模式下不使用
+    // 在start()中创建，之后不再修改
+    LoopAcceptorMap loopAcceptors_;
 };
\ No newline at end of file
@@ -0,0 +1,76 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+#include <future>
+
+UdpServer::UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg)
+    : loop_(loop),
+      listenAddr_(listenAddr),
+      name_(nameArg),
+      threadPool_(new EventLoopThreadPool(loop, nameArg)),
+      batchSize_(UdpSocket::kDefaultBatchSize),
+      maxDatagramSize_(UdpSocket::kDefaultMaxDatagramSize),
+      gro_(false),
+      cpuSteering_(false),
+      started_(0) {
+}
+
+UdpServer::~UdpServer() {
+    LOG_DEBUG << "UdpServer::~UdpServer [" << name_ << "] destructing";
+    // 每个socket的Channel都要在所属loop线程中移除，等它完成，之后不会再有回调
+    for (auto& socket : sockets_) {
+        EventLoop* ioLoop = socket->getLoop();
+        std::promise<void> done;
+        ioLoop->runInLoop([&socket, &done]() {
+            socket.reset();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+}
+
+/**
+ * 启动线程池，为每个IO loop创建绑定同一地址的SO_REUSEPORT socket
+ * @details 依次在各个loop中创建并等待完成，第i个loop的socket是reuseport组中的第i个，
+ * CPU导向的CBPF程序按这个顺序选择socket
+ */
+void UdpServer::start() {
+    if (started_.exchange(1) != 0) {
+        return;
+    }
+    threadPool_->start(threadInitCallback_);
+    std::vector<EventLoop*> loops = threadPool_->getAllLoops();
+    const bool reuseport = loops.size() > 1;
+    sockets_.resize(loops.size());
+    for (size_t i = 0; i < loops.size(); ++i) {
+        std::unique_ptr<UdpSocket>& slot = sockets_[i];
+        std::promise<void> created;
+        loops[i]->runInLoop([this, &slot, &created, loop = loops[i], reuseport]() {
+            slot.reset(new UdpSocket(loop, listenAddr_, reuseport, batchSize_, maxDatagramSize_, gro_));
+            slot->setBatchCallback(batchCallback_);
+            slot->start();
+            created.set_value();
+        });
+        created.get_future().wait();
+    }
+    if (cpuSteering_ && reuseport) {
+        sockets_[0]->attachReusePortCpuSteering(static_cast<int>(sockets_.size()));
+    }
+    LOG_INFO << "UdpServer [" << name_ << "] listening on " << listenAddr_.toIpPort()
+             << " with " << sockets_.size() << " sockets";
+}
+
+int64_t UdpServer::sum(int64_t (UdpSocket::*stat)() const) const {
+    int64_t total = 0;
+    for (const auto& socket : sockets_) {
+        total += (socket.get()->*stat)();
+    }
+    return total;
+}
+
+int64_t UdpServer::numReceived() const { return sum(&UdpSocket::numReceived); }
+int64_t UdpServer::numReceiveBatches() const { return sum(&UdpSocket::numReceiveBatches); }
+int64_t UdpServer::numTruncated() const { return sum(&UdpSocket::numTruncated); }
+int64_t UdpServer::numSent() const { return sum(&UdpSocket::numSent); }
+int64_t UdpServer::numSendDropped() const { return sum(&UdpSocket::numSendDropped); }
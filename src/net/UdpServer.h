@@ -0,0 +1,73 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "UdpSocket.h"
+#include "EventLoopThreadPool.h"
+#include "InetAddress.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+class EventLoop;
+
+/**
+ * UDP服务器：每个IO loop一个以SO_REUSEPORT绑定同一地址的UdpSocket，由内核按四元组把数据报分给各个socket，
+ * 每个loop独立地批量接收并在本线程回调，与TcpServer的kReusePortPerLoop模式相同；
+ * 没有IO线程(setThreadNum(0))时只在baseLoop上绑定一个socket。
+ * 回调中可以用UdpSocket::sendTo()从同一个socket回复
+ */
+class UdpServer : noncopyable {
+public:
+    using ThreadInitCallback = std::function<void(EventLoop*)>;
+    using DatagramBatchCallback = UdpSocket::DatagramBatchCallback;
+
+    UdpServer(EventLoop* loop, const InetAddress& listenAddr, const std::string& nameArg);
+    ~UdpServer();
+
+    const std::string& name() const { return name_; }
+    EventLoop* getLoop() const { return loop_; }
+
+    // 以下设置都在start()之前调用
+    void setThreadNum(int numThreads) { threadPool_->setThreadNum(numThreads); }
+    void setThreadInitCallback(const ThreadInitCallback& cb) { threadInitCallback_ = cb; }
+    void setPollerType(Poller::Type type) { threadPool_->setPollerType(type); }
+    std::shared_ptr<EventLoopThreadPool> threadPool() { return threadPool_; }
+    void setBatchCallback(const DatagramBatchCallback& cb) { batchCallback_ = cb; }
+    // 每个socket一次recvmmsg的数据报个数，即接收环的槽位数
+    void setBatchSize(int n) { batchSize_ = n; }
+    // 接收槽位大小，更大的数据报被截断
+    void setMaxDatagramSize(size_t n) { maxDatagramSize_ = n; }
+    // 请求开启UDP_GRO，见UdpSocket
+    void setGro(bool on) { gro_ = on; }
+    // 按处理数据报的CPU选择socket，见Socket::attachReusePortCpuSteering()
+    void setReusePortCpuSteering(bool on) { cpuSteering_ = on; }
+
+    void start();
+
+    // 各socket统计数据的和，在start()之后可以在任意线程调用
+    int64_t numReceived() const;
+    int64_t numReceiveBatches() const;
+    int64_t numTruncated() const;
+    int64_t numSent() const;
+    int64_t numSendDropped() const;
+
+private:
+    int64_t sum(int64_t (UdpSocket::*stat)() const) const;
+
+    EventLoop* loop_;
+    const InetAddress listenAddr_;
+    const std::string name_;
+    std::shared_ptr<EventLoopThreadPool> threadPool_;
+    ThreadInitCallback threadInitCallback_;
+    DatagramBatchCallback batchCallback_;
+    int batchSize_;
+    size_t maxDatagramSize_;
+    bool gro_;
+    bool cpuSteering_;
+    std::atomic_int32_t started_;
+    // 在start()中按loop顺序创建，之后不再修改；每个socket在它所属的loop线程中创建和销毁
+    std::vector<std::unique_ptr<UdpSocket>> sockets_;
+};
@@ -0,0 +1,293 @@
+#include "UdpSocket.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <netinet/udp.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+
+// 旧的libc头文件中没有这两个选项(Linux 4.18/5.0引入)，值与内核include/uapi/linux/udp.h一致
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO 104
+#endif
+
+const int UdpSocket::kDefaultBatchSize;
+const size_t UdpSocket::kDefaultMaxDatagramSize;
+const size_t UdpSocket::kMaxCoalescedSize;
+const int UdpSocket::kMaxSegments;
+
+namespace {
+
+// 每个接收槽位的控制消息缓冲区，放得下UDP_GRO的一个int
+const size_t kControlSize = 64;
+// 一次可读事件最多执行的recvmmsg次数，之后让出loop给其他channel
+const int kMaxBatchesPerEvent = 8;
+
+int createNonblockingUdp() {
+    int sockfd = ::socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (sockfd < 0) {
+        LOG_FATAL << "udp socket create err " << errno;
+    }
+    return sockfd;
+}
+
+}  // namespace
+
+UdpSocket::UdpSocket(EventLoop* loop, const InetAddress& bindAddr, bool reuseport,
+                     int batchSize, size_t maxDatagramSize, bool gro)
+    : loop_(loop),
+      socket_(createNonblockingUdp()),
+      channel_(loop, socket_.fd()),
+      batchSize_(batchSize > 0 ? batchSize : 1),
+      maxDatagramSize_(std::min(maxDatagramSize, kMaxCoalescedSize)),
+      groEnabled_(false),
+      gsoEnabled_(true),
+      slotSize_(gro ? kMaxCoalescedSize : maxDatagramSize_),
+      rxData_(new char[batchSize_ * slotSize_]),
+      rxMsgs_(batchSize_),
+      rxIovecs_(batchSize_),
+      rxAddrs_(batchSize_),
+      rxControl_(new char[batchSize_ * kControlSize]),
+      numReceived_(0),
+      numReceiveBatches_(0),
+      numTruncated_(0),
+      numSent_(0),
+      numSendDropped_(0) {
+    socket_.setReuseAddr(true);
+    socket_.setReusePort(reuseport);
+    socket_.bindAddress(bindAddr);
+    if (gro) {
+        int on = 1;
+        groEnabled_ = ::setsockopt(socket_.fd(), IPPROTO_UDP, UDP_GRO, &on, sizeof on) == 0;
+        if (!groEnabled_) {
+            LOG_WARN << "UdpSocket " << bindAddr.toIpPort() << " UDP_GRO unavailable, errno " << errno;
+        }
+    }
+    for (int i = 0; i < batchSize_; ++i) {
+        rxIovecs_[i].iov_base = rxData_.get() + i * slotSize_;
+        rxIovecs_[i].iov_len = slotSize_;
+    }
+    datagrams_.reserve(batchSize_);
+    pending_.reserve(batchSize_);
+    txData_.reserve(batchSize_ * std::min(maxDatagramSize_, size_t(1500)));
+    channel_.setReadCallback(std::bind(&UdpSocket::handleRead, this, std::placeholders::_1));
+}
+
+UdpSocket::~UdpSocket() {
+    assert(loop_->isInLoopThread());
+    flush();
+    channel_.disableAll();
+    channel_.remove();
+}
+
+void UdpSocket::start() {
+    assert(loop_->isInLoopThread());
+    channel_.enableReading();
+}
+
+void UdpSocket::handleRead(Timestamp receiveTime) {
+    for (int round = 0; round < kMaxBatchesPerEvent; ++round) {
+        int n = receiveBatch();
+        if (n < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                LOG_ERROR << "UdpSocket::handleRead recvmmsg errno " << errno;
+            }
+            break;
+        }
+        if (!datagrams_.empty() && batchCallback_) {
+            batchCallback_(this, datagrams_, receiveTime);
+        }
+        flush();
+        // 没有收满一批，接收队列已经读空
+        if (n < batchSize_) {
+            break;
+        }
+    }
+}
+
+int UdpSocket::receiveBatch() {
+    // recvmmsg会改写msg_namelen和msg_controllen，每次都要重新设置
+    for (int i = 0; i < batchSize_; ++i) {
+        struct msghdr& hdr = rxMsgs_[i].msg_hdr;
+        hdr.msg_name = &rxAddrs_[i];
+        hdr.msg_namelen = sizeof(sockaddr_in);
+        hdr.msg_iov = &rxIovecs_[i];
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = groEnabled_ ? rxControl_.get() + i * kControlSize : nullptr;
+        hdr.msg_controllen = groEnabled_ ? kControlSize : 0;
+        hdr.msg_flags = 0;
+    }
+    int n = ::recvmmsg(socket_.fd(), rxMsgs_.data(), batchSize_, MSG_DONTWAIT, nullptr);
+    datagrams_.clear();
+    if (n <= 0) {
+        return n;
+    }
+    int64_t truncated = 0;
+    for (int i = 0; i < n; ++i) {
+        struct msghdr& hdr = rxMsgs_[i].msg_hdr;
+        const char* data = static_cast<const char*>(rxIovecs_[i].iov_base);
+        size_t len = rxMsgs_[i].msg_len;
+        if (hdr.msg_flags & MSG_TRUNC) {
+            ++truncated;
+        }
+        size_t segSize = 0;
+        if (groEnabled_) {
+            for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(&hdr, cmsg)) {
+                if (cmsg->cmsg_level == IPPROTO_UDP && cmsg->cmsg_type == UDP_GRO) {
+                    int gsoSize = 0;
+                    memcpy(&gsoSize, CMSG_DATA(cmsg), sizeof gsoSize);
+                    segSize = static_cast<size_t>(gsoSize);
+                }
+            }
+        }
+        InetAddress peerAddr(rxAddrs_[i]);
+        if (segSize == 0 || segSize >= len) {
+            datagrams_.push_back(Datagram{data, len, peerAddr});
+        } else {
+            // GRO合并的缓冲区：除最后一个外每个数据报都是segSize字节
+            for (size_t off = 0; off < len; off += segSize) {
+                datagrams_.push_back(Datagram{data + off, std::min(segSize, len - off), peerAddr});
+            }
+        }
+    }
+    numReceived_.fetch_add(static_cast<int64_t>(datagrams_.size()), std::memory_order_relaxed);
+    numReceiveBatches_.fetch_add(1, std::memory_order_relaxed);
+    if (truncated > 0) {
+        numTruncated_.fetch_add(truncated, std::memory_order_relaxed);
+        LOG_WARN << "UdpSocket fd " << socket_.fd() << " truncated " << truncated
+                 << " datagrams larger than " << slotSize_ << " bytes";
+    }
+    return n;
+}
+
+void UdpSocket::sendTo(const InetAddress& peerAddr, const char* data, size_t len) {
+    assert(loop_->isInLoopThread());
+    if (len > maxDatagramSize_) {
+        flush();
+        ssize_t n = ::sendto(socket_.fd(), data, len, 0,
+                             reinterpret_cast<const sockaddr*>(peerAddr.getSockAddr()), sizeof(sockaddr_in));
+        if (n < 0) {
+            numSendDropped_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            numSent_.fetch_add(1, std::memory_order_relaxed);
+        }
+        return;
+    }
+    if (static_cast<int>(pending_.size()) == batchSize_) {
+        flush();
+    }
+    pending_.push_back(PendingSend{*peerAddr.getSockAddr(), txData_.size(), len});
+    txData_.insert(txData_.end(), data, data + len);
+}
+
+void UdpSocket::flush() {
+    if (pending_.empty()) {
+        return;
+    }
+    const size_t count = pending_.size();
+    txMsgs_.resize(count);
+    txIovecs_.resize(count);
+    // txData_可能在追加时重新分配，所以到这里才计算地址
+    for (size_t i = 0; i < count; ++i) {
+        txIovecs_[i].iov_base = txData_.data() + pending_[i].offset;
+        txIovecs_[i].iov_len = pending_[i].len;
+        struct msghdr& hdr = txMsgs_[i].msg_hdr;
+        memset(&hdr, 0, sizeof hdr);
+        hdr.msg_name = &pending_[i].peerAddr;
+        hdr.msg_namelen = sizeof(sockaddr_in);
+        hdr.msg_iov = &txIovecs_[i];
+        hdr.msg_iovlen = 1;
+    }
+    size_t sent = 0;
+    while (sent < count) {
+        int n = ::sendmmsg(socket_.fd(), txMsgs_.data() + sent, static_cast<unsigned int>(count - sent), 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // UDP不重传：发送缓冲区满(EAGAIN)或对端不可达时丢掉剩下的，不阻塞loop
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR << "UdpSocket::flush sendmmsg errno " << errno;
+            }
+            break;
+        }
+        sent += n;
+    }
+    numSent_.fetch_add(static_cast<int64_t>(sent), std::memory_order_relaxed);
+    numSendDropped_.fetch_add(static_cast<int64_t>(count - sent), std::memory_order_relaxed);
+    pending_.clear();
+    txData_.clear();
+}
+
+void UdpSocket::sendSegmented(const InetAddress& peerAddr, const char* data, size_t len, size_t segSize) {
+    assert(loop_->isInLoopThread());
+    assert(segSize > 0);
+    // 先发出已经排队的数据报，保持发送顺序
+    flush();
+    const size_t maxPerSend = std::min(static_cast<size_t>(kMaxSegments) * segSize, kMaxCoalescedSize / segSize * segSize);
+    size_t off = 0;
+    while (gsoEnabled_ && maxPerSend > 0 && off < len) {
+        size_t n = std::min(len - off, maxPerSend);
+        if (!sendWithGso(peerAddr, data + off, n, segSize)) {
+            break;
+        }
+        off += n;
+    }
+    for (; off < len; off += segSize) {
+        sendTo(peerAddr, data + off, std::min(segSize, len - off));
+    }
+    flush();
+}
+
+bool UdpSocket::sendWithGso(const InetAddress& peerAddr, const char* data, size_t len, size_t segSize) {
+    // 只有一个数据报时不需要切分
+    if (len <= segSize) {
+        sendTo(peerAddr, data, len);
+        return true;
+    }
+    struct iovec vec;
+    vec.iov_base = const_cast<char*>(data);
+    vec.iov_len = len;
+    union {
+        char buf[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof control);
+    struct msghdr hdr;
+    memset(&hdr, 0, sizeof hdr);
+    hdr.msg_name = const_cast<sockaddr_in*>(peerAddr.getSockAddr());
+    hdr.msg_namelen = sizeof(sockaddr_in);
+    hdr.msg_iov = &vec;
+    hdr.msg_iovlen = 1;
+    hdr.msg_control = control.buf;
+    hdr.msg_controllen = sizeof control.buf;
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t gsoSize = static_cast<uint16_t>(segSize);
+    memcpy(CMSG_DATA(cmsg), &gsoSize, sizeof gsoSize);
+
+    ssize_t n = ::sendmsg(socket_.fd(), &hdr, 0);
+    if (n >= 0) {
+        numSent_.fetch_add(static_cast<int64_t>((len + segSize - 1) / segSize), std::memory_order_relaxed);
+        return true;
+    }
+    int savedErrno = errno;
+    if (savedErrno == EAGAIN || savedErrno == EWOULDBLOCK) {
+        // 发送缓冲区满，这一段丢弃，与flush()的处理一致
+        numSendDropped_.fetch_add(static_cast<int64_t>((len + segSize - 1) / segSize), std::memory_order_relaxed);
+        return true;
+    }
+    // 内核不认识UDP_SEGMENT(ENOPROTOOPT/EINVAL)或出口网卡不支持校验和卸载(EIO)，以后都不再尝试
+    LOG_WARN << "UdpSocket fd " << socket_.fd() << " UDP_SEGMENT unavailable, errno " << savedErrno
+             << ", falling back to sendmmsg";
+    gsoEnabled_ = false;
+    return false;
+}
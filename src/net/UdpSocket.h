@@ -0,0 +1,132 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Socket.h"
+#include "Channel.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class EventLoop;
+
+// 收到的一个数据报，data指向UdpSocket的接收环，只在批量回调期间有效
+struct Datagram {
+    const char* data;
+    size_t len;
+    InetAddress peerAddr;
+};
+
+/**
+ * 绑定在一个EventLoop上的非阻塞UDP socket
+ * @details 可读时用recvmmsg一次收一批数据报到预先分配的接收环(batchSize个槽位，每个maxDatagramSize字节)，
+ * 整批交给DatagramBatchCallback；回调中sendTo()的数据报先放进发送环，回调返回后用sendmmsg一次发出。
+ * 开启GRO(UDP_GRO)后内核把同一流的多个数据报合并成一个最大64KB的缓冲区交上来，这里按gso_size切回单个数据报，
+ * 此时每个槽位是64KB。sendSegmented()用GSO(UDP_SEGMENT)把一大块数据一次交给内核切成多个数据报。
+ * 内核或网卡不支持GRO/GSO时自动退回普通的收发。
+ * 除统计数据外，所有成员函数都只能在所属loop线程中调用
+ */
+class UdpSocket : noncopyable {
+public:
+    using DatagramBatchCallback = std::function<void(UdpSocket*, const std::vector<Datagram>&, Timestamp)>;
+
+    static const int kDefaultBatchSize = 64;
+    static const size_t kDefaultMaxDatagramSize = 2048;
+    // GRO合并后的缓冲区和一次GSO发送的上限
+    static const size_t kMaxCoalescedSize = 65535;
+    // 一次GSO发送最多切成的数据报个数(内核的UDP_MAX_SEGMENTS)
+    static const int kMaxSegments = 64;
+
+    /**
+     * @param reuseport 以SO_REUSEPORT绑定，多个loop各有一个socket绑定同一地址，由内核按四元组分配数据报
+     * @param gro 请求开启UDP_GRO，内核不支持时groEnabled()为false
+     */
+    UdpSocket(EventLoop* loop, const InetAddress& bindAddr, bool reuseport,
+              int batchSize = kDefaultBatchSize,
+              size_t maxDatagramSize = kDefaultMaxDatagramSize,
+              bool gro = false);
+    ~UdpSocket();
+
+    EventLoop* getLoop() const { return loop_; }
+    int fd() const { return socket_.fd(); }
+    bool groEnabled() const { return groEnabled_; }
+    bool gsoEnabled() const { return gsoEnabled_; }
+
+    void setBatchCallback(DatagramBatchCallback cb) { batchCallback_ = std::move(cb); }
+    // 开始接收
+    void start();
+    // 见Socket::attachReusePortCpuSteering()，在组内所有socket都bind之后调用
+    bool attachReusePortCpuSteering(int groupSize) { return socket_.attachReusePortCpuSteering(groupSize); }
+
+    /**
+     * 把数据报放进发送环，批量回调返回后或发送环满时一起发出；在回调之外调用需要自己flush()
+     * @details 数据被拷贝，调用返回后data可以复用；超过maxDatagramSize的数据报直接sendto
+     */
+    void sendTo(const InetAddress& peerAddr, const char* data, size_t len);
+    /**
+     * 把data按segSize切成多个数据报发给peerAddr，最后一个可以不足segSize
+     * @details 支持GSO时每次一个sendmsg最多发kMaxSegments个或kMaxCoalescedSize字节；
+     * 第一次发送失败(EIO/EINVAL等，网卡不支持校验和卸载)后关闭GSO，之后退回sendTo()
+     */
+    void sendSegmented(const InetAddress& peerAddr, const char* data, size_t len, size_t segSize);
+    // 用sendmmsg发出发送环中的所有数据报，发送缓冲区满时丢弃剩下的，计入numSendDropped()
+    void flush();
+
+    // 统计数据，可以在任意线程读取
+    int64_t numReceived() const { return numReceived_.load(std::memory_order_relaxed); }
+    int64_t numReceiveBatches() const { return numReceiveBatches_.load(std::memory_order_relaxed); }
+    // 超过槽位大小被截断的数据报
+    int64_t numTruncated() const { return numTruncated_.load(std::memory_order_relaxed); }
+    int64_t numSent() const { return numSent_.load(std::memory_order_relaxed); }
+    int64_t numSendDropped() const { return numSendDropped_.load(std::memory_order_relaxed); }
+
+private:
+    void handleRead(Timestamp receiveTime);
+    // 一次recvmmsg，把收到的数据报(GRO合并的已切开)放进datagrams_，返回recvmmsg的结果
+    int receiveBatch();
+    // 用GSO发送不超过一次上限的一段，失败时返回false
+    bool sendWithGso(const InetAddress& peerAddr, const char* data, size_t len, size_t segSize);
+
+    // 发送环中的一个数据报，数据在txData_[offset, offset + len)
+    struct PendingSend {
+        sockaddr_in peerAddr;
+        size_t offset;
+        size_t len;
+    };
+
+    EventLoop* loop_;
+    Socket socket_;
+    Channel channel_;
+    const int batchSize_;
+    const size_t maxDatagramSize_;
+    bool groEnabled_;
+    bool gsoEnabled_;
+    const size_t slotSize_;
+    DatagramBatchCallback batchCallback_;
+
+    // 接收环：batchSize_个槽位，每个槽位的数据、地址和控制消息缓冲区，在构造时一次分配，recvmmsg直接填充
+    std::unique_ptr<char[]> rxData_;
+    std::vector<struct mmsghdr> rxMsgs_;
+    std::vector<struct iovec> rxIovecs_;
+    std::vector<sockaddr_in> rxAddrs_;
+    std::unique_ptr<char[]> rxControl_;
+    std::vector<Datagram> datagrams_;  // 交给回调的一批，复用
+
+    // 发送环
+    std::vector<PendingSend> pending_;
+    std::vector<char> txData_;
+    std::vector<struct mmsghdr> txMsgs_;
+    std::vector<struct iovec> txIovecs_;
+
+    std::atomic<int64_t> numReceived_;
+    std::atomic<int64_t> numReceiveBatches_;
+    std::atomic<int64_t> numTruncated_;
+    std::atomic<int64_t> numSent_;
+    std::atomic<int64_t> numSendDropped_;
+};
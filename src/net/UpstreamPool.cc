@@ -0,0 +1,164 @@
+#include "UpstreamPool.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "SocketsOps.h"
+#include "TcpConnection.h"
+#include "Logging.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <algorithm>
+
+const size_t UpstreamPool::kDefaultMaxConnections;
+const size_t UpstreamPool::kDefaultMaxIdle;
+
+namespace {
+
+// 连接池先于连接销毁时，连接关闭后只需要在它的loop中销毁
+void destroyConnection(EventLoop* loop, const TcpConnectionPtr& conn) {
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+} // namespace
+
+UpstreamPool::UpstreamPool(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg)
+    : loop_(loop),
+      serverAddr_(serverAddr),
+      name_(nameArg),
+      connNamePrefix_(std::make_shared<const std::string>(nameArg + ":" + serverAddr.toIpPort())),
+      maxConnections_(kDefaultMaxConnections),
+      maxIdle_(kDefaultMaxIdle),
+      connectTimeout_(Connector::kDefaultConnectTimeout),
+      maxRetries_(2),
+      connectionCallback_([](const TcpConnectionPtr&) {}),
+      messageCallback_([](const TcpConnectionPtr&, Buffer* buf, Timestamp) { buf->retrieveAll(); }),
+      nextConnId_(1) {
+}
+
+UpstreamPool::~UpstreamPool() {
+    assert(loop_->isInLoopThread());
+    for (auto& item : connectors_) {
+        item.second->stop();
+    }
+    for (auto& item : connections_) {
+        // 被借出的连接可能比连接池活得久，关闭时不能再回调this
+        const TcpConnectionPtr& conn = item.second;
+        conn->setCloseCallback(std::bind(&destroyConnection, loop_, _1));
+        conn->forceClose();
+    }
+    std::deque<AcquireCallback> waiters;
+    waiters.swap(waiters_);
+    for (AcquireCallback& cb : waiters) {
+        cb(TcpConnectionPtr());
+    }
+}
+
+void UpstreamPool::prewarm(size_t n) {
+    assert(loop_->isInLoopThread());
+    n = std::min(n, maxConnections_);
+    while (connections_.size() + connectors_.size() < n) {
+        startConnect();
+    }
+}
+
+void UpstreamPool::acquire(AcquireCallback cb) {
+    assert(loop_->isInLoopThread());
+    while (!idle_.empty()) {
+        TcpConnectionPtr conn(std::move(idle_.back()));
+        idle_.pop_back();
+        if (conn->connected()) {
+            cb(conn);
+            return;
+        }
+    }
+    waiters_.push_back(std::move(cb));
+    // 正在建立的连接不够分给所有等待者时，再新建一个
+    if (connectors_.size() < waiters_.size() &&
+        connections_.size() + connectors_.size() < maxConnections_) {
+        startConnect();
+    }
+}
+
+void UpstreamPool::release(const TcpConnectionPtr& conn) {
+    assert(loop_->isInLoopThread());
+    if (!conn->connected() || connections_.find(conn.get()) == connections_.end()) {
+        return;
+    }
+    handOut(conn);
+}
+
+void UpstreamPool::handOut(const TcpConnectionPtr& conn) {
+    if (!waiters_.empty()) {
+        AcquireCallback cb(std::move(waiters_.front()));
+        waiters_.pop_front();
+        cb(conn);
+    } else if (idle_.size() < maxIdle_) {
+        idle_.push_back(conn);
+    } else {
+        // 空闲连接太多，关闭多余的，关闭后由removeConnection()移出池
+        conn->shutdown();
+    }
+}
+
+void UpstreamPool::startConnect() {
+    std::shared_ptr<Connector> connector(std::make_shared<Connector>(loop_, serverAddr_));
+    Connector* key = connector.get();
+    connector->setConnectTimeout(connectTimeout_);
+    connector->setMaxRetries(maxRetries_);
+    connector->setNewConnectionCallback([this, key](int sockfd) { newConnection(key, sockfd); });
+    connector->setConnectFailedCallback([this, key]() { connectFailed(key); });
+    connectors_[key] = connector;
+    connector->start();
+}
+
+void UpstreamPool::releaseConnector(Connector* connector) {
+    auto it = connectors_.find(connector);
+    if (it != connectors_.end()) {
+        // 正在connector的回调中，移到任务队列中释放
+        loop_->queueInLoop([dead = std::move(it->second)]() {});
+        connectors_.erase(it);
+    }
+}
+
+void UpstreamPool::newConnection(Connector* connector, int sockfd) {
+    releaseConnector(connector);
+    struct sockaddr_in6 peer = sockets::getPeerAddr(sockfd);
+    struct sockaddr_in6 local = sockets::getLocalAddr(sockfd);
+    InetAddress peerAddr(*sockets::sockaddr_in_cast(sockets::sockaddr_cast(&peer)));
+    InetAddress localAddr(*sockets::sockaddr_in_cast(sockets::sockaddr_cast(&local)));
+    TcpConnectionPtr conn(TcpConnection::create(loop_, connNamePrefix_, nextConnId_, sockfd, localAddr, peerAddr));
+    ++nextConnId_;
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setCloseCallback([this](const TcpConnectionPtr& c) { removeConnection(c); });
+    connections_[conn.get()] = conn;
+    conn->connectEstablished();
+    handOut(conn);
+}
+
+void UpstreamPool::connectFailed(Connector* connector) {
+    releaseConnector(connector);
+    //log
+    LOG_WARN << "UpstreamPool::connectFailed[" << name_ << "] - " << serverAddr_.toIpPort();
+    // 没有任何连接也没有正在建立的连接时，上游不可用，所有等待者都失败；否则只让一个等待者失败
+    size_t fail = (connections_.empty() && connectors_.empty()) ? waiters_.size() : std::min<size_t>(1, waiters_.size());
+    for (size_t i = 0; i < fail; ++i) {
+        AcquireCallback cb(std::move(waiters_.front()));
+        waiters_.pop_front();
+        cb(TcpConnectionPtr());
+    }
+}
+
+void UpstreamPool::removeConnection(const TcpConnectionPtr& conn) {
+    connections_.erase(conn.get());
+    auto it = std::find(idle_.begin(), idle_.end(), conn);
+    if (it != idle_.end()) {
+        idle_.erase(it);
+    }
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    // 还有等待者时补上一个连接
+    if (connectors_.size() < waiters_.size() &&
+        connections_.size() + connectors_.size() < maxConnections_) {
+        startConnect();
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Callbacks.h"
+#include "InetAddress.h"
+
+#include <stddef.h>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Connector;
+class EventLoop;
+
+/**
+ * 一个loop上到同一个上游服务的连接池，每个IO loop各建一个(例如在TcpServer的ThreadInitCallback中)。
+ * 请求处理路径在自己的loop中acquire()一个已经建立的连接，用完release()归还，
+ * 既不需要每次三次握手，也不需要跨线程：池中的连接都属于同一个loop，所有操作都只能在这个loop线程中调用。
+ * 没有空闲连接时，若连接数未达上限就新建连接(Connector，带超时和重试)，否则排队等待归还的连接。
+ * 空闲连接后进先出，最近用过的连接优先复用；空闲时被对端关闭的连接会自动移出池。
+ */
+class UpstreamPool : noncopyable {
+public:
+    // 得到一个可用的连接；连接失败时参数为nullptr
+    using AcquireCallback = std::function<void(const TcpConnectionPtr&)>;
+
+    UpstreamPool(EventLoop* loop, const InetAddress& serverAddr, const std::string& nameArg);
+    ~UpstreamPool();
+
+    // 以下设置在使用之前调用
+    void setMaxConnections(size_t n) { maxConnections_ = n; }
+    void setMaxIdle(size_t n) { maxIdle_ = n; }
+    void setConnectTimeout(double seconds) { connectTimeout_ = seconds; }
+    // 每次新建连接失败后的重试次数
+    void setMaxRetries(int n) { maxRetries_ = n; }
+    // 池中所有连接共用的回调
+    void setConnectionCallback(ConnectionCallback cb) { connectionCallback_ = std::move(cb); }
+    void setMessageCallback(MessageCallback cb) { messageCallback_ = std::move(cb); }
+
+    // 预先建立n个空闲连接
+    void prewarm(size_t n);
+    // 取得一个连接，有空闲连接时cb立即在当前调用中执行
+    void acquire(AcquireCallback cb);
+    // 归还acquire()得到的连接，已经断开的连接直接丢弃
+    void release(const TcpConnectionPtr& conn);
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+    size_t numConnections() const { return connections_.size(); }
+    size_t numIdle() const { return idle_.size(); }
+    size_t numConnecting() const { return connectors_.size(); }
+    size_t numWaiters() const { return waiters_.size(); }
+
+    static const size_t kDefaultMaxConnections = 64;
+    static const size_t kDefaultMaxIdle = 16;
+
+private:
+    void startConnect();
+    void newConnection(Connector* connector, int sockfd);
+    void connectFailed(Connector* connector);
+    // connector的回调返回之后才释放它
+    void releaseConnector(Connector* connector);
+    void removeConnection(const TcpConnectionPtr& conn);
+    // 交给第一个等待者，没有等待者时放回空闲列表
+    void handOut(const TcpConnectionPtr& conn);
+
+    EventLoop* loop_;
+    const InetAddress serverAddr_;
+    const std::string name_;
+    // 连接名称的前缀"name:ip:port"，所有连接共用
+    const std::shared_ptr<const std::string> connNamePrefix_;
+    size_t maxConnections_;
+    size_t maxIdle_;
+    double connectTimeout_;
+    int maxRetries_;
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    int64_t nextConnId_;
+
+    // 已建立的连接，包括空闲的和被借出的
+    std::unordered_map<TcpConnection*, TcpConnectionPtr> connections_;
+    std::vector<TcpConnectionPtr> idle_;
+    std::unordered_map<Connector*, std::shared_ptr<Connector>> connectors_;
+    std::deque<AcquireCallback> waiters_;
+};
@@ -1,15 +1,24 @@
 #include "Poller.h"
 #include "EpollPoller.h"
+#include "IoUringPoller.h"
+#include "Logging.h"
 
 #include <stdlib.h>
 
 // 获取默认的Poller
-Poller* Poller::newDefaultPoller(EventLoop *loop){
-    if (::getenv("MUDUO_USE_POLL")) {
-        // 生成poll实例
-        return nullptr;
-    } else {
-        // 生成epoll实例
-        return new EpollPoller(loop);
+Poller* Poller::newDefaultPoller(EventLoop *loop, Type type){
+    if (type == kDefault) {
+        type = ::getenv("MUDUO_USE_IOURING") ? kIoUring : kEpoll;
     }
+    if (type == kIoUring) {
+        // 生成io_uring实例，内核不支持时退回epoll
+        IoUringPoller* poller = new IoUringPoller(loop);
+        if (poller->valid()) {
+            return poller;
+        }
+        delete poller;
+        LOG_WARN << "Poller::newDefaultPoller io_uring not supported, fall back to epoll";
+    }
+    // 生成epoll实例
+    return new EpollPoller(loop);
 }
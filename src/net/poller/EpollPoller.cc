@@ -1,11 +1,11 @@
 #include "EpollPoller.h"
 #include "Channel.h"
 #include "CurrentThread.h"
+#include "Logging.h"
 
 #include <errno.h>
 #include <assert.h>
 #include <string.h>
-#include <iostream>
 
 const int EpollPoller::kInitEventListSize;
 
@@ -39,9 +39,7 @@ EpollPoller::EpollPoller(EventLoop* loop)
       epollfd_(::epoll_create1(EPOLL_CLOEXEC)),
       events_(kInitEventListSize){
     if (epollfd_ < 0) {
-        //log
-        std::cout << "EPollPoller::EPollPoller" << std::endl;
-        std::cout << "epoll_create() error:" << errno <<std::endl;
+        LOG_ERROR << "EPollPoller::EPollPoller epoll_create() error:" << errno;
     }
 }
 
@@ -51,13 +49,13 @@ EpollPoller::~EpollPoller() {
 
 Timestamp EpollPoller::poll(int timeoutMs, ChannelList& activeChannels) {
     // 高并发情况经常被调用，影响效率，使用debug模式可以手动关闭
-    std::cout << "fd total count " << channels_.size() <<std::endl;
+    LOG_TRACE << "fd total count " << numChannels();
     int numEvents = epoll_wait(epollfd_, &*events_.begin(), events_.size(), timeoutMs);
     int savedErrno = errno;
     Timestamp now(Timestamp::now());
     if (numEvents > 0) {
         //log
-        std::cout << numEvents << " events happend" <<std::endl;
+        LOG_TRACE << numEvents << " events happend";
         fillActiveChannels(numEvents, activeChannels);
         if (numEvents == events_.size()) {
             //如果当前events已被填满，则扩充空间
@@ -65,20 +63,20 @@ Timestamp EpollPoller::poll(int timeoutMs, ChannelList& activeChannels) {
         }
     } else if(numEvents == 0) {
         //log
-        std::cout << "nothing happended,timeout" <<std::endl;
+        LOG_TRACE << "nothing happended,timeout";
     } else {
         if(savedErrno != EINTR){
             errno = savedErrno;
-            std::cout << "EpollPoller::poll() failed" << std::endl;
+            LOG_ERROR << "EpollPoller::poll() failed";
         }
     }
     return now;
 }
 
-// 填写活跃的Channel
+// 填写活跃的Channel，注册时data.ptr中保存的就是Channel*，不需要再按fd查找
 void EpollPoller::fillActiveChannels(int numEvents, ChannelList& activeChannels) const {
     for (int i = 0; i < numEvents; ++i) {
-        Channel* channel = channels_.find(events_[i].data.fd)->second;
+        Channel* channel = static_cast<Channel*>(events_[i].data.ptr);
         channel->set_revents(events_[i].events);
         activeChannels.push_back(channel);
     }
@@ -90,11 +88,10 @@ void EpollPoller::updateChannel(Channel* channel) {
     if (index == kNew || index == kDeleted) {
         int fd = channel->fd();
         if (index == kNew) {
-            channels_[fd] = channel;
+            addChannelEntry(channel);
         }else{
             //index==kDeleted，只是从epoll例程中被删除了，还在channels中
-            assert(channels_.find(fd) != channels_.end());
-            assert(channels_[fd] == channel);
+            assert(channelOf(fd) == channel);
         }
         // 修改channel的状态，此时是已添加状态
         channel->set_index(kAdded);
@@ -118,27 +115,26 @@ void EpollPoller::update(int operation, Channel* channel) {
     ::memset(&event, 0, sizeof event);
     int fd = channel->fd();
     event.events = channel->events();
+    // data是union，只保存Channel*，epoll_wait返回时直接带回
     event.data.ptr = channel;
-    event.data.fd = fd;
     //log
     if (operation == EPOLL_CTL_DEL) {
         if (::epoll_ctl(epollfd_, operation, fd, NULL) < 0) {
-            std::cout << "epol_ctl op= "<< operationToString(operation) << std::endl;
+            LOG_ERROR << "epol_ctl op= "<< operationToString(operation);
         }
     } else {
         if (::epoll_ctl(epollfd_, operation, fd, &event) < 0) {
-            std::cout << "epoll_ctl op= "<< operationToString(operation) << std::endl;
+            LOG_ERROR << "epoll_ctl op= "<< operationToString(operation);
         }
-        std::cout << "successfully " << operationToString(operation) << " in pid= "<< CurrentThread::tid() <<std::endl;
+        LOG_TRACE << "successfully " << operationToString(operation) << " in pid= "<< CurrentThread::tid();
     }
 }
 
 //永久删除某个Channel对象，包括从epoll例程和channels_中都删除
 void EpollPoller::removeChannel(Channel* channel) {
-    int fd = channel->fd();
     int index = channel->index();
     assert(index == kAdded || index == kDeleted);
-    channels_.erase(fd);
+    removeChannelEntry(channel);
     if (index == kAdded) {
          // 如果此fd已经被添加到epoll例程中，则还需从epoll例程中删除
         update(EPOLL_CTL_DEL, channel);
@@ -0,0 +1,298 @@
+#include "IoUringPoller.h"
+#include "Channel.h"
+#include "Logging.h"
+
+#include <errno.h>
+#include <assert.h>
+#include <algorithm>
+#include <poll.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+const unsigned IoUringPoller::kRingEntries;
+
+namespace {
+// 与EpollPoller一致，Channel::index()为kNew表示还没有加入poller
+const int kNew = -1;
+const int kAdded = 1;
+
+// POLL_REMOVE请求自己的完成事件使用这个user_data，直接忽略
+const uint64_t kCancelUserData = ~static_cast<uint64_t>(0);
+
+// Channel关注的事件中交给poll请求的部分，边缘触发标志由multishot体现
+const int kPollMask = POLLIN | POLLPRI | POLLOUT;
+
+int ioUringSetup(unsigned entries, struct io_uring_params* p) {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+}
+
+int ioUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, void* arg, size_t argSize) {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+}
+
+IoUringPoller::IoUringPoller(EventLoop* loop)
+    : Poller(loop),
+      ringFd_(-1),
+      ringPtr_(MAP_FAILED),
+      ringSize_(0),
+      sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+      sqesSize_(0),
+      nextGeneration_(1),
+      round_(0) {
+    if (!setupRing()) {
+        //log
+        LOG_WARN << "IoUringPoller::IoUringPoller io_uring unavailable, errno:" << errno;
+        if (ringFd_ >= 0) {
+            ::close(ringFd_);
+            ringFd_ = -1;
+        }
+    }
+}
+
+IoUringPoller::~IoUringPoller() {
+    if (sqes_ != MAP_FAILED) {
+        ::munmap(sqes_, sqesSize_);
+    }
+    if (ringPtr_ != MAP_FAILED) {
+        ::munmap(ringPtr_, ringSize_);
+    }
+    if (ringFd_ >= 0) {
+        // 关闭ring会取消所有还未完成的poll请求
+        ::close(ringFd_);
+    }
+}
+
+/**
+ * 创建io_uring并映射提交/完成队列。
+ * SINGLE_ISSUER和DEFER_TASKRUN让完成事件只在本线程调用io_uring_enter时处理，减少内核与loop线程之间的打断；
+ * 老内核不支持这些标志时退回到最基本的设置。
+ */
+bool IoUringPoller::setupRing() {
+    ::memset(&params_, 0, sizeof params_);
+    params_.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL |
+                    IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    params_.cq_entries = kRingEntries * 4;
+    ringFd_ = ioUringSetup(kRingEntries, &params_);
+    if (ringFd_ < 0 && errno == EINVAL) {
+        ::memset(&params_, 0, sizeof params_);
+        params_.flags = IORING_SETUP_CQSIZE;
+        params_.cq_entries = kRingEntries * 4;
+        ringFd_ = ioUringSetup(kRingEntries, &params_);
+    }
+    if (ringFd_ < 0) {
+        return false;
+    }
+    // EXT_ARG(5.11)用于带超时的等待，RSRC_TAGS(5.13)与multishot poll同一版本加入，用来判断内核是否支持multishot
+    const unsigned required = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+                              IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+    if ((params_.features & required) != required) {
+        errno = ENOSYS;
+        return false;
+    }
+
+    // SINGLE_MMAP: 提交队列和完成队列共用一次映射
+    size_t sqSize = params_.sq_off.array + params_.sq_entries * sizeof(unsigned);
+    size_t cqSize = params_.cq_off.cqes + params_.cq_entries * sizeof(struct io_uring_cqe);
+    ringSize_ = sqSize > cqSize ? sqSize : cqSize;
+    ringPtr_ = ::mmap(nullptr, ringSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ringFd_, IORING_OFF_SQ_RING);
+    if (ringPtr_ == MAP_FAILED) {
+        return false;
+    }
+    sqesSize_ = params_.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqes = ::mmap(nullptr, sqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringFd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        return false;
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes);
+
+    char* ring = static_cast<char*>(ringPtr_);
+    sqHead_ = reinterpret_cast<unsigned*>(ring + params_.sq_off.head);
+    sqTail_ = reinterpret_cast<unsigned*>(ring + params_.sq_off.tail);
+    sqArray_ = reinterpret_cast<unsigned*>(ring + params_.sq_off.array);
+    sqMask_ = *reinterpret_cast<unsigned*>(ring + params_.sq_off.ring_mask);
+    sqEntries_ = params_.sq_entries;
+    cqHead_ = reinterpret_cast<unsigned*>(ring + params_.cq_off.head);
+    cqTail_ = reinterpret_cast<unsigned*>(ring + params_.cq_off.tail);
+    cqMask_ = *reinterpret_cast<unsigned*>(ring + params_.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(ring + params_.cq_off.cqes);
+    return true;
+}
+
+/**
+ * 没有使用SQPOLL，内核只在io_uring_enter中读取提交队列，
+ * 所以可以先移动队尾再填写SQE，只要在下一次io_uring_enter之前填好即可
+ */
+struct io_uring_sqe* IoUringPoller::getSqe() {
+    unsigned tail = *sqTail_;
+    if (tail - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_) {
+        // 提交队列已满，先提交，不等待完成事件
+        ioUringEnter(ringFd_, tail - *sqHead_, 0, 0, nullptr, 0);
+    }
+    unsigned index = tail & sqMask_;
+    struct io_uring_sqe* sqe = &sqes_[index];
+    ::memset(sqe, 0, sizeof *sqe);
+    sqArray_[index] = index;
+    __atomic_store_n(sqTail_, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+void IoUringPoller::markDirty(int fd, PollState& state) {
+    if (!state.dirty) {
+        state.dirty = true;
+        dirtyFds_.push_back(fd);
+    }
+}
+
+void IoUringPoller::armPoll(int fd, PollState& state, int events, bool multishot) {
+    state.generation = nextGeneration_++;
+    state.armedEvents = events;
+    state.multishot = multishot;
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = static_cast<uint32_t>(events);
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = encode(fd, state.generation);
+}
+
+void IoUringPoller::cancelPoll(int fd, PollState& state) {
+    struct io_uring_sqe* sqe = getSqe();
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = encode(fd, state.generation);
+    sqe->user_data = kCancelUserData;
+    // 换一个编号，在POLL_REMOVE生效之前旧请求产生的完成事件都会被丢弃
+    state.generation = nextGeneration_++;
+    state.armedEvents = 0;
+}
+
+/**
+ * 把这一轮中关注事件有变化的channel同步到内核，
+ * 同一轮中多次enableWriting()/disableWriting()只会产生最终状态对应的请求
+ */
+void IoUringPoller::flushChanges() {
+    for (int fd : dirtyFds_) {
+        PollState* found = stateOf(fd);
+        if (found == nullptr || !found->dirty) {
+            // 已经被removeChannel()删除，或者同一个fd被重复记录
+            continue;
+        }
+        PollState& state = *found;
+        state.dirty = false;
+        Channel* channel = state.channel;
+        int events = channel->events() & kPollMask;
+        bool multishot = channel->edgeTriggered();
+        if (state.armedEvents == events && state.multishot == multishot) {
+            continue;
+        }
+        if (state.armedEvents != 0) {
+            cancelPoll(fd, state);
+        }
+        if (events != 0) {
+            armPoll(fd, state, events, multishot);
+        }
+    }
+    dirtyFds_.clear();
+}
+
+void IoUringPoller::submitAndWait(int timeoutMs) {
+    struct io_uring_getevents_arg arg;
+    ::memset(&arg, 0, sizeof arg);
+    struct __kernel_timespec ts;
+    if (timeoutMs >= 0) {
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = static_cast<long long>(timeoutMs % 1000) * 1000 * 1000;
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+    }
+    unsigned toSubmit = *sqTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+    // 完成队列中已经有事件时不等待
+    unsigned waitNr = (__atomic_load_n(cqTail_, __ATOMIC_ACQUIRE) != *cqHead_) ? 0 : 1;
+    int ret = ioUringEnter(ringFd_, toSubmit, waitNr,
+                           IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof arg);
+    if (ret < 0 && errno != ETIME && errno != EINTR) {
+        //log
+        LOG_ERROR << "IoUringPoller::poll() io_uring_enter failed:" << errno;
+    }
+}
+
+Timestamp IoUringPoller::poll(int timeoutMs, ChannelList& activeChannels) {
+    flushChanges();
+    submitAndWait(timeoutMs);
+    Timestamp now(Timestamp::now());
+    ++round_;
+    fillActiveChannels(activeChannels);
+    return now;
+}
+
+void IoUringPoller::fillActiveChannels(ChannelList& activeChannels) {
+    unsigned head = *cqHead_;
+    unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        const struct io_uring_cqe& cqe = cqes_[head & cqMask_];
+        if (cqe.user_data == kCancelUserData) {
+            continue;
+        }
+        int fd = static_cast<int>(cqe.user_data & 0xffffffff);
+        uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32);
+        PollState* found = stateOf(fd);
+        if (found == nullptr || found->generation != generation) {
+            // 已经取消或替换的旧请求
+            continue;
+        }
+        PollState& state = *found;
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            // 请求已经结束：一次性poll每次都会结束，multishot也可能因为出错而结束，下一轮重新提交
+            state.armedEvents = 0;
+            markDirty(fd, state);
+        }
+        if (cqe.res < 0) {
+            if (cqe.res != -ECANCELED) {
+                //log
+                LOG_ERROR << "IoUringPoller poll request on fd " << fd << " failed:" << -cqe.res;
+            }
+            continue;
+        }
+        Channel* channel = state.channel;
+        if (state.activeRound == round_) {
+            // 同一轮中multishot产生了多个完成事件，合并到一起
+            channel->set_revents(channel->revents() | cqe.res);
+        } else {
+            state.activeRound = round_;
+            channel->set_revents(cqe.res);
+            activeChannels.push_back(channel);
+        }
+    }
+    __atomic_store_n(cqHead_, head, __ATOMIC_RELEASE);
+}
+
+void IoUringPoller::updateChannel(Channel* channel) {
+    int fd = channel->fd();
+    if (channel->index() == kNew) {
+        addChannelEntry(channel);
+        channel->set_index(kAdded);
+        if (static_cast<size_t>(fd) >= states_.size()) {
+            states_.resize(std::max(static_cast<size_t>(fd) + 1, states_.size() * 2));
+        }
+        states_[fd].channel = channel;
+    }
+    PollState& state = states_[fd];
+    markDirty(fd, state);
+}
+
+void IoUringPoller::removeChannel(Channel* channel) {
+    int fd = channel->fd();
+    assert(channel->index() == kAdded);
+    removeChannelEntry(channel);
+    PollState& state = states_[fd];
+    if (state.armedEvents != 0) {
+        // fd可能马上被关闭并复用，旧请求按user_data取消，与fd无关
+        cancelPoll(fd, state);
+    }
+    state = PollState();
+    channel->set_index(kNew);
+}
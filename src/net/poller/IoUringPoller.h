@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Poller.h"
+#include "Timestamp.h"
+
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <vector>
+
+class Channel;
+
+/**
+ * 基于io_uring的Poller，用IORING_OP_POLL_ADD请求代替epoll_ctl/epoll_wait。
+ * 直接使用io_uring_setup/io_uring_enter系统调用，不依赖liburing。
+ * 1) 边缘触发的Channel使用multishot poll(IORING_POLL_ADD_MULTI)，注册一次后每次就绪都产生一个完成事件；
+ * 2) 水平触发的Channel使用一次性poll，完成后在下一次poll()中重新提交，
+ *    内核提交时会立即检查就绪状态，所以语义与水平触发的epoll一致；
+ * 3) updateChannel()/removeChannel()只是记录变化，在下一次poll()中合并成POLL_ADD/POLL_REMOVE请求，
+ *    与等待完成事件一起用一次io_uring_enter提交，enableWriting()/disableWriting()不再各自产生一次系统调用。
+ * 每个poll请求的user_data由fd和递增的编号组成，编号不一致的完成事件是已经取消或替换的旧请求产生的，直接丢弃。
+ * 只能在所属loop线程中使用。
+ */
+class IoUringPoller : public Poller {
+public:
+    explicit IoUringPoller(EventLoop* loop);
+    ~IoUringPoller() override;
+
+    // 内核不支持需要的特性(multishot poll、IORING_ENTER_EXT_ARG等)时返回false，此时应该改用EpollPoller
+    bool valid() const { return ringFd_ >= 0; }
+
+    Timestamp poll(int timeoutMs, ChannelList& activeChannels) override;
+    void updateChannel(Channel* channel) override;
+    void removeChannel(Channel* channel) override;
+
+private:
+    // 提交队列的大小，完成队列是它的4倍
+    static const unsigned kRingEntries = 1024;
+
+    // 每个fd上poll请求的状态
+    struct PollState {
+        Channel* channel = nullptr;  // nullptr表示fd没有注册
+        uint32_t generation = 0;   // 当前有效请求的编号
+        int armedEvents = 0;       // 已提交给内核的事件，0表示当前没有poll请求
+        bool multishot = false;
+        bool dirty = false;        // 已在dirtyFds_中，等待下一次poll()同步到内核
+        int64_t activeRound = -1;  // 最近一次被放入activeChannels的轮次，用于合并同一轮的多个完成事件
+    };
+
+    bool setupRing();
+    // 取得一个空闲的SQE，提交队列满时先提交一次
+    struct io_uring_sqe* getSqe();
+    void markDirty(int fd, PollState& state);
+    // fd对应的状态，fd没有注册时返回nullptr
+    PollState* stateOf(int fd) {
+        return fd >= 0 && static_cast<size_t>(fd) < states_.size() && states_[fd].channel ? &states_[fd] : nullptr;
+    }
+    // 把关注事件有变化的channel同步成POLL_ADD/POLL_REMOVE请求
+    void flushChanges();
+    void armPoll(int fd, PollState& state, int events, bool multishot);
+    void cancelPoll(int fd, PollState& state);
+    // 提交所有请求，并等待至少一个完成事件或超时
+    void submitAndWait(int timeoutMs);
+    void fillActiveChannels(ChannelList& activeChannels);
+
+    static uint64_t encode(int fd, uint32_t generation) {
+        return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+    }
+
+    int ringFd_;
+    struct io_uring_params params_;
+    void* ringPtr_;
+    size_t ringSize_;
+    struct io_uring_sqe* sqes_;
+    size_t sqesSize_;
+
+    // 提交队列
+    unsigned* sqHead_;
+    unsigned* sqTail_;
+    unsigned* sqArray_;
+    unsigned sqMask_;
+    unsigned sqEntries_;
+    // 完成队列
+    unsigned* cqHead_;
+    unsigned* cqTail_;
+    unsigned cqMask_;
+    struct io_uring_cqe* cqes_;
+
+    uint32_t nextGeneration_;
+    int64_t round_;
+    // 以fd为下标的稠密数组，与Poller中的Channel登记表一样按fd直接索引
+    std::vector<PollState> states_;
+    std::vector<int> dirtyFds_;
+};
@@ -1,9 +1,28 @@
 #include "Poller.h"
 #include "Channel.h"
 
+#include <assert.h>
+#include <algorithm>
+
 Poller::Poller(EventLoop* loop):ownerLoop_(loop){}
 
 bool Poller::hasChannel(Channel* channel){
-    ChannelMap::iterator res = channels_.find(channel->fd());
-    return res != channels_.end() && channel == res->second;
-}
\ No newline at end of file
+    return channelOf(channel->fd()) == channel;
+}
+
+void Poller::addChannelEntry(Channel* channel) {
+    size_t fd = static_cast<size_t>(channel->fd());
+    if (fd >= channels_.size()) {
+        // 按2倍扩容，fd增长时均摊O(1)
+        channels_.resize(std::max(fd + 1, channels_.size() * 2), nullptr);
+    }
+    assert(channels_[fd] == nullptr);
+    channels_[fd] = channel;
+    ++numChannels_;
+}
+
+void Poller::removeChannelEntry(Channel* channel) {
+    assert(hasChannel(channel));
+    channels_[channel->fd()] = nullptr;
+    --numChannels_;
+}
@@ -6,11 +6,18 @@
 // #include "EventLoop.h"
 
 #include <vector>
-#include <map>
 
 class Poller : noncopyable {
 public:
     using ChannelList = std::vector<Channel*>;
+
+    // poller的实现，kDefault根据环境变量选择：设置了MUDUO_USE_IOURING时使用io_uring，否则使用epoll
+    enum Type {
+        kDefault,
+        kEpoll,
+        kIoUring,  // 内核不支持时退回epoll
+    };
+
     explicit Poller(EventLoop* loop);
     virtual ~Poller() = default;
 
@@ -22,15 +29,23 @@ public:
     // 判断 channel是否注册到 poller当中
     virtual bool hasChannel(Channel* channel);
 
-    static Poller* newDefaultPoller(EventLoop* loop);
+    static Poller* newDefaultPoller(EventLoop* loop, Type type = kDefault);
 
 protected:
-    
-    // Channel: 该类型保存fd和需要监听的events，以及各种事件回调函数（可读/可写/错误/关闭等）
-    using ChannelMap = std::map<int, Channel*>;
-    // 保存所有事件的Channel，一个fd绑定一个Channel
-    ChannelMap channels_;
+    // 登记/注销fd对应的Channel，只用于hasChannel()和断言，事件分发时由poller直接带回Channel*
+    void addChannelEntry(Channel* channel);
+    void removeChannelEntry(Channel* channel);
+    Channel* channelOf(int fd) const {
+        return fd >= 0 && static_cast<size_t>(fd) < channels_.size() ? channels_[fd] : nullptr;
+    }
+    size_t numChannels() const { return numChannels_; }
 
 private:
+    // Channel: 该类型保存fd和需要监听的events，以及各种事件回调函数（可读/可写/错误/关闭等）
+    // 一个fd绑定一个Channel。fd是内核分配的最小可用整数，所以直接用以fd为下标的稠密数组，未使用的位置为nullptr
+    std::vector<Channel*> channels_;
+    size_t numChannels_ = 0;
+
+
     EventLoop* ownerLoop_;  // 它所属的EventLoop
 };
\ No newline at end of file
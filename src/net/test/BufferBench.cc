@@ -0,0 +1,138 @@
+#include "Buffer.h"
+#include "ChainBuffer.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 连续的Buffer与分块的ChainBuffer在大块数据上的对比
+// 以及大量空闲连接的输入缓冲区占用的内存
+// 用法: BufferBench [totalMB] [idleConns]
+
+// 输出缓冲区：每次追加16KB，每追加4次只写出一半(对端接收慢)，缓冲区在增长的同时被消费
+template <typename BufferT>
+double benchGrowAndDrain(BufferT& buf, size_t total) {
+    std::string chunk(16 * 1024, 'x');
+    size_t appended = 0;
+    int round = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    while (appended < total) {
+        buf.append(chunk.data(), chunk.size());
+        appended += chunk.size();
+        if (++round % 4 == 0) {
+            buf.retrieve(buf.readableBytes() / 2);
+        }
+    }
+    buf.retrieveAll();
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+// 输入缓冲区：对端一次发来total字节，全部读入后才处理(例如等完整的请求体)
+template <typename BufferT>
+double benchReadAll(BufferT& buf, size_t total) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    std::thread writer([&]() {
+        std::string chunk(64 * 1024, 'y');
+        size_t sent = 0;
+        while (sent < total) {
+            ssize_t n = ::write(fds[1], chunk.data(), std::min(chunk.size(), total - sent));
+            if (n <= 0) {
+                break;
+            }
+            sent += n;
+        }
+        ::shutdown(fds[1], SHUT_WR);
+    });
+    auto t0 = std::chrono::steady_clock::now();
+    int savedErrno = 0;
+    while (buf.readFd(fds[0], savedErrno) > 0) {
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    writer.join();
+    if (buf.readableBytes() != total) {
+        printf("read %zu bytes, expected %zu\n", buf.readableBytes(), total);
+    }
+    buf.retrieveAll();
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return std::chrono::duration<double, std::milli>(t1 - t0).count();
+}
+
+/**
+ * 空闲连接的输入缓冲区：每个连接收到一个200字节的请求，其中1%先收到一次256KB的突发，处理完后全部进入空闲
+ * @param adaptive false, 按之前TcpConnection的用法, 初始kInitialSize且从不收缩; true, 初始为空并在处理完后shrinkIfIdle()
+ * @return 所有缓冲区占用的堆内存
+ */
+size_t idleMemory(bool adaptive, int conns) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) < 0) {
+        perror("socketpair");
+        exit(1);
+    }
+    std::string request(200, 'r');
+    std::string burst(64 * 1024, 'b');
+    size_t before = mallinfo2().uordblks;
+    std::vector<Buffer> buffers;
+    buffers.reserve(conns);
+    int savedErrno = 0;
+    for (int i = 0; i < conns; ++i) {
+        buffers.emplace_back(adaptive ? 0 : Buffer::kInitialSize);
+        Buffer& buf = buffers.back();
+        if (i % 100 == 0) {
+            for (int j = 0; j < 4; ++j) {
+                ::write(fds[1], burst.data(), burst.size());
+                buf.readFd(fds[0], savedErrno);
+            }
+        }
+        ::write(fds[1], request.data(), request.size());
+        buf.readFd(fds[0], savedErrno);
+        buf.retrieveAll();
+        if (adaptive) {
+            buf.shrinkIfIdle();
+        }
+    }
+    size_t used = mallinfo2().uordblks - before;
+    ::close(fds[0]);
+    ::close(fds[1]);
+    return used;
+}
+
+int main(int argc, char* argv[]) {
+    size_t totalMB = argc > 1 ? atoi(argv[1]) : 50;
+    size_t total = totalMB * 1024 * 1024;
+    int idleConns = argc > 2 ? atoi(argv[2]) : 100000;
+
+    {
+        Buffer buf;
+        ChainBuffer chain;
+        double a = benchGrowAndDrain(buf, total);
+        double b = benchGrowAndDrain(chain, total);
+        printf("grow and drain %zuMB: Buffer %.1f ms, ChainBuffer %.1f ms\n", totalMB, a, b);
+    }
+    {
+        Buffer buf;
+        ChainBuffer chain;
+        double a = benchReadAll(buf, total);
+        double b = benchReadAll(chain, total);
+        printf("readFd %zuMB: Buffer %.1f ms, ChainBuffer %.1f ms\n", totalMB, a, b);
+    }
+    {
+        size_t eager = idleMemory(false, idleConns);
+        size_t adaptive = idleMemory(true, idleConns);
+        printf("%d idle connections: eager %.1f MB, adaptive %.1f MB, saved %.1f MB\n", idleConns,
+               eager / 1048576.0, adaptive / 1048576.0, (static_cast<double>(eager) - adaptive) / 1048576.0);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+// 连接频繁建立和断开：客户端不断connect后立即close，统计服务器每秒处理的连接数和每个连接的堆分配次数
+// 库的连接日志输出到stdout，结果输出到stderr
+// 用法: ChurnBench [connections] [ioThreads] > /dev/null
+
+static std::atomic<int64_t> g_allocs{0};
+
+void* operator new(size_t n) {
+    g_allocs.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(n ? n : 1);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+int main(int argc, char* argv[]) {
+    int total = argc > 1 ? atoi(argv[1]) : 20000;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 1;
+    const uint16_t port = 9981;
+
+    EventLoop loop;
+    TcpServer server(&loop, InetAddress(port), "churn");
+    server.setThreadNum(ioThreads);
+    std::atomic<int> closed{0};
+    server.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (!conn->connected() && closed.fetch_add(1) + 1 == total) {
+            loop.quit();
+        }
+    });
+    server.start();
+
+    int64_t allocsBefore = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    std::thread client([&]() {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        allocsBefore = g_allocs.load();
+        t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < total; ++i) {
+            int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) {
+                perror("connect");
+                exit(1);
+            }
+            // RST关闭，不留TIME_WAIT，避免耗尽本地端口
+            struct linger lg = {1, 0};
+            ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &lg, sizeof lg);
+            ::close(fd);
+        }
+    });
+    loop.loop();
+    auto t1 = std::chrono::steady_clock::now();
+    client.join();
+    double seconds = std::chrono::duration<double>(t1 - t0).count();
+    fprintf(stderr, "%d connections in %.2f s: %.0f conn/s, %.1f allocations per connection\n", total, seconds,
+            total / seconds, static_cast<double>(g_allocs.load() - allocsBefore) / total);
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include "EventLoop.h"
+#include "Channel.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+// 注册大量空闲fd和少量活跃fd，统计每次poll返回后分发一个就绪事件的开销
+// 用法: PollerBench [idleFds] [activeFds] [iterations]
+
+// fd到Channel的查找：原先的std::map与现在以fd为下标的数组
+void benchLookup(const std::vector<int>& allFds, const std::vector<int>& activeFds, int iterations) {
+    std::map<int, Channel*> map;
+    std::vector<Channel*> dense;
+    for (int fd : allFds) {
+        map[fd] = reinterpret_cast<Channel*>(static_cast<intptr_t>(fd));
+        if (static_cast<size_t>(fd) >= dense.size()) {
+            dense.resize(fd + 1, nullptr);
+        }
+        dense[fd] = reinterpret_cast<Channel*>(static_cast<intptr_t>(fd));
+    }
+    intptr_t sum = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        for (int fd : activeFds) {
+            sum += reinterpret_cast<intptr_t>(map.find(fd)->second);
+        }
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        for (int fd : activeFds) {
+            sum += reinterpret_cast<intptr_t>(dense[fd]);
+        }
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    double lookups = static_cast<double>(iterations) * activeFds.size();
+    printf("lookup: map %.1f ns, dense vector %.1f ns per fd (checksum %ld)\n",
+           std::chrono::duration<double, std::nano>(t1 - t0).count() / lookups,
+           std::chrono::duration<double, std::nano>(t2 - t1).count() / lookups,
+           static_cast<long>(sum));
+}
+
+// 端到端：活跃的eventfd一直可读(水平触发且不读取)，每轮poll都会返回全部活跃fd
+void benchLoop(Poller::Type type, const char* name, int idle, int active, int iterations) {
+    EventLoop loop(type);
+    std::vector<int> fds;
+    std::vector<std::unique_ptr<Channel>> channels;
+    int64_t events = 0;
+    const int64_t target = static_cast<int64_t>(active) * iterations;
+    for (int i = 0; i < idle + active; ++i) {
+        int fd = ::eventfd(i < idle ? 0 : 1, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd < 0) {
+            perror("eventfd");
+            exit(1);
+        }
+        fds.push_back(fd);
+        channels.emplace_back(new Channel(&loop, fd));
+        channels.back()->setReadCallback([&](Timestamp) {
+            if (++events == target) {
+                loop.quit();
+            }
+        });
+        channels.back()->enableReading();
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    loop.loop();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    printf("%-8s %d idle + %d active fds: %.1f us per poll, %.1f ns per event\n",
+           name, idle, active, seconds * 1e6 / iterations, seconds * 1e9 / events);
+
+    for (auto& channel : channels) {
+        channel->disableAll();
+        channel->remove();
+    }
+    for (int fd : fds) {
+        ::close(fd);
+    }
+}
+
+int main(int argc, char* argv[]) {
+    int idle = argc > 1 ? atoi(argv[1]) : 100000;
+    int active = argc > 2 ? atoi(argv[2]) : 1000;
+    int iterations = argc > 3 ? atoi(argv[3]) : 2000;
+
+    // 需要足够多的fd
+    struct rlimit rl;
+    rl.rlim_cur = rl.rlim_max = idle + active + 1024;
+    if (::setrlimit(RLIMIT_NOFILE, &rl) < 0) {
+        ::getrlimit(RLIMIT_NOFILE, &rl);
+        int maxFds = static_cast<int>(rl.rlim_max) - active - 1024;
+        printf("RLIMIT_NOFILE is %ld, idle fds reduced to %d\n", static_cast<long>(rl.rlim_max), maxFds);
+        idle = maxFds;
+        rl.rlim_cur = rl.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+
+    std::vector<int> allFds;
+    for (int i = 0; i < idle + active; ++i) {
+        allFds.push_back(i + 16);
+    }
+    std::vector<int> activeFds;
+    std::mt19937 rng(1);
+    for (int i = 0; i < active; ++i) {
+        activeFds.push_back(allFds[rng() % allFds.size()]);
+    }
+    benchLookup(allFds, activeFds, iterations);
+
+    // 库在每轮循环中都有std::cout输出，测量时关掉
+    std::cout.setstate(std::ios::failbit);
+    benchLoop(Poller::kEpoll, "epoll", idle, active, iterations);
+    benchLoop(Poller::kIoUring, "io_uring", idle, active, iterations);
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "UdpServer.h"
+#include "EventLoop.h"
+#include "InetAddress.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+
+// 回环上的UDP接收吞吐：发送线程用sendmmsg(或GSO)不停地发64字节的数据报，服务器统计每秒收到的数据报个数
+// 每个发送线程使用不同的源端口，SO_REUSEPORT按四元组哈希把它们分到不同的loop
+// batch为1时每次recvmmsg只收一个数据报，相当于逐个recvfrom，用来对比批量接收
+// 用法: UdpBench [seconds] [ioThreads] [senders] [gso 0/1] [gro 0/1] [batch]
+
+const uint16_t kPort = 9982;
+const size_t kPayload = 64;
+const int kSendBatch = 64;
+
+void sendLoop(const std::atomic<bool>& running, bool gso, std::atomic<int64_t>& sent) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(kPort);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof addr) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    std::string payload(kPayload * kSendBatch, 'u');
+    std::vector<mmsghdr> msgs(kSendBatch);
+    std::vector<iovec> vecs(kSendBatch);
+    for (int i = 0; i < kSendBatch; ++i) {
+        vecs[i].iov_base = &payload[i * kPayload];
+        vecs[i].iov_len = kPayload;
+        memset(&msgs[i], 0, sizeof msgs[i]);
+        msgs[i].msg_hdr.msg_iov = &vecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    // GSO：一次sendmsg交给内核整块数据，由内核切成kSendBatch个数据报
+    iovec whole = {&payload[0], payload.size()};
+    char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+    msghdr gsoMsg;
+    memset(&gsoMsg, 0, sizeof gsoMsg);
+    gsoMsg.msg_iov = &whole;
+    gsoMsg.msg_iovlen = 1;
+    gsoMsg.msg_control = control;
+    gsoMsg.msg_controllen = sizeof control;
+    cmsghdr* cmsg = CMSG_FIRSTHDR(&gsoMsg);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+    uint16_t segSize = kPayload;
+    memcpy(CMSG_DATA(cmsg), &segSize, sizeof segSize);
+
+    int64_t count = 0;
+    while (running.load(std::memory_order_relaxed)) {
+        if (gso) {
+            if (::sendmsg(fd, &gsoMsg, 0) < 0) {
+                perror("sendmsg UDP_SEGMENT");
+                exit(1);
+            }
+            count += kSendBatch;
+        } else {
+            int n = ::sendmmsg(fd, msgs.data(), kSendBatch, 0);
+            if (n > 0) {
+                count += n;
+            }
+        }
+    }
+    sent.fetch_add(count);
+    ::close(fd);
+}
+
+int main(int argc, char* argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 3.0;
+    int ioThreads = argc > 2 ? atoi(argv[2]) : 1;
+    int senders = argc > 3 ? atoi(argv[3]) : 1;
+    bool gso = argc > 4 && atoi(argv[4]) != 0;
+    bool gro = argc > 5 && atoi(argv[5]) != 0;
+    int batch = argc > 6 ? atoi(argv[6]) : UdpSocket::kDefaultBatchSize;
+
+    EventLoop loop;
+    UdpServer server(&loop, InetAddress(kPort), "udpbench");
+    server.setThreadNum(ioThreads);
+    server.setGro(gro);
+    server.setBatchSize(batch);
+    std::atomic<int64_t> bytes{0};
+    server.setBatchCallback([&](UdpSocket*, const std::vector<Datagram>& datagrams, Timestamp) {
+        size_t n = 0;
+        for (const Datagram& d : datagrams) {
+            n += d.len;
+        }
+        bytes.fetch_add(static_cast<int64_t>(n), std::memory_order_relaxed);
+    });
+    server.start();
+
+    std::atomic<bool> running{true};
+    std::atomic<int64_t> sent{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < senders; ++i) {
+        threads.emplace_back(sendLoop, std::cref(running), gso, std::ref(sent));
+    }
+    auto t0 = std::chrono::steady_clock::now();
+    loop.runAfter(seconds, [&]() {
+        running = false;
+        loop.quit();
+    });
+    loop.loop();
+    auto t1 = std::chrono::steady_clock::now();
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    double elapsed = std::chrono::duration<double>(t1 - t0).count();
+    int64_t received = server.numReceived();
+    printf("%d io threads, %d senders, gso %d, gro %d, batch %d: sent %.0f pps, received %.0f pps (%.1f MB/s), "
+           "%.1f datagrams per batch, %.1f%% lost\n",
+           ioThreads, senders, gso, gro, batch, sent.load() / elapsed, received / elapsed,
+           bytes.load() / elapsed / 1048576.0,
+           static_cast<double>(received) / std::max<int64_t>(server.numReceiveBatches(), 1),
+           sent.load() > 0 ? 100.0 * (sent.load() - received) / sent.load() : 0.0);
+    return 0;
+}
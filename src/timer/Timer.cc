@@ -3,11 +3,11 @@
 std::atomic_int64_t Timer::s_numCreatead_(0);
 
 Timer::Timer(TimerCallback cb,Timestamp when,double interval)
-    : callback_(cb),
+    : callback_(std::move(cb)),
       expiration_(when),
       interval_(interval),
       repeat_(interval > 0.0),
-      sequence_(s_numCreatead_++) {}
+      sequence_(++s_numCreatead_) {}  // 序列号从1开始，默认构造的TimerId(序列号0)不对应任何定时器
 
 //如果此定时器是重复的，则重启它，否则将它设置为失效状态
 void Timer::restart(Timestamp now) {
@@ -2,17 +2,17 @@
 
 #include "noncopyable.h"
 #include "Timestamp.h"
-#include <functional>
+#include "InplaceFunction.h"
 #include <atomic>
 
 class Timer : public noncopyable {
 public:
-    using TimerCallback = std::function<void()>;
+    using TimerCallback = InplaceFunction<void()>;
 
     Timer(TimerCallback cb, Timestamp when, double interval);
 
     //运行时超时回调函数
-    void run() const { callback_; }
+    void run() const { callback_(); }
 
     //返回超时时刻
     Timestamp expiration() const { return expiration_; }
@@ -22,16 +22,26 @@ public:
 
     //重启定时器，只对周期Timer有效
     void restart(Timestamp now);
+    //修改超时时刻，用于TimerQueue::reset()推迟或提前定时器
+    void setExpiration(Timestamp when) { expiration_ = when; }
 
     static int64_t numCreatead() { return s_numCreatead_.load(); }
 
 private:
+    friend class TimerQueue;
+
     const TimerCallback callback_; //超时回调
     Timestamp expiration_;         //超时时刻
     const double interval_;        //周期超时的间隔时间，单位秒；若为0，则说明它是一次性的，不是重复的
     const bool repeat_;            //重复标记，true：周期Timer，false：一次Timer
     const int64_t sequence_;       //全局唯一序列号
 
+    // 以下由TimerQueue维护：定时器在时间轮中的位置，同一个槽中的定时器组成侵入式双向链表
+    Timer* prev_ = nullptr;
+    Timer* next_ = nullptr;
+    int slot_ = -1;                // 时间轮中的槽号，负数见TimerQueue中的k*Slot常量
+    int64_t expireTick_ = 0;       // 以毫秒为单位的超时时刻
+
     // global increasing number, atomic. help to identify different Timer
     static std::atomic_int64_t s_numCreatead_;
-};
\ No newline at end of file
+};
@@ -4,12 +4,15 @@
 #include "Timer.h"
 #include "copyable.h"
 
+#include <stdint.h>
+
 class TimerId: public copyable{
 friend class TimerQueue;
 public:
     TimerId();
     TimerId(Timer*, int64_t);
 private:
+    // 只用来比较，Timer可能已经被释放，TimerQueue通过sequence_查找仍然有效的定时器
     Timer* timer_;
     int64_t sequence_;
-};
\ No newline at end of file
+};
@@ -3,25 +3,29 @@
 #include "Timestamp.h"
 #include "Timer.h"
 #include "TimerId.h"
+#include "Logging.h"
 
 #include <sys/timerfd.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdint.h>
 #include <algorithm>
+#include <functional>
 
 //创建一个系统定时器，并返回其文件描述符
 int createTimerfd() {
     int timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
     if (timerfd < 0) {
         //log
-        printf("Failed in timerfd_create\n");
+        LOG_ERROR << "Failed in timerfd_create";
     }
     return timerfd;
 }
 
 timespec howMuchTimeFromNow(Timestamp when){
     Timestamp now(Timestamp::now());
-    int64_t microSeconds = when-now;
+    // operator-返回的是秒数(double)，直接用微秒相减，否则不到1秒的间隔会被截断成0
+    int64_t microSeconds = when.microSecondsSinceEpoch() - now.microSecondsSinceEpoch();
     if(microSeconds < 100){
         microSeconds = 100;
     }
@@ -36,9 +40,9 @@ void readTimerfd(int timerfd, Timestamp now){
     uint64_t howmany;
     ssize_t n = ::read(timerfd, &howmany, sizeof howmany);
     //log
-    printf("TimerQueue::handleRead()%s at \n",now.toString().data());
+    LOG_TRACE << "TimerQueue::handleRead() at " << now.toString();
     if (n != sizeof howmany) {
-        printf("TimerQueue::handleRead() reads %d  bytes instead of 8\n",n);
+        LOG_ERROR << "TimerQueue::handleRead() reads " << n << " bytes instead of 8";
     }
 }
 
@@ -53,14 +57,51 @@ void resetTimerfd(int timerfd, Timestamp expiration){
     int ret = ::timerfd_settime(timerfd, 0, &newValue, &oldValue);
     if (ret){ 
         //log
-        printf("timerfd_settime() failed()\n");
+        LOG_ERROR << "timerfd_settime() failed()";
     }
 }
 
+// 停止Timerfd，it_value为0表示不再超时
+void stopTimerfd(int timerfd){
+    struct itimerspec newValue;
+    memset(&newValue, 0, sizeof newValue);
+    if (::timerfd_settime(timerfd, 0, &newValue, nullptr)) {
+        LOG_ERROR << "timerfd_settime() failed()";
+    }
+}
+
+namespace {
+
+// 在256位的位图中从start开始循环查找第一个置位的位，没有时返回-1
+int findNextBit(const uint64_t* bits, int start) {
+    int word = start >> 6;
+    uint64_t w = bits[word] & (~static_cast<uint64_t>(0) << (start & 63));
+    for (int i = 0; i <= 4; ++i) {
+        if (w) {
+            return (word << 6) + __builtin_ctzll(w);
+        }
+        word = (word + 1) & 3;
+        w = bits[word];
+        if (i == 3) {
+            // 回到起始的字，只看start之前的位
+            w &= ~(~static_cast<uint64_t>(0) << (start & 63));
+        }
+    }
+    return -1;
+}
+
+} // namespace
+
 TimerQueue::TimerQueue(EventLoop* loop)
-    : loop_(loop),
+    : currentTick_(Timestamp::now().microSecondsSinceEpoch() / 1000),
+      armedTick_(INT64_MAX),
+      count_(0),
+      loop_(loop),
       timerfd_(createTimerfd()),
       timerfdChannel_(loop, timerfd_){
+    memset(slots_, 0, sizeof slots_);
+    memset(level0Bits_, 0, sizeof level0Bits_);
+    memset(levelBits_, 0, sizeof levelBits_);
     timerfdChannel_.setReadCallback(std::bind(&TimerQueue::handleRead, this));
     timerfdChannel_.enableReading();
 }
@@ -73,10 +114,9 @@ TimerQueue::~TimerQueue(){
     // 关闭通道对应timerfd
     ::close(timerfd_);
 
-    while (!timers_.empty()) {
-        const Entry& timer = timers_.top();
-        timers_.pop();
-        delete timer.second;
+    // 时间轮和overflow_中的定时器都在activeTimers_中
+    for (auto& it : activeTimers_) {
+        delete it.second;
     }
 }
 
@@ -90,93 +130,293 @@ TimerQueue::~TimerQueue(){
  * @param interval 循环周期. > 0.0 代表周期定时器; 否则, 代表一次性定时器
  * @return 返回添加的Timer对应TimerId, 用来标识该Timer对象
  */
-void TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval) {
+TimerId TimerQueue::addTimer(TimerCallback cb, Timestamp when, double interval) {
     Timer* timer = new Timer(std::move(cb), when, interval);
-    loop_->runInLoop(std::bind(&TimerQueue::addtimerInLoop, this, timer));
+    // 投递之后loop线程可能已经执行并释放了timer，序列号要在投递之前取出
+    const int64_t sequence = timer->sequence();
+    loop_->runInLoop(std::bind(&TimerQueue::addTimerInLoop, this, timer));
+    return TimerId(timer, sequence);
+}
+
+void TimerQueue::cancel(TimerId timerId) {
+    loop_->runInLoop(std::bind(&TimerQueue::cancelInLoop, this, timerId));
+}
+
+void TimerQueue::reset(TimerId timerId, Timestamp when) {
+    loop_->runInLoop(std::bind(&TimerQueue::resetInLoop, this, timerId, when));
+}
+
+void TimerQueue::addTimerInLoop(Timer* timer) {
+    activeTimers_[timer->sequence()] = timer;
+    if (count_ == 0 && !callingExpiredTimers_) {
+        // 时间轮为空时没有设置timerfd，currentTick_可能已经落后很久，直接追上当前时刻
+        currentTick_ = std::max(currentTick_, Timestamp::now().microSecondsSinceEpoch() / 1000);
+    }
+    timer->expireTick_ = tickOf(timer->expiration());
+    link(timer);
+    if (timer->expireTick_ < armedTick_) {
+        // 下一个需要处理的时刻可能提前了，需重新设置timerfd
+        rearm();
+    }
 }
 
-void TimerQueue::addtimerInLoop(Timer* timer) {
-    // 新增的定时器的到期时间是否是最早的
-    bool earliestChanged = insert(timer);
-    if (earliestChanged) {
-        // 最近的Timer超时时刻发生了改变，需重新设置timerfd，timerfd的超时时刻应始终为最近的Timer超时时刻
-        resetTimerfd(timerfd_, timer->expiration());
+void TimerQueue::cancelInLoop(TimerId timerId) {
+    auto it = activeTimers_.find(timerId.sequence_);
+    if (it == activeTimers_.end()) {
+        return;
+    }
+    Timer* timer = it->second;
+    activeTimers_.erase(it);
+    unlink(timer);
+    if (callingExpiredTimers_) {
+        // 定时器可能在本轮超时的定时器中：在它自己的回调中取消自己，或者先被重置又被取消(已经不是kNoSlot)，
+        // expired_中还留着它的指针，由handleRead()在本轮结束后统一释放
+        timer->slot_ = kCanceledSlot;
+        canceled_.push_back(timer);
+        return;
+    }
+    delete timer;
+    // 取消的可能是最早的定时器，推迟或停止timerfd，避免一次无用的唤醒
+    if (nextEventTick() != armedTick_) {
+        rearm();
+    }
+}
+
+void TimerQueue::resetInLoop(TimerId timerId, Timestamp when) {
+    auto it = activeTimers_.find(timerId.sequence_);
+    if (it == activeTimers_.end()) {
+        return;
+    }
+    Timer* timer = it->second;
+    // 正在执行回调的定时器不在任何槽中，重置后由handleRead()跳过
+    unlink(timer);
+    if (count_ == 0 && !callingExpiredTimers_) {
+        currentTick_ = std::max(currentTick_, Timestamp::now().microSecondsSinceEpoch() / 1000);
+    }
+    timer->setExpiration(when);
+    timer->expireTick_ = tickOf(when);
+    link(timer);
+    if (timer->expireTick_ < armedTick_) {
+        rearm();
     }
 }
 
-// 把Timer对象加入到TimerQueue中
-bool TimerQueue::insert(Timer* timer){
-    bool earliestChanged = false;
-    Timestamp when = timer->expiration();  //当前Timer超时时刻
-    const Entry queueTop = timers_.top();
-    if (timer->expiration() < queueTop.first) {
-        earliestChanged = true;
+int64_t TimerQueue::tickOf(Timestamp when) const {
+    // 以毫秒为单位向上取整，保证定时器不会早于超时时刻执行；已经过期的放到下一个时刻
+    return std::max((when.microSecondsSinceEpoch() + 999) / 1000, currentTick_ + 1);
+}
+
+void TimerQueue::link(Timer* timer) {
+    // 从外部加入的定时器tick > currentTick_；advance()下放时tick可能等于currentTick_，会放入随即到期的槽
+    int64_t tick = timer->expireTick_;
+    int64_t delta = tick - currentTick_;
+    int slot;
+    if (delta < kLevel0Size) {
+        slot = static_cast<int>(tick & (kLevel0Size - 1));
+        level0Bits_[slot >> 6] |= static_cast<uint64_t>(1) << (slot & 63);
+    } else if (delta < kWheelRange) {
+        // 第level层每个槽的时长是2^shift毫秒
+        int level = 1;
+        int shift = kLevel0Bits;
+        while (delta >= static_cast<int64_t>(1) << (shift + kLevelBits)) {
+            ++level;
+            shift += kLevelBits;
+        }
+        int index = static_cast<int>((tick >> shift) & (kLevelSize - 1));
+        slot = kLevel0Size + (level - 1) * kLevelSize + index;
+        levelBits_[level - 1] |= static_cast<uint64_t>(1) << index;
+    } else {
+        overflow_.insert({tick, timer});
+        timer->slot_ = kOverflowSlot;
+        ++count_;
+        return;
+    }
+    // 插入链表头
+    timer->prev_ = nullptr;
+    timer->next_ = slots_[slot];
+    if (slots_[slot]) {
+        slots_[slot]->prev_ = timer;
+    }
+    slots_[slot] = timer;
+    timer->slot_ = slot;
+    ++count_;
+}
+
+void TimerQueue::unlink(Timer* timer) {
+    int slot = timer->slot_;
+    if (slot == kOverflowSlot) {
+        overflow_.erase({timer->expireTick_, timer});
+    } else if (slot >= 0) {
+        if (timer->prev_) {
+            timer->prev_->next_ = timer->next_;
+        } else {
+            slots_[slot] = timer->next_;
+            if (!timer->next_) {
+                // 槽变空，清除位图中对应的位
+                if (slot < kLevel0Size) {
+                    level0Bits_[slot >> 6] &= ~(static_cast<uint64_t>(1) << (slot & 63));
+                } else {
+                    int index = slot - kLevel0Size;
+                    levelBits_[index / kLevelSize] &= ~(static_cast<uint64_t>(1) << (index % kLevelSize));
+                }
+            }
+        }
+        if (timer->next_) {
+            timer->next_->prev_ = timer->prev_;
+        }
+        timer->prev_ = timer->next_ = nullptr;
+    } else {
+        return;
+    }
+    timer->slot_ = kNoSlot;
+    --count_;
+}
+
+void TimerQueue::cascade(int level, int index) {
+    int slot = kLevel0Size + (level - 1) * kLevelSize + index;
+    Timer* timer = slots_[slot];
+    slots_[slot] = nullptr;
+    levelBits_[level - 1] &= ~(static_cast<uint64_t>(1) << index);
+    while (timer) {
+        Timer* next = timer->next_;
+        timer->slot_ = kNoSlot;
+        --count_;
+        // 距离currentTick_更近了，会被放到更低的层
+        link(timer);
+        timer = next;
+    }
+}
+
+void TimerQueue::advance(int64_t nowTick, std::vector<Timer*>& expired) {
+    while (currentTick_ < nowTick) {
+        int64_t next = nextEventTick();
+        if (next > nowTick) {
+            // 中间的时刻都没有要处理的槽，直接跳过
+            currentTick_ = nowTick;
+            break;
+        }
+        currentTick_ = next;
+        if ((next & (kLevel0Size - 1)) == 0) {
+            // 第0层转完一圈，下放第1层的槽；第1层也转完一圈时继续下放第2层，以此类推
+            int shift = kLevel0Bits;
+            for (int level = 1; level < kNumLevels; ++level) {
+                int index = static_cast<int>((next >> shift) & (kLevelSize - 1));
+                cascade(level, index);
+                if (index != 0) {
+                    break;
+                }
+                shift += kLevelBits;
+            }
+        }
+        // 进入时间轮范围的overflow_定时器
+        while (!overflow_.empty() && overflow_.begin()->first - currentTick_ < kWheelRange) {
+            Timer* timer = overflow_.begin()->second;
+            overflow_.erase(overflow_.begin());
+            timer->slot_ = kNoSlot;
+            --count_;
+            link(timer);
+        }
+        // 第0层当前槽中的定时器全部到期
+        int slot = static_cast<int>(next & (kLevel0Size - 1));
+        Timer* timer = slots_[slot];
+        slots_[slot] = nullptr;
+        level0Bits_[slot >> 6] &= ~(static_cast<uint64_t>(1) << (slot & 63));
+        while (timer) {
+            Timer* nextTimer = timer->next_;
+            timer->prev_ = timer->next_ = nullptr;
+            timer->slot_ = kNoSlot;
+            --count_;
+            expired.push_back(timer);
+            timer = nextTimer;
+        }
+    }
+}
+
+int64_t TimerQueue::nextEventTick() const {
+    if (count_ == 0) {
+        return INT64_MAX;
+    }
+    int64_t best = INT64_MAX;
+    // 第0层：从currentTick_ + 1对应的槽开始找第一个非空槽
+    int start = static_cast<int>((currentTick_ + 1) & (kLevel0Size - 1));
+    int pos = findNextBit(level0Bits_, start);
+    if (pos >= 0) {
+        best = currentTick_ + 1 + ((pos - start) & (kLevel0Size - 1));
+    }
+    // 第1~3层：最近的非空槽被下放的时刻，即该槽对应的时间段的起点
+    int shift = kLevel0Bits;
+    for (int level = 1; level < kNumLevels; ++level) {
+        uint64_t bits = levelBits_[level - 1];
+        if (bits) {
+            int c = static_cast<int>(((currentTick_ >> shift) + 1) & (kLevelSize - 1));
+            // 循环右移，使下标c成为第0位
+            uint64_t rotated = c ? (bits >> c) | (bits << (kLevelSize - c)) : bits;
+            int64_t d = __builtin_ctzll(rotated) + 1;
+            best = std::min(best, ((currentTick_ >> shift) + d) << shift);
+        }
+        shift += kLevelBits;
+    }
+    if (!overflow_.empty()) {
+        best = std::min(best, overflow_.begin()->first - kWheelRange + 1);
+    }
+    return best;
+}
+
+void TimerQueue::rearm() {
+    int64_t next = nextEventTick();
+    int64_t armed = armedTick_;
+    armedTick_ = next;
+    if (next != INT64_MAX) {
+        resetTimerfd(timerfd_, Timestamp(next * 1000));
+    } else if (armed != INT64_MAX) {
+        // 没有定时器了，停止timerfd
+        stopTimerfd(timerfd_);
     }
-    timers_.push({timer->expiration(), timer});
-    return earliestChanged;
 }
 
 /**
  * 处理读事件, 只能是所属loop线程调用
  * @details 当Poller的poll监听到超时发生时, 将channel加入激活通道列表, loop中回调
  * 事件处理函数, TimerQueue::handleRead.
- * 发生超时事件时, 可能会有多个超时任务超时, 需要通过getExpired一次性全部获取, 然后逐个执行回调.
+ * 把时间轮推进到当前时刻, 一次性取出所有超时的定时器, 然后逐个执行回调.
  * @note timerfd只会发生读事件.
  */
 void TimerQueue::handleRead() {
     Timestamp now(Timestamp::now());
     //先处理Timerfd的超时事件，再处理自定义的Timer的超时
     readTimerfd(timerfd_, now);
+    armedTick_ = INT64_MAX;
 
-    // 获取当前所有超时的定时器
-    std::vector<Entry> expired = getExpired(now);
+    advance(now.microSecondsSinceEpoch() / 1000, expired_);
     callingExpiredTimers_ = true;
-    for(const Entry& it : expired){
-        it.second->run(); //通过Timer::run()回调超时处理函数
-    }
-    callingExpiredTimers_ = false;
-    // 重置所有已超时的定时器
-    reset(expired,now);
-}
-
-/**
- * 定时任务超时时, 从timers_中取出所有的超时任务, 以vector形式返回给调用者
- * @param now 当前时间点, 用来判断定时器是否超时
- * @return vector timers_中超时的定时器
- */
-std::vector<Entry> TimerQueue::getExpired(Timestamp now) {
-    std::vector<Entry> expired;
-    while (!timers_.empty()) {
-        const Entry queueTop = timers_.top();
-        timers_.pop();
-        if (queueTop.first <= now) {
-            expired.push_back(queueTop);
-        } else {
-            break;
+    for (size_t i = 0; i < expired_.size(); ++i) {
+        // 前面的回调可能已经取消或重置了后面的定时器
+        if (expired_[i]->slot_ == kNoSlot) {
+            expired_[i]->run(); //通过Timer::run()回调超时处理函数
         }
     }
-    return expired;
-}
+    callingExpiredTimers_ = false;
 
-/**
- * 根据指定时间now重置所有超时任务, 只对周期定时任务有效
- * @param expired 所有超时任务
- * @param now 指定的reset基准时间点, 新的超时时间点以此为基准
- */
-void TimerQueue::reset(const std::vector<Entry>& expired, Timestamp now){
-    Timestamp nextExpire;
-    for(const Entry& it : expired){
-        // 重复任务则继续执行
-        if (it.second->repeat()) {
-            it.second->restart(now);
-            // 把重置后的定时器添加回timers_
-            insert(it.second);
-        }else{
-            delete it.second;
+    for (Timer* timer : expired_) {
+        // kCanceledSlot的在canceled_中，最后释放
+        if (timer->slot_ == kNoSlot) {
+            if (timer->repeat()) {
+                // 重复任务则继续执行
+                timer->restart(now);
+                timer->expireTick_ = tickOf(timer->expiration());
+                link(timer);
+            } else {
+                activeTimers_.erase(timer->sequence());
+                delete timer;
+            }
         }
+        // 否则在回调中被重置，已经重新放入时间轮
     }
-    // 如果重新插入了定时器，需要继续重置timerfd
-    if (!timers_.empty()) {
-        resetTimerfd(timerfd_, timers_.top().first);
+    expired_.clear();
+    // 本轮回调中取消的定时器，已经从activeTimers_和时间轮中删除
+    for (Timer* timer : canceled_) {
+        delete timer;
     }
-}
\ No newline at end of file
+    canceled_.clear();
+    rearm();
+}
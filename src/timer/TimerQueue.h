@@ -5,64 +5,118 @@
 #include "TimerId.h"
 #include "Timestamp.h"
 
-#include <functional>
+#include <stdint.h>
+#include <set>
+#include <unordered_map>
 #include <utility>
-#include <queue>
 #include <vector>
-#include <deque>
 
-using Entry = std::pair<Timestamp, Timer*>;
 class EventLoop;
 class Timer;
 
-struct compare_timestamp {
-    bool operator()(const Entry& lhs, const Entry& rhs) {
-        return lhs.first < rhs.first;
-    }
-};
-
+/**
+ * 定时器队列，用分层时间轮(hierarchical timing wheel)管理定时器，精度1ms。
+ * 第0层256个槽，每槽1ms；第1~3层各64个槽，每槽分别是第0层、第1层、第2层一圈的时长，
+ * 四层一共覆盖2^26ms(约18.6小时)，更远的定时器放在按超时时刻排序的overflow_中，进入时间轮范围后再移入。
+ * 每个槽是侵入式双向链表，所以添加、取消、重置定时器都是O(1)，不需要分配内存：
+ * 每个连接一个空闲超时定时器、并且几乎总是在超时之前被重置的场景下，重置只是把Timer从一个链表移到另一个链表。
+ * 高层的槽到期时把其中的定时器下放(cascade)到低层；每层有一个表示非空槽的位图，
+ * 用来直接找到下一个需要处理的时刻，据此设置timerfd，空闲时不会每毫秒唤醒一次。
+ */
 class TimerQueue : noncopyable {
 public:
-    using TimerCallback = std::function<void()>;
+    using TimerCallback = Timer::TimerCallback;
 
     explicit TimerQueue(EventLoop* loop);
     ~TimerQueue();
-    
-    //添加一个定时器，此函数只能在EventLoop所属的线程中调用
-    void addTimer(TimerCallback cb, Timestamp when, double interval);
+
+    /**
+     * 添加一个定时器，可以在其他线程调用
+     * @return TimerId 用于cancel()和reset()
+     */
+    TimerId addTimer(TimerCallback cb, Timestamp when, double interval);
+    // 取消定时器，可以在其他线程调用；定时器已经超时(一次性的)或已被取消时什么也不做
+    void cancel(TimerId timerId);
+    // 把定时器的下一次超时时刻改为when，可以在其他线程调用；定时器已经超时(一次性的)或已被取消时什么也不做
+    void reset(TimerId timerId, Timestamp when);
 
 private:
-    using TimerList = std::priority_queue<Entry, std::deque<Entry>, compare_timestamp>;
+    // 第0层的槽数和位数
+    static const int kLevel0Bits = 8;
+    static const int kLevel0Size = 1 << kLevel0Bits;
+    // 第1~3层每层的槽数和位数
+    static const int kLevelBits = 6;
+    static const int kLevelSize = 1 << kLevelBits;
+    static const int kNumLevels = 4;
+    // 时间轮能表示的最大时长(ms)，超出的放入overflow_
+    static const int64_t kWheelRange = static_cast<int64_t>(1) << (kLevel0Bits + 3 * kLevelBits);
+    static const int kNumSlots = kLevel0Size + 3 * kLevelSize;
+
+    // Timer::slot_的特殊取值
+    static const int kNoSlot = -1;        // 不在任何槽中：正在执行超时回调
+    static const int kCanceledSlot = -2;  // 在执行超时回调期间被取消，在canceled_中
+    static const int kOverflowSlot = -3;  // 在overflow_中
+
+    using OverflowSet = std::set<std::pair<int64_t, Timer*>>;
 
     void handleRead();
 
-    //在所属的线程中添加定时器
-    void addtimerInLoop(Timer* timer);
+    void addTimerInLoop(Timer* timer);
+    void cancelInLoop(TimerId timerId);
+    void resetInLoop(TimerId timerId, Timestamp when);
+
+    // 定时器在时间轮中的超时时刻(ms)
+    int64_t tickOf(Timestamp when) const;
+    // 按expireTick_把定时器放入时间轮或overflow_
+    void link(Timer* timer);
+    // 把定时器从所在的槽或overflow_中取出
+    void unlink(Timer* timer);
+    // 把第level层(1~3)第index个槽中的定时器按当前时刻重新放置
+    void cascade(int level, int index);
     /**
-     * 移除所有已到期的定时器
-     * 1.获取到期的定时器
-     * 2.重置这些定时器（销毁或者重复定时任务）
+     * 把时间推进到nowTick，收集所有到期的定时器
+     * 中间没有定时器的时刻直接跳过
      */
-    std::vector<Entry> getExpired(Timestamp now);
-    //重置所有已超时的任务
-    void reset(const std::vector<Entry>& expired,Timestamp now);
-    //插入定时器的内部方法
-    bool insert(Timer* timer);
+    void advance(int64_t nowTick, std::vector<Timer*>& expired);
+    // 下一个需要处理的时刻：第0层最近的非空槽，或者高层最近的非空槽下放的时刻，没有定时器时返回INT64_MAX
+    int64_t nextEventTick() const;
+    // 根据nextEventTick()设置timerfd
+    void rearm();
+
+    // 时间轮的槽，每个槽是一个双向链表的头指针
+    Timer* slots_[kNumSlots];
+    // 每层非空槽的位图，第0层256位，第1~3层各64位
+    uint64_t level0Bits_[kLevel0Size / 64];
+    uint64_t levelBits_[kNumLevels - 1];
+    // 超出时间轮范围的定时器，按(超时时刻, Timer*)排序
+    OverflowSet overflow_;
+    // 时间轮当前所处的时刻(ms)，小于等于它的时刻都已经处理过
+    int64_t currentTick_;
+    // timerfd当前设置的超时时刻(ms)
+    int64_t armedTick_;
+    // 时间轮和overflow_中定时器的个数
+    size_t count_;
 
-    TimerList timers_;
+    // 所有有效的定时器，sequence -> Timer*，用来校验TimerId
+    std::unordered_map<int64_t, Timer*> activeTimers_;
+    // 正在执行的超时定时器
+    std::vector<Timer*> expired_;
+    // 执行超时回调期间取消的定时器，expired_中可能还有它们的指针，本轮结束后再释放
+    std::vector<Timer*> canceled_;
     //表明正在获取超时定时器
     bool callingExpiredTimers_ = false;
 
     //所属的EventLoop
     EventLoop* loop_;
-    Channel timerfdChannel_;
+    // timerfd_必须在timerfdChannel_之前声明，成员按声明顺序初始化
     const int timerfd_;
+    Channel timerfdChannel_;
     /**
      * 一个EventLoop只持有一个TimerQueue对象，
-     * 而TimerQueue通过std::set持有多个Timer对象，
+     * 而TimerQueue通过时间轮持有多个Timer对象，
      * 但只会设置一个timerfd和一个对应的Channel,通过一个timerfd来管理多个Timer对象，
-     * /这个timerfd的超时时间为多个Timer对象中超时时间最近那一个，当timerfd超时超时时，
-     * 代表至少有一个Timer对象超时，我们就去找到所有超时的Timer对象，并处理
+     * /这个timerfd的超时时间为下一个需要处理的时刻，当timerfd超时时，
+     * 就推进时间轮，找到所有超时的Timer对象，并处理
      * 因此，实际上，操作系统内部只创建了一个定时器，但我们用这个定时器来实现我们自己的多个Timer
      */
-};
\ No newline at end of file
+};
@@ -0,0 +1,132 @@
+#include "EventLoop.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <ctime>
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// 添加、重置、取消大量定时器，比较时间轮TimerQueue与按超时时刻排序的std::set(原先的做法)
+// 最后让所有定时器在短时间内到期，统计触发的开销
+// 用法: TimerQueueBench [timers]
+
+using Clock = std::chrono::steady_clock;
+
+static double nsPerOp(Clock::time_point begin, Clock::time_point end, int n) {
+    return std::chrono::duration<double, std::nano>(end - begin).count() / n;
+}
+
+// 对照组：std::set<(超时时刻, 序列号)>加序列号索引，添加/重置/取消都是O(log n)
+struct SetTimers {
+    struct Item {
+        int64_t* counter;
+        Timestamp when;
+    };
+    std::set<std::pair<Timestamp, int64_t>> timers;
+    std::unordered_map<int64_t, Item> items;
+    int64_t nextSeq = 1;
+
+    int64_t add(Timestamp when, int64_t* counter) {
+        int64_t seq = nextSeq++;
+        items.emplace(seq, Item{counter, when});
+        timers.insert({when, seq});
+        return seq;
+    }
+    void reset(int64_t seq, Timestamp when) {
+        auto it = items.find(seq);
+        timers.erase({it->second.when, seq});
+        it->second.when = when;
+        timers.insert({when, seq});
+    }
+    void cancel(int64_t seq) {
+        auto it = items.find(seq);
+        timers.erase({it->second.when, seq});
+        items.erase(it);
+    }
+};
+
+static void benchSet(const std::vector<double>& delays, const std::vector<double>& resets) {
+    SetTimers set;
+    int64_t counter = 0;
+    int n = static_cast<int>(delays.size());
+    std::vector<int64_t> ids(n);
+    Timestamp now = Timestamp::now();
+
+    auto t0 = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        ids[i] = set.add(now + delays[i], &counter);
+    }
+    auto t1 = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        set.reset(ids[i], now + resets[i]);
+    }
+    auto t2 = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        set.cancel(ids[i]);
+    }
+    auto t3 = Clock::now();
+    printf("std::set     add %6.1f ns, reset %6.1f ns, cancel %6.1f ns\n",
+           nsPerOp(t0, t1, n), nsPerOp(t1, t2, n), nsPerOp(t2, t3, n));
+}
+
+static void benchWheel(const std::vector<double>& delays, const std::vector<double>& resets) {
+    EventLoop loop;
+    int64_t counter = 0;
+    int n = static_cast<int>(delays.size());
+    std::vector<TimerId> ids(n);
+    Timestamp now = Timestamp::now();
+
+    // 在loop线程中调用，runInLoop直接执行，测到的就是TimerQueue本身的开销
+    auto t0 = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        ids[i] = loop.runAt(now + delays[i], [&counter] { ++counter; });
+    }
+    auto t1 = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        loop.resetTimerAt(ids[i], now + resets[i]);
+    }
+    auto t2 = Clock::now();
+    for (int i = 0; i < n; ++i) {
+        loop.cancel(ids[i]);
+    }
+    auto t3 = Clock::now();
+    printf("timing wheel add %6.1f ns, reset %6.1f ns, cancel %6.1f ns\n",
+           nsPerOp(t0, t1, n), nsPerOp(t1, t2, n), nsPerOp(t2, t3, n));
+
+    // 所有定时器在0.2s内到期，用进程CPU时间统计触发的开销(不含等待)
+    counter = 0;
+    now = Timestamp::now();
+    for (int i = 0; i < n; ++i) {
+        loop.runAt(now + 0.2 * i / n, [&counter] { ++counter; });
+    }
+    loop.runAfter(0.5, [&loop] { loop.quit(); });
+    std::clock_t c0 = std::clock();
+    loop.loop();
+    std::clock_t c1 = std::clock();
+    printf("timing wheel fired %ld timers, %.1f ns cpu per timer\n", static_cast<long>(counter),
+           static_cast<double>(c1 - c0) / CLOCKS_PER_SEC * 1e9 / (counter ? counter : 1));
+}
+
+int main(int argc, char* argv[]) {
+    int n = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    // 空闲超时的典型分布：超时时间在1~60s之间，重置时整体推后
+    std::mt19937 rng(12345);
+    std::uniform_real_distribution<double> dist(1.0, 60.0);
+    std::vector<double> delays(n);
+    std::vector<double> resets(n);
+    for (int i = 0; i < n; ++i) {
+        delays[i] = dist(rng);
+        resets[i] = delays[i] + dist(rng);
+    }
+
+    printf("%d timers\n", n);
+    benchSet(delays, resets);
+    benchWheel(delays, resets);
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include "EventLoop.h"
+#include "Timestamp.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+// TimerQueue(时间轮)的行为测试，通过EventLoop的定时器接口驱动，全部用例在同一个loop中同时进行
+// 定时器按时触发：不早于超时时刻，覆盖第0层、第1层、第2层和层间下放(cascade)的边界
+// 在超时回调中取消、重置本轮的其他定时器，先重置再取消(曾经的use-after-free)，取消自己，其他线程添加和取消
+// 用例需要约17秒(第2层的定时器至少16.4秒之后才超时)，失败时返回非0
+
+namespace {
+
+int g_failures = 0;
+
+#define CHECK(cond)                                                      \
+    do {                                                                 \
+        if (!(cond)) {                                                   \
+            ++g_failures;                                                \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond);       \
+        }                                                                \
+    } while (0)
+
+// 定时器触发允许的最大延迟，机器繁忙时放宽一些
+const int64_t kMaxLateUs = 200 * 1000;
+
+int64_t nowUs() { return Timestamp::now().microSecondsSinceEpoch(); }
+
+// 按时触发：不同层的延迟，包括第0层一圈(256ms)和第1层一圈(16384ms)前后
+struct Deadline {
+    double delay;
+    int64_t whenUs = 0;
+    int64_t firedUs = 0;
+    int fired = 0;
+};
+
+void addDeadlines(EventLoop* loop, std::vector<Deadline>* deadlines) {
+    const double delays[] = {0.0,   0.001, 0.002, 0.01,  0.1,   0.255, 0.256,  0.257, 0.3,
+                             0.511, 0.512, 0.513, 1.0,   2.5,   4.0,   16.383, 16.384, 16.385, 16.6};
+    for (double delay : delays) {
+        deadlines->push_back(Deadline{delay});
+    }
+    for (Deadline& d : *deadlines) {
+        Deadline* p = &d;
+        Timestamp when = Timestamp::now() + d.delay;
+        d.whenUs = when.microSecondsSinceEpoch();
+        loop->runAt(when, [p] {
+            ++p->fired;
+            p->firedUs = nowUs();
+        });
+    }
+}
+
+void checkDeadlines(const std::vector<Deadline>& deadlines) {
+    for (const Deadline& d : deadlines) {
+        if (d.fired != 1 || d.firedUs < d.whenUs || d.firedUs - d.whenUs > kMaxLateUs) {
+            ++g_failures;
+            printf("FAIL deadline %.3fs: fired %d times, %lld us late\n", d.delay, d.fired,
+                   static_cast<long long>(d.firedUs - d.whenUs));
+        }
+    }
+}
+
+// 同一时刻超时的一对定时器，在同一轮handleRead()中执行，先执行的对另一个做操作
+struct Pair {
+    EventLoop* loop;
+    TimerId ids[2];
+    int runs[2] = {0, 0};
+    bool acted = false;
+};
+
+enum PairAction { kCancelOther, kResetOther, kResetThenCancelOther };
+
+void addPair(EventLoop* loop, Pair* pair, PairAction action) {
+    pair->loop = loop;
+    Timestamp when = Timestamp::now() + 0.05;
+    for (int i = 0; i < 2; ++i) {
+        pair->ids[i] = loop->runAt(when, [pair, i, action] {
+            ++pair->runs[i];
+            if (pair->acted) {
+                return;
+            }
+            pair->acted = true;
+            const TimerId other = pair->ids[1 - i];
+            if (action == kResetOther || action == kResetThenCancelOther) {
+                // 另一个定时器还在本轮的expired_中，重置后放回时间轮
+                pair->loop->resetTimerAfter(other, 0.05);
+            }
+            if (action == kCancelOther || action == kResetThenCancelOther) {
+                pair->loop->cancel(other);
+            }
+        });
+    }
+}
+
+// 周期定时器在自己的回调中取消自己
+struct SelfCancel {
+    EventLoop* loop;
+    TimerId id;
+    int runs = 0;
+};
+
+// 周期定时器在自己的回调中把下一次超时推迟
+struct SelfReset {
+    EventLoop* loop;
+    TimerId id;
+    int runs = 0;
+    int64_t lastUs = 0;
+    int64_t minGapUs = INT64_MAX;
+};
+
+// 不断被推迟的空闲超时定时器，最后一次推迟之后才触发
+struct Idle {
+    TimerId id;
+    int fired = 0;
+    int64_t deadlineUs = 0;
+    int64_t firedUs = 0;
+};
+
+}  // namespace
+
+int main() {
+    EventLoop loop;
+
+    std::vector<Deadline> deadlines;
+    deadlines.reserve(32);
+    addDeadlines(&loop, &deadlines);
+
+    Pair cancelPair;
+    Pair resetPair;
+    Pair resetCancelPair;
+    addPair(&loop, &cancelPair, kCancelOther);
+    addPair(&loop, &resetPair, kResetOther);
+    addPair(&loop, &resetCancelPair, kResetThenCancelOther);
+
+    SelfCancel selfCancel;
+    selfCancel.loop = &loop;
+    selfCancel.id = loop.runEvery(0.01, [&selfCancel] {
+        if (++selfCancel.runs == 3) {
+            selfCancel.loop->cancel(selfCancel.id);
+        }
+    });
+
+    SelfReset selfReset;
+    selfReset.loop = &loop;
+    selfReset.id = loop.runEvery(0.01, [&selfReset] {
+        int64_t now = nowUs();
+        if (selfReset.runs++ > 0) {
+            selfReset.minGapUs = std::min(selfReset.minGapUs, now - selfReset.lastUs);
+        }
+        selfReset.lastUs = now;
+        if (selfReset.runs == 3) {
+            selfReset.loop->cancel(selfReset.id);
+        } else {
+            // 重置后不再按10ms的周期，而是100ms之后
+            selfReset.loop->resetTimerAfter(selfReset.id, 0.1);
+        }
+    });
+
+    // 每20ms推迟一次，共推迟20次(400ms)，跨过第0层到第1层的边界
+    Idle idle;
+    idle.id = loop.runAfter(0.1, [&idle] {
+        ++idle.fired;
+        idle.firedUs = nowUs();
+    });
+    idle.deadlineUs = nowUs() + 100 * 1000;
+    int idleResets = 0;
+    TimerId pusher;
+    pusher = loop.runEvery(0.02, [&] {
+        if (idleResets++ < 20) {
+            Timestamp when = Timestamp::now() + 0.1;
+            idle.deadlineUs = when.microSecondsSinceEpoch();
+            loop.resetTimerAt(idle.id, when);
+        } else {
+            loop.cancel(pusher);
+        }
+    });
+
+    // 取消已经超时的一次性定时器、重复取消、重置已取消的定时器都什么也不做
+    int onceRuns = 0;
+    TimerId once = loop.runAfter(0.01, [&onceRuns] { ++onceRuns; });
+    loop.runAfter(0.1, [&] {
+        loop.cancel(once);
+        loop.cancel(once);
+        loop.resetTimerAfter(once, 0.01);
+    });
+    int canceledRuns = 0;
+    TimerId canceled = loop.runAfter(0.05, [&canceledRuns] { ++canceledRuns; });
+    loop.cancel(canceled);
+    loop.cancel(canceled);
+    loop.resetTimerAfter(canceled, 0.01);
+
+    // 其他线程添加、取消定时器
+    int remoteRuns = 0;
+    int remoteCanceledRuns = 0;
+    std::thread remote([&] {
+        loop.runAfter(0.3, [&remoteRuns] { ++remoteRuns; });
+        TimerId id = loop.runAfter(0.3, [&remoteCanceledRuns] { ++remoteCanceledRuns; });
+        loop.cancel(id);
+    });
+    remote.join();
+
+    // 最后一个定时器执行完后timerfd停止，之后(不在超时回调中)添加的定时器仍能按时触发
+    int lateRuns = 0;
+    loop.runAfter(17.0, [&] {
+        loop.queueInLoop([&] {
+            Timestamp when = Timestamp::now() + 0.02;
+            loop.runAt(when, [&, when] {
+                ++lateRuns;
+                CHECK(when <= Timestamp::now());
+                loop.quit();
+            });
+        });
+    });
+
+    loop.loop();
+
+    checkDeadlines(deadlines);
+    CHECK(cancelPair.runs[0] + cancelPair.runs[1] == 1);
+    // 被重置的那个在本轮中跳过，之后再执行一次
+    CHECK(resetPair.runs[0] == 1 && resetPair.runs[1] == 1);
+    CHECK(resetCancelPair.runs[0] + resetCancelPair.runs[1] == 1);
+    CHECK(selfCancel.runs == 3);
+    CHECK(selfReset.runs == 3);
+    CHECK(selfReset.minGapUs >= 100 * 1000);
+    CHECK(idle.fired == 1);
+    CHECK(idle.firedUs >= idle.deadlineUs && idle.firedUs - idle.deadlineUs < kMaxLateUs);
+    CHECK(onceRuns == 1);
+    CHECK(canceledRuns == 0);
+    CHECK(remoteRuns == 1);
+    CHECK(remoteCanceledRuns == 0);
+    CHECK(lateRuns == 1);
+
+    printf("%s\n", g_failures == 0 ? "ok" : "FAILED");
+    return g_failures == 0 ? 0 : 1;
+}